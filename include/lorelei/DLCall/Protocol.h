@@ -10,6 +10,8 @@
 /// magic syscall, and the host (\c LoreCommonHostEntry) decodes and serves them. Everything here is
 /// plain-old-data so it can cross the guest/host boundary unchanged.
 
+#include <cstdint>
+
 namespace lore {
 
     /// Magic syscall number the guest issues to reach the host, intercepted by the QEMU \c dlcall
@@ -17,9 +19,9 @@ namespace lore {
     static constexpr int DLCallSyscallNumber = 4096;
 
     /// DLCallRequestID - Selects the operation for a DLCall syscall (its first argument). The
-    /// library-management IDs are served by the \c dlcall plugin itself. \c DR_InvokeProc calls a
-    /// host function pointer, which the runtime aims at the host common entry to reach the
-    /// operations in \c DLCallSecondaryID.
+    /// library-management IDs are served by the \c dlcall plugin itself (in loopback mode, by the
+    /// host runtime's \c LoreLoopbackEntry). \c DR_InvokeProc calls a host function pointer, which
+    /// the runtime aims at the host common entry to reach the operations in \c DLCallSecondaryID.
     enum DLCallRequestID {
         DR_GetHostAttribute, ///< Query a host attribute by key.
         DR_LoadLibrary,      ///< dlopen a host library.
@@ -38,6 +40,18 @@ namespace lore {
         DS_LogMessage,     ///< Forward a guest log record to the host's logging sink.
         DS_GetModulePath,  ///< Resolve the module path of a host handle or address.
         DS_GetThunkInfo,   ///< Look up a thunk-database entry for a library.
+        DS_FlushStdio,     ///< Flush every host stdio stream (the guest is about to exit).
+        DS_InvokeBatch,    ///< Run a buffer of deferred calls, in order (see DeferredCallHeader).
+        DS_AsyncAttach,    ///< Hand a thread's AsyncRing to a host worker.
+        DS_AsyncDetach,    ///< Take a drained AsyncRing back from its host worker.
+        DS_AsyncNotify,    ///< Wake the parked host worker of an AsyncRing.
+        DS_AsyncWait,      ///< Block until an async call completes or needs a reentry.
+        DS_AsyncResume,    ///< Resume an async call after the guest serviced its reentry.
+        DS_ResolveSymbols, ///< Look up many symbols at once (see ResolveSymbolsArguments).
+        DS_GetStats,       ///< Snapshot the host's per-proc crossing statistics.
+        DS_TraceSubmit,    ///< Hand the guest's trace buffers to the host (see TraceBuffer).
+        DS_ElideCallbacks, ///< Map guest functions to host ones (see CallbackElisionArguments).
+        DS_LoaderChanged,  ///< A DR_LoadLibrary or DR_FreeLibrary changed the host link map.
     };
 
     /// ClientCallingConvention - How a host function is ultimately invoked by
@@ -47,6 +61,8 @@ namespace lore {
         /// \code
         ///     void (void **args, void *ret, void *metadata)
         /// \endcode
+        /// \c args is an array of argument pointers, or for a proc whose scalar arguments TLC packs
+        /// by value, a pointer to that packed frame. Only the proc's own Entry reads it.
         CC_Standard = 0,
 
         /// Like \c CC_Standard, but with the callback pointer prepended.
@@ -64,6 +80,25 @@ namespace lore {
         ///     void *(void *arg)
         /// \endcode
         CC_ThreadEntry = 3,
+
+        /// Leaf convention: like \c CC_Standard (and carried in its \c standard member), for a proc
+        /// that never reenters the guest. The host calls it directly on the calling thread's stack,
+        /// skipping the coroutine switch, so the proc must not call \c HostServer::reenter.
+        /// \code
+        ///     void (void **args, void *ret, void *metadata)
+        /// \endcode
+        CC_Leaf = 4,
+
+        /// Register convention: up to four scalar arguments and a scalar return, carried by value
+        /// as 64-bit words in the \c registers member instead of through an \c args[] array and a
+        /// return slot. The host Entry takes and returns them the same way.
+        /// \code
+        ///     uint64_t (uint64_t a1, uint64_t a2, uint64_t a3, uint64_t a4)
+        /// \endcode
+        CC_Register = 5,
+
+        /// \c CC_Register for a proc that never reenters the guest (see \c CC_Leaf).
+        CC_RegisterLeaf = 6,
     };
 
     /// ServerReentryConvention - How a guest function is invoked during a reentry, driven by
@@ -73,6 +108,7 @@ namespace lore {
         /// \code
         ///     void (void *proc, void **args, void *ret, void *metadata)
         /// \endcode
+        /// \c args may point at a packed argument frame instead, as for \c CC_Standard.
         SC_Standard = 0,
 
         /// Like \c SC_Standard, but with the callback pointer prepended.
@@ -130,9 +166,88 @@ namespace lore {
                 void *arg;
                 void **ret;
             } threadEntry;
+            struct {
+                void *proc;
+                uint64_t args[4];
+                uint64_t ret;
+            } registers;
         };
     };
 
+    /// DeferredCallHeader - Heads one call recorded in a \c DS_InvokeBatch buffer.
+    ///
+    /// The guest records a \c pass::Deferred call instead of crossing for it, copying its arguments
+    /// by value, and sends the buffered records in one crossing. Each record is this header, \c argc
+    /// 32-bit argument offsets, then the argument copies. Offsets are from the record start, and the
+    /// record and every copy start 16-byte aligned. The host calls \c proc as a \c CC_Standard entry
+    /// with no return slot, pointing each \c args[i] at its copy.
+    struct DeferredCallHeader {
+        void *proc;    ///< Host Entry of the recorded call.
+        uint32_t size; ///< Bytes in the record, header included, a multiple of 16.
+        uint32_t argc; ///< Number of arguments (and offsets).
+    };
+
+    /// Most arguments a deferred call may carry. A call with more crosses immediately instead.
+    static constexpr int DeferredCallMaxArgs = 32;
+
+    /// ResolveSymbolsFlag - Options of a \c DS_ResolveSymbols request.
+    enum ResolveSymbolsFlag {
+        /// \c scope is an address inside the library to search rather than a handle.
+        RS_ScopeIsAddress = 1,
+    };
+
+    /// ResolveSymbolsArguments - Payload of \c DS_ResolveSymbols, which does what \c count
+    /// \c DR_GetProcAddress requests would in one crossing.
+    struct ResolveSymbolsArguments {
+        /// A host library handle (null for the default scope), or with \c RS_ScopeIsAddress any
+        /// address inside the host library.
+        void *scope;
+        const char *const *names; ///< The \c count symbol names.
+        void **addrs;             ///< Receives each symbol's address, null if not found.
+        /// Optional. Receives the path of the host module holding each address found, so the guest
+        /// can convert it without a \c DS_GetModulePath per symbol.
+        const char **modulePaths;
+        uint32_t count;
+        uint32_t flags; ///< \c ResolveSymbolsFlag bits.
+        uint32_t found; ///< Receives how many symbols were found.
+    };
+
+    /// Buckets of a crossing latency histogram. Bucket \c i counts the calls that took
+    /// [2^i, 2^(i+1)) nanoseconds (bucket 0 also takes 0 and 1), and the last bucket everything
+    /// longer.
+    static constexpr int CrossingHistogramBuckets = 32;
+
+    /// CrossingStatsEntry - One host proc's crossing statistics in a \c DS_GetStats snapshot.
+    ///
+    /// Times are host-side only: the part of a call spent in a guest reentry is not counted.
+    struct CrossingStatsEntry {
+        /// The thunk the proc belongs to, or for a proc no thunk registered (a variadic host
+        /// function, say) the path of the module holding it. Valid while that thunk is loaded.
+        const char *library;
+        /// The function name (a callback's signature), or null if unknown.
+        const char *name;
+        void *proc;    ///< The host Entry the guest invoked.
+        uint32_t kind; ///< A \c thunk::ProcKind.
+        /// The proc's \c HostFunction_* or \c Callback_* index, or \c UINT32_MAX if unknown.
+        uint32_t slot;
+        uint64_t calls;     ///< Completed calls.
+        uint64_t reentries; ///< Reentries into the guest made by those calls.
+        uint64_t maxDepth;  ///< Deepest crossing nesting a call ran at, 1 for a top-level call.
+        uint64_t wallTime;  ///< Total host wall time, in nanoseconds.
+        uint64_t cpuTime;   ///< Total host thread CPU time, in nanoseconds.
+        uint64_t wallHistogram[CrossingHistogramBuckets]; ///< Calls by host wall time.
+        uint64_t cpuHistogram[CrossingHistogramBuckets];  ///< Calls by host thread CPU time.
+    };
+
+    /// CrossingStatsArguments - Payload of \c DS_GetStats.
+    struct CrossingStatsArguments {
+        CrossingStatsEntry *entries; ///< Receives up to \c capacity entries, busiest first.
+        uint32_t capacity;
+        /// Receives the number of procs with statistics, which may exceed \c capacity.
+        uint32_t count;
+        uint32_t enabled; ///< Receives 1 if the host collects statistics (\c LORELEI_HOST_STATS).
+    };
+
     /// ReentryArguments - Argument block for a reentry (the host calling back into the guest).
     struct ReentryArguments {
         /// Selects which union member holds the reentry's operands.
@@ -170,6 +285,90 @@ namespace lore {
         } threadExit;
     };
 
+
+    /// AsyncCall - One slot of an \c AsyncRing: a \c CC_Standard invocation whose arguments are
+    /// copied into the slot, since the guest caller returns before the host runs it.
+    struct AsyncCall {
+        InvocationArguments ia;          ///< \c ia.standard.args points at \c args.
+        void *args[DeferredCallMaxArgs]; ///< Points into \c data.
+        alignas(16) char data[512];      ///< Argument copies, each 16-byte aligned.
+    };
+
+    /// AsyncRing - Single-producer/single-consumer queue of async calls from one guest thread.
+    ///
+    /// The host runtime allocates it (\c DS_AsyncAttach) and both sides then use it in place, like
+    /// every other pointer in this protocol. The owning guest thread is the only producer and one
+    /// host worker the only consumer, which runs the calls in order. Slot \c n % \c Size holds call
+    /// number \c n, and may be reused once \c done has passed it, so \c tail - \c done never
+    /// exceeds \c Size. The counters wrap and are compared by their signed difference. The counters
+    /// and flags are accessed atomically by both sides.
+    struct AsyncRing {
+        static constexpr uint32_t Size = 32;
+
+        uint32_t tail;        ///< Calls posted. Written by the guest.
+        uint32_t done;        ///< Calls completed. Written by the host worker.
+        uint32_t parked;      ///< Nonzero while the worker sleeps: a post then sends DS_AsyncNotify.
+        uint32_t reentry;     ///< Nonzero while the running call waits for the guest to run \c ra.
+        uint32_t event;       ///< Bumped by the worker on each completion or reentry (a futex word).
+        ReentryArguments *ra; ///< The pending reentry, valid while \c reentry is set.
+        void *worker;         ///< The host worker draining the ring. Opaque to the guest.
+        AsyncCall slots[Size];
+    };
+
+    /// TraceEventKind - What a trace event marks (see \c TraceRecorder).
+    enum TraceEventKind {
+        TE_Invoke,       ///< A call crossing. \c arg: the conv on the guest, the proc on the host.
+        TE_Resume,       ///< A host call resuming after a reentry.
+        TE_Reentry,      ///< A reentry into the guest. \c arg: its \c ServerReentryConvention.
+        TE_Batch,        ///< A \c DS_InvokeBatch. \c arg: the buffer size.
+        TE_ThreadCreate, ///< A guest thread created for the host. \c arg: its host start routine.
+        TE_ThreadExit,   ///< A guest thread exiting for the host.
+        TE_LoadLibrary,  ///< A library load. \c arg: its path, a string that is never freed.
+        NumTraceEventKind,
+    };
+
+    /// TraceEvent - One event of a \c TraceBuffer.
+    struct TraceEvent {
+        uint64_t time;  ///< \c CLOCK_MONOTONIC, in nanoseconds, which both sides read alike.
+        uint64_t arg;   ///< Per \c kind.
+        uint32_t kind;  ///< A \c TraceEventKind.
+        uint32_t phase; ///< A Chrome trace-event phase: 'B' (begin), 'E' (end) or 'i' (instant).
+    };
+
+    /// TraceBuffer - The trace ring of one thread on one side.
+    ///
+    /// Written by its thread only. Event \c n lives at \c events[n & \c mask], so once \c head
+    /// passes \c mask + 1 the oldest events are overwritten. Buffers are never freed, so the host
+    /// can read the guest's in place when it writes the trace at exit.
+    struct TraceBuffer {
+        TraceEvent *events;
+        uint64_t mask;
+        uint64_t head; ///< Events recorded.
+        uint32_t tid;  ///< The kernel thread id, which is the same on both sides of a thread.
+        uint32_t side; ///< 0 for the guest, 1 for the host.
+    };
+
+    /// TraceSubmitArguments - Payload of \c DS_TraceSubmit.
+    struct TraceSubmitArguments {
+        TraceBuffer *const *buffers;
+        uint32_t count;
+    };
+
+    /// CallbackElisionEntry - A guest function the host may call natively, as a callback of one
+    /// signature, instead of reentering the guest (see \c CallbackElision).
+    struct CallbackElisionEntry {
+        const void *guestFunction;
+        const char *hostName;  ///< The host function to call instead.
+        const char *signature; ///< The callback's \c VariadicAdaptor::callFormatBox64 signature.
+    };
+
+    /// CallbackElisionArguments - Payload of \c DS_ElideCallbacks.
+    struct CallbackElisionArguments {
+        const CallbackElisionEntry *entries;
+        uint32_t count;
+        uint32_t installed; ///< Receives how many host functions were found and installed.
+    };
+
 }
 
 #endif // LORE_DLCALL_PROTOCOL_H
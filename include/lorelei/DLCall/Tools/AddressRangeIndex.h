@@ -0,0 +1,103 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef LORE_DLCALL_ADDRESSRANGEINDEX_H
+#define LORE_DLCALL_ADDRESSRANGEINDEX_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <shared_mutex>
+#include <vector>
+
+#include <lorelei/DLCall/Global.h>
+
+namespace lore {
+
+    /// AddressRangeIndex - The address ranges owned by this side of the process, sorted for binary
+    /// search.
+    ///
+    /// The ranges are the \c PT_LOAD segments of every object in this side's link map (read with
+    /// \c dl_iterate_phdr) plus explicitly registered ones, such as trampoline tables. The guest and
+    /// the host each load their own LoreDLCall, so each side's \c instance describes that side only:
+    /// the guest's objects are mapped by the emulated loader and never appear in the host link map.
+    ///
+    /// The module ranges are rebuilt by \c rescan, which the runtimes call after they load or free a
+    /// library. Where a library is loaded or freed elsewhere on the runtime's behalf (a guest's
+    /// \c DR_LoadLibrary), the runtime calls \c noteLoaderChange instead, and the next lookup that
+    /// misses rescans. Checking for such a change costs a miss one atomic load. With the pivot split
+    /// on, which leaves only rare misses, a miss also compares the loader's load/unload counters
+    /// against the last scan, so objects loaded behind the runtime's back are found too.
+    ///
+    /// With a pivot set (see \c setPivot) and every range lying on this side's half of it, the
+    /// numeric split answers for the other half without a lookup, the way the build-time
+    /// \c LORE_CONFIG_QEMU_SUPPORT_ADDRESS_SEPARATION does. Addresses on this side's half still go
+    /// through the index. The split is rechecked on every change to the ranges.
+    class LOREDLCALL_EXPORT AddressRangeIndex {
+    public:
+        AddressRangeIndex();
+        ~AddressRangeIndex();
+
+        /// The index of this side of the process, shared by its runtime and thunks.
+        static AddressRangeIndex &instance();
+
+        /// Returns true if \a addr lies in an object loaded on this side or in a registered range.
+        bool contains(const void *addr);
+
+        /// Register \a size bytes at \a begin as belonging to this side.
+        void addRange(const void *begin, size_t size);
+
+        /// Drop a range registered with \c addRange.
+        void removeRange(const void *begin);
+
+        /// Rebuild the module ranges from the link map.
+        void rescan();
+
+        /// Record that this side's link map changed, so that every index rescans on its next miss.
+        static void noteLoaderChange();
+
+        /// Set the address splitting the two sides, with this side's objects above it when
+        /// \a localAbove is set and at or below it otherwise. The object containing \a pivot itself
+        /// is ignored when checking the layout (on the host, it is the emulator). Rescans, so the
+        /// layout is checked against the current link map. A null \a pivot turns the split off.
+        void setPivot(const void *pivot, bool localAbove);
+
+        /// Returns true if the current layout lets the pivot split answer for the other side.
+        bool isSplit() const;
+
+    protected:
+        struct Range {
+            uintptr_t begin;
+            uintptr_t end;
+            /// The object the range belongs to, as its \c dl_iterate_phdr position plus one. Zero for
+            /// a registered range.
+            uint32_t module;
+        };
+
+        void scanModules();
+        void rebuild();
+        void updateSplit();
+        bool lookup(uintptr_t addr) const;
+
+        static uint64_t loaderGeneration();
+
+        mutable std::shared_mutex m_mutex;
+        std::vector<Range> m_modules;
+        std::vector<Range> m_registered;
+        std::vector<Range> m_ranges;
+        // At the last scan: the noteLoaderChange count (UINT64_MAX before the first scan) and the
+        // loader's counters.
+        uint64_t m_changes = UINT64_MAX;
+        uint64_t m_generation = 0;
+
+        uintptr_t m_pivot = 0;
+        bool m_localAbove = false;
+
+        // The other side's half when the split is on: addresses at or below m_foreignTo, or above
+        // m_foreignFrom. Read without the lock.
+        std::atomic<uintptr_t> m_foreignTo = 0;
+        std::atomic<uintptr_t> m_foreignFrom = UINTPTR_MAX;
+    };
+
+}
+
+#endif // LORE_DLCALL_ADDRESSRANGEINDEX_H
@@ -0,0 +1,227 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef LORE_DLCALL_CALLLOG_H
+#define LORE_DLCALL_CALLLOG_H
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <lorelei/DLCall/Global.h>
+
+namespace lore {
+
+    /// The call log file layout. A \c CallLogFileHeader, then records, each a
+    /// \c CallLogRecordHeader and \c size payload bytes, padded to 8:
+    /// - \c CLR_Proc: a \c CallLogProc, then the library path, the symbol name, the signature and
+    ///   the argument roles, each null-terminated.
+    /// - \c CLR_Call: a \c CallLogCall, then \c argc argument words, the return word, \c regionCount
+    ///   regions (a \c CallLogRegion and its bytes, padded to 8), and \c callbackCount words.
+    ///
+    /// A word holds a value as the native call passed it, zero-extended. The signature is a
+    /// \c VariadicAdaptor::callFormatBox64 format, with \c ? for a type it cannot pass. Per argument
+    /// the roles hold one of:
+    /// - \c - a value, \c p a pointer to memory of unknown size,
+    /// - \c m a pointer to one object, whose bytes are recorded,
+    /// - \c s a pointer to a C string, recorded with its terminator,
+    /// - \c b a pointer to characters whose length, a \c size_t or \c ssize_t, is the next
+    ///   argument, recorded up to that length or a terminator within it,
+    /// - \c k and a return code: a function pointer (a callback), and what it returns.
+    enum CallLogRecordKind : uint32_t {
+        CLR_Proc = 1,
+        CLR_Call = 2,
+    };
+
+    enum CallLogRegionFlag : uint32_t {
+        CLRF_Before = 1, ///< The bytes as the call received them.
+        CLRF_After = 2,  ///< The bytes as the call left them. Only for a pointer to non-const.
+    };
+
+    struct CallLogFileHeader {
+        char magic[8]; ///< "LORECALL"
+        uint32_t version;
+        uint32_t reserved;
+    };
+
+    struct CallLogRecordHeader {
+        uint32_t kind;
+        uint32_t size;
+    };
+
+    struct CallLogProc {
+        uint32_t id;
+        uint32_t reserved;
+    };
+
+    struct CallLogCall {
+        uint32_t proc;
+        uint32_t tid;
+        uint32_t argc;
+        uint32_t regionCount;
+        uint32_t callbackCount;
+        uint32_t reserved;
+    };
+
+    struct CallLogRegion {
+        uint32_t arg;
+        uint32_t flags;
+        uint64_t addr;
+        uint64_t size;
+    };
+
+    /// CallRecorder - Writes a call log of the host library calls the thunks make, to re-issue
+    /// against the library alone with \c CallReplayer.
+    ///
+    /// A thunk's host Exec layer records each call it makes into the library: its arguments, the
+    /// objects and strings they point at before the call (and after, when the call may write them),
+    /// its return, and what each guest callback it reentered for returned. A call is written when
+    /// it returns, so nested calls come before the call they ran in.
+    ///
+    /// Disabled, a call costs the test of \c enabled.
+    class LOREDLCALL_EXPORT CallRecorder {
+    public:
+        static constexpr uint32_t kVersion = 1;
+
+        /// Returns true if calls are recorded.
+        static inline bool enabled() {
+            return s_enabled;
+        }
+
+        /// Start recording into \a path, truncated. Returns false, and leaves recording off, if
+        /// it cannot be created.
+        static bool start(const char *path);
+
+        /// Write out what is buffered. Called at guest exit.
+        static void flush();
+
+        /// Declare the library function at \a function, named \a name (its dynamic symbol's
+        /// name if null), with \a signature and \a roles. Returns its id for \c Call.
+        static uint32_t addProc(const void *function, const char *name, const char *signature,
+                                const char *roles);
+
+        /// Call - One call being recorded on this thread, written by \c finish.
+        class LOREDLCALL_EXPORT Call {
+        public:
+            Call(uint32_t proc, uint32_t argc);
+            ~Call();
+
+            void arg(uint32_t index, uint64_t value);
+            void region(uint32_t index, uint32_t flags, const void *addr, size_t size);
+            void finish(uint64_t ret);
+
+        protected:
+            friend class CallRecorder;
+
+            CallLogCall m_header;
+            std::vector<uint64_t> m_words;
+            std::string m_regions;
+            std::vector<uint64_t> m_callbacks;
+            Call *m_outer;
+        };
+
+        /// Record that a guest callback reentered for the call innermost on this thread returned
+        /// \a value.
+        static void callbackReturned(uint64_t value);
+
+    protected:
+        static bool s_enabled;
+    };
+
+    /// CallReplayer - Re-issues the calls of a call log against the host libraries, in the order
+    /// they were written, on one thread.
+    ///
+    /// Each argument is rebuilt from its role: an object or string is copied into memory of the
+    /// replayer's own, and a pointer the log saw before (a returned handle, a recorded object) is
+    /// mapped to its replayed counterpart, also where it appears inside a recorded object. An
+    /// object seen again only gets the bytes the caller changed since the last call left it, so
+    /// state the library keeps in it survives. A callback becomes a stub returning, in turn, what
+    /// the guest's callback returned. Memory reached through other pointers is not recorded, so a
+    /// call following one may misbehave; \c skipProc leaves it out.
+    class LOREDLCALL_EXPORT CallReplayer {
+    public:
+        struct Proc {
+            std::string library;
+            std::string name;
+            std::string signature;
+            std::string roles;
+            std::string argRoles;      ///< One role per argument, parsed from \c roles.
+            std::string callbackCodes; ///< Per argument, what a callback in it returns.
+            void *addr = nullptr;      ///< Resolved by \c resolve.
+            uint64_t calls = 0;        ///< Replayed calls.
+            uint64_t mismatches = 0;   ///< Of those, returning other than the recorded value.
+            bool skipped = false;
+        };
+
+        CallReplayer() = default;
+        ~CallReplayer();
+
+        /// Read the log at \a path. Returns false, with \c error set, if it is not one.
+        bool load(const char *path);
+
+        /// Open each proc's library, \a libraryOverrides mapping a recorded path (or its file name)
+        /// to another, and look up its symbol. A proc left unresolved, or with a signature
+        /// \c callFormatBox64 cannot pass, is skipped. Returns the number resolved.
+        size_t resolve(const std::map<std::string, std::string> &libraryOverrides = {});
+
+        /// Skip the proc named \a name.
+        void skipProc(const std::string &name);
+
+        /// Re-issue every call once. Returns the number made.
+        uint64_t replay();
+
+        inline const std::vector<Proc> &procs() const {
+            return m_procs;
+        }
+        inline size_t callCount() const {
+            return m_calls.size();
+        }
+        /// Callback returns served by the stubs, by the last \c replay.
+        inline uint64_t callbacksServed() const {
+            return m_callbacksServed;
+        }
+        inline const std::string &error() const {
+            return m_error;
+        }
+
+    protected:
+        struct Region {
+            uint32_t arg;
+            uint32_t flags;
+            uint64_t addr;
+            std::string bytes;
+        };
+
+        struct CallEntry {
+            uint32_t proc;
+            std::vector<uint64_t> args;
+            uint64_t ret;
+            std::vector<Region> regions;
+            std::vector<uint64_t> callbacks;
+        };
+
+        struct Object {
+            void *addr;        ///< The replayed counterpart.
+            size_t capacity;   ///< Bytes of the replayer's own at \c addr, 0 for the library's.
+            std::string after; ///< The recorded bytes as the last call left them.
+        };
+
+        uint64_t translate(uint64_t addr) const;
+        void copyTranslated(void *dst, const std::string &bytes, const std::string *prev) const;
+        void *placeObject(const Region &before);
+        void replayCall(const CallEntry &call);
+
+        std::vector<Proc> m_procs;
+        std::vector<CallEntry> m_calls;
+        std::map<uint64_t, Object> m_objects;
+        std::vector<void *> m_allocations;
+        std::vector<void *> m_libraries;
+        void *m_scratch = nullptr;
+        uint64_t m_callbacksServed = 0;
+        std::string m_error;
+    };
+
+}
+
+#endif // LORE_DLCALL_CALLLOG_H
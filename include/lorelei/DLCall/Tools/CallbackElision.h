@@ -0,0 +1,71 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef LORE_DLCALL_CALLBACKELISION_H
+#define LORE_DLCALL_CALLBACKELISION_H
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include <lorelei/DLCall/Global.h>
+
+namespace lore {
+
+    /// CallbackElision - Guest functions the host calls natively when the guest passes them as
+    /// callbacks, such as \c strcmp given to \c qsort.
+    ///
+    /// The guest resolves the functions named in \c LORELEI_CALLBACK_ELISION (see \c parse) in its
+    /// own libraries and sends their addresses to the host (\c DS_ElideCallbacks), which installs
+    /// the host function of the same name for each. A callback context on the host then hands over
+    /// the host function instead of a trampoline into the guest, provided the callback's signature
+    /// is the one the entry was installed with. A call through it runs natively and never reenters
+    /// the guest.
+    ///
+    /// Only functions without state of their own are elided by default, and none that reads the
+    /// locale, which the host sets apart from the guest. The allocators are opt-in: the host's
+    /// \c free cannot release a block from the guest's \c malloc, so they are only safe when every
+    /// block crosses with the callbacks that made it.
+    ///
+    /// The host's table is read without a lock: an install publishes a new copy, and copies are
+    /// never freed.
+    class LOREDLCALL_EXPORT CallbackElision {
+    public:
+        struct Rule {
+            std::string name;      ///< The guest function.
+            std::string signature; ///< Its \c VariadicAdaptor::callFormatBox64 signature.
+            std::string hostName;  ///< The host function standing in for it.
+        };
+
+        /// The rules of a \c LORELEI_CALLBACK_ELISION value, a comma-separated list applied to the
+        /// default table in order:
+        ///   - \c alloc adds the allocators (\c malloc, \c free, ...);
+        ///   - \c -name drops the rule for \c name;
+        ///   - \c name:signature or \c name:signature=hostName adds one, e.g. a trivial wrapper the
+        ///     program exports around a libc function.
+        ///
+        /// A null \a spec gives the default table; \c 0 or \c strict give none. Malformed items
+        /// are skipped and returned in \a bad, if given.
+        static std::vector<Rule> parse(const char *spec, std::vector<std::string> *bad = nullptr);
+
+        /// Returns true if any function has been installed.
+        static inline bool enabled() {
+            return s_enabled.load(std::memory_order_relaxed);
+        }
+
+        /// Call \a hostFunction in place of the guest's \a guestFunction when it is passed as a
+        /// callback of \a signature. A later install for the same guest function replaces it.
+        static void install(const void *guestFunction, void *hostFunction, const char *signature);
+
+        /// The host function installed for \a guestFunction as a callback of \a signature, or null.
+        static void *lookup(const void *guestFunction, const char *signature);
+
+        /// Drop every installed function.
+        static void clear();
+
+    protected:
+        static std::atomic<bool> s_enabled;
+    };
+
+}
+
+#endif // LORE_DLCALL_CALLBACKELISION_H
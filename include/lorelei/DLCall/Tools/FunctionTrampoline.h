@@ -6,6 +6,10 @@
 #include <cstdint>
 #include <cstddef>
 #include <cassert>
+#include <atomic>
+#include <shared_mutex>
+#include <unordered_map>
+#include <vector>
 
 #include <lorelei/DLCall/Global.h>
 
@@ -50,14 +54,92 @@ namespace lore {
         struct FunctionTrampoline trampoline[];
 
         /// Allocate an executable table of \a count trampolines that all route to \a target, each
-        /// stamped with \a magic_sign. Every instance starts with a null \c saved_function. Fill it
-        /// in before handing out the stub.
+        /// stamped with \a magic_sign. Returns \c nullptr if the mapping fails. Every instance
+        /// starts with a null \c saved_function. Fill it in before handing out the stub. The table is
+        /// registered as a range of this side's \c AddressRangeIndex until it is destroyed.
         static FunctionTrampolineTable *create(size_t count, void *target, uintptr_t magic_sign);
 
         /// Unmap and free a table returned by \c create.
         static void destroy(FunctionTrampolineTable *table);
     };
 
+    /// FunctionTrampolineArena - The process-wide pool of \c FunctionTrampoline stubs, shared by all
+    /// threads and all targets.
+    ///
+    /// Stubs are carved out of page-sized \c FunctionTrampolineTable slabs, added as the pool runs
+    /// dry. A hash index maps (target, function, owner) to the stub, so asking again for the same
+    /// triple returns the same stub. A released stub goes back to a free list, and its code is
+    /// rewritten for its next target when it is handed out again. Each release bumps \c epoch, so
+    /// callers caching stubs know when to drop them.
+    ///
+    /// The guest and the host each load their own LoreDLCall, so each side has its own arena.
+    class LOREDLCALL_EXPORT FunctionTrampolineArena {
+    public:
+        /// Occupancy counters, see \c stats.
+        struct Stats {
+            size_t slabs;      ///< Slabs mapped.
+            size_t capacity;   ///< Stubs in those slabs.
+            size_t live;       ///< Stubs handed out and not released.
+            size_t peak;       ///< Highest \c live seen.
+            uint64_t acquired; ///< Stubs handed out, not counting index hits.
+            uint64_t released; ///< Stubs released.
+        };
+
+        FunctionTrampolineArena();
+        ~FunctionTrampolineArena();
+
+        /// The arena of this side of the process.
+        static FunctionTrampolineArena &instance();
+
+        /// Return the stub that routes to \a target with \a function as its \c saved_function,
+        /// allocating one on the first request. \a owner groups stubs for \c releaseOwner (null
+        /// for stubs that live as long as the process), and \a magic_sign is stamped into the stub.
+        void *acquire(void *target, void *function, const void *owner, uintptr_t magic_sign);
+
+        /// Release the stub \a stub returned by \c acquire. No caller may still hold it.
+        void release(void *stub);
+
+        /// Release every stub acquired with \a owner. Returns how many there were.
+        size_t releaseOwner(const void *owner);
+
+        /// The number of releases so far.
+        inline uint64_t epoch() const {
+            return m_epoch.load(std::memory_order_acquire);
+        }
+
+        Stats stats() const;
+
+    protected:
+        struct Key {
+            void *target;
+            void *function;
+            const void *owner;
+
+            bool operator==(const Key &other) const {
+                return target == other.target && function == other.function &&
+                       owner == other.owner;
+            }
+        };
+
+        struct KeyHash {
+            size_t operator()(const Key &key) const;
+        };
+
+        void addSlab();
+        void recycle(FunctionTrampoline *trampoline);
+
+        mutable std::shared_mutex m_mutex;
+        std::unordered_map<Key, FunctionTrampoline *, KeyHash> m_index;
+        std::unordered_map<FunctionTrampoline *, Key> m_keys;
+        std::vector<FunctionTrampolineTable *> m_slabs;
+        std::vector<FunctionTrampoline *> m_free;
+        size_t m_capacity = 0;
+        size_t m_peak = 0;
+        uint64_t m_acquired = 0;
+        uint64_t m_released = 0;
+        std::atomic<uint64_t> m_epoch = 0;
+    };
+
 }
 
 #endif // LORE_DLCALL_FUNCTIONTRAMPOLINE_H
@@ -0,0 +1,63 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef LORE_DLCALL_PERFMAP_H
+#define LORE_DLCALL_PERFMAP_H
+
+#include <cstddef>
+#include <string>
+
+#include <lorelei/DLCall/Global.h>
+
+namespace lore {
+
+    /// PerfMap - Names for code Linux \c perf cannot symbolize on its own: the trampoline stubs,
+    /// which live in anonymous RWX slabs, and the Entry points of the thunks, whose symbols are
+    /// local and usually stripped.
+    ///
+    /// Two formats:
+    /// - \c Map appends "start size name" lines to \c /tmp/perf-<pid>.map. \c perf reads it for
+    ///   samples in anonymous memory only, so it names the stubs but not the Entries.
+    /// - \c JitDump writes \c jit-<pid>.dump records, code included, for both. Record with
+    ///   <tt>perf record -k 1</tt>, then <tt>perf inject --jit</tt> before the report. A stub
+    ///   rewritten for another callback gets a new record, so samples are named by their time.
+    ///
+    /// Each side's LoreDLCall has its own recorder. Only the host runtime starts one.
+    class LOREDLCALL_EXPORT PerfMap {
+    public:
+        enum Format {
+            Map,
+            JitDump,
+        };
+
+        /// Returns true if code loads are recorded.
+        static inline bool enabled() {
+            return s_enabled;
+        }
+
+        /// Start recording in \a format. A jitdump goes to \a dir (the current directory if null
+        /// or empty). Returns false, and leaves recording off, if the file cannot be created.
+        static bool start(Format format, const char *dir = nullptr);
+
+        /// Name the code at [\a addr, \a addr + \a size) \a name.
+        static void codeLoaded(const void *addr, size_t size, const char *name);
+
+        /// Name a trampoline stub of \a size bytes at \a stub, routing to \a target for
+        /// \a function, after both.
+        static void trampolineLoaded(const void *stub, size_t size, const void *target,
+                                     const void *function);
+
+        /// Name a thunk's proc Entry at \a addr \a name, for its symbol's size if the loader knows
+        /// it, otherwise up to \a limit. A no-op in the \c Map format.
+        static void procLoaded(const void *addr, size_t limit, const char *name);
+
+        /// The demangled name of the symbol at \a addr, or its address in hex if this side's
+        /// loader does not know one.
+        static std::string symbolName(const void *addr);
+
+    protected:
+        static bool s_enabled;
+    };
+
+}
+
+#endif // LORE_DLCALL_PERFMAP_H
@@ -0,0 +1,68 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef LORE_DLCALL_TRACERECORDER_H
+#define LORE_DLCALL_TRACERECORDER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <lorelei/DLCall/Global.h>
+#include <lorelei/DLCall/Protocol.h>
+
+namespace lore {
+
+    /// TraceRecorder - Per-thread rings of crossing events, for a Chrome trace-event timeline.
+    ///
+    /// The guest and the host each load their own LoreDLCall, so each side records into its own
+    /// rings (\c TraceBuffer). At exit the guest hands its rings to the host (\c DS_TraceSubmit),
+    /// which writes both sides into one trace: a thread is one kernel thread on both sides, so its
+    /// guest and host events nest on one track, and the gaps between them are emulation.
+    ///
+    /// Disabled, a record call costs the test of \c enabled. Enabled, it costs a clock read and a
+    /// store into the thread's ring, allocated on the thread's first event.
+    class LOREDLCALL_EXPORT TraceRecorder {
+    public:
+        /// Returns true if events are recorded.
+        static inline bool enabled() {
+            return s_enabled;
+        }
+
+        /// Start recording on \a side (0 for the guest, 1 for the host), with rings of
+        /// \a capacity events, rounded up to a power of two. Called at runtime startup.
+        static void start(uint32_t side, size_t capacity);
+
+        static inline void begin(TraceEventKind kind, uint64_t arg = 0) {
+            if (s_enabled) {
+                record(kind, 'B', arg);
+            }
+        }
+
+        static inline void end(TraceEventKind kind, uint64_t arg = 0) {
+            if (s_enabled) {
+                record(kind, 'E', arg);
+            }
+        }
+
+        static inline void instant(TraceEventKind kind, uint64_t arg = 0) {
+            if (s_enabled) {
+                record(kind, 'i', arg);
+            }
+        }
+
+        /// Append an event to this thread's ring.
+        static void record(TraceEventKind kind, uint32_t phase, uint64_t arg);
+
+        /// A copy of \a str that lives as long as the process, for a string event argument.
+        static const char *intern(const char *str);
+
+        /// The rings of every thread that recorded, including exited ones.
+        static std::vector<TraceBuffer *> buffers();
+
+    protected:
+        static bool s_enabled;
+    };
+
+}
+
+#endif // LORE_DLCALL_TRACERECORDER_H
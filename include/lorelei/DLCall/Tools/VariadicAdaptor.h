@@ -19,6 +19,29 @@ namespace lore {
     /// the call with the platform calling convention.
     class LOREDLCALL_EXPORT VariadicAdaptor {
     public:
+        /// Backend - How \c call and \c vcall make a call whose signature is only known at
+        /// runtime.
+        enum Backend {
+            /// \c vcall builds the \c va_list in place where it can; everything else goes through
+            /// ffcall. The default.
+            NativeVaList,
+            /// Every call is built by ffcall.
+            FFCall,
+            /// Every call is made by libffi, through call interfaces prepared once per sequence of
+            /// argument types. Only available if the library was built with libffi.
+            LibFFI,
+        };
+
+        /// The backend \c call and \c vcall use.
+        static Backend backend();
+
+        /// Make \c call and \c vcall use \a backend from now on. Returns false, changing nothing,
+        /// if it is not built in.
+        static bool setBackend(Backend backend);
+
+        /// Whether \a backend is built in.
+        static bool hasBackend(Backend backend);
+
         /// Selects how a format string is interpreted when extracting arguments: printf semantics
         /// (values) versus scanf semantics (pointers written through).
         enum FormatStyle {
@@ -54,7 +77,17 @@ namespace lore {
         ///     L: long long          U: unsigned long long
         ///     f: float              F: double
         ///     p: pointer            v: void (return only)
+        ///
+        /// A common format is called through its compiled invoker (see \c findFormatInvoker), and
+        /// only the others are boxed and made by \c call.
         static void callFormatBox64(void *func, const char *fmt, void **args, void *ret);
+
+        /// FormatInvoker - \c callFormatBox64 for one format, compiled as a direct call.
+        using FormatInvoker = void (*)(void *func, void **args, void *ret);
+
+        /// The compiled invoker of \a fmt, or null if \a fmt is not one of the built-in common
+        /// formats. A caller making many calls of one format can look it up once.
+        static FormatInvoker findFormatInvoker(const char *fmt);
     };
 
 }
@@ -41,7 +41,7 @@ struct CVargEntry {
         int i;
         unsigned int u;
         long l;
-        unsigned ul;
+        unsigned long ul;
         long long ll;
         unsigned long long ull;
         float f;
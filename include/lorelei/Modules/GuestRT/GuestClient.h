@@ -3,6 +3,8 @@
 #ifndef LORE_MODULES_GUESTRT_GUESTCLIENT_H
 #define LORE_MODULES_GUESTRT_GUESTCLIENT_H
 
+#include <cstdint>
+
 #include <lorelei/Support/Logging.h>
 #include <lorelei/DLCall/Protocol.h>
 #include <lorelei/DLCall/ThunkDatabase.h>
@@ -19,6 +21,9 @@ namespace lore::mod {
     /// \c getModulePath, \c invokeFunction, \c getThunkInfo) is forwarded as a \c DR_InvokeProc
     /// request to the host runtime's common entry, so that entry must be installed with
     /// \c setCommonHostEntry before any of those calls are made.
+    ///
+    /// In loopback mode (\c startLoopback) there is no QEMU: the host runtime runs in this process
+    /// and serves the requests itself, plugin-served ones included.
     class LOREGUESTRT_EXPORT GuestClient {
     public:
         GuestClient();
@@ -34,13 +39,41 @@ namespace lore::mod {
         /// \c invokeFunction (and the helpers built on it).
         static void setCommonHostEntry(void *entry);
 
+        /// Serve every request in this process instead of through the dlcall plugin: load the host
+        /// runtime \a hostRuntimePath into a new link-map namespace (\c dlmopen), so the host side
+        /// gets its own copy of every library as it does under QEMU, and hand each request to its
+        /// \c LoreLoopbackEntry. Called at guest runtime startup, before any request, when
+        /// \c LORELEI_LOOPBACK is set. Returns false, with \c dlerror set, if the host runtime
+        /// cannot be loaded.
+        static bool startLoopback(const char *hostRuntimePath);
+
     public:
         /// Map a host function address back to a callable guest (thunk) address. Used to implement
-        /// \c *GetProcAddress* -style APIs that hand the guest a raw host pointer.
+        /// \c *GetProcAddress* -style APIs that hand the guest a raw host pointer. Results, and the
+        /// guest thunks found for each host library, are cached until the next \c freeLibrary, so a
+        /// repeated conversion makes no crossing.
         static void *convertHostProcAddress(const char *name, void *addr);
 
-        /// Returns true if \a addr is a host address.
-        static bool isHostAddressNaive(void *addr);
+        /// Look up \a count symbols of the host library \a handle (null for the host's default
+        /// scope) in one crossing, writing each host address, or null, to \a addrs. Returns how many
+        /// were found.
+        static int resolveSymbols(void *handle, const char *const *names, void **addrs, int count);
+
+        /// \c resolveSymbols, then convert each address found as \c convertHostProcAddress does, so
+        /// \a addrs receives guest-callable addresses. The host reports each address's module in the
+        /// same crossing. Returns how many were found and converted.
+        static int resolveGuestSymbols(void *handle, const char *const *names, void **addrs,
+                                       int count);
+
+        /// Look up \a names in the host library holding \a hostAddr and convert what is found, in
+        /// one crossing plus one \c DS_GetThunkInfo round per library not seen before, so later
+        /// \c convertHostProcAddress calls for them are answered from the cache. Used by
+        /// \c pass::GetProcAddress in prefetch mode.
+        static void prefetchProcAddresses(void *hostAddr, const char *const *names, int count);
+
+        /// Returns true if \a addr is a host address: it lies outside every guest-loaded object and
+        /// guest trampoline table (see \c AddressRangeIndex).
+        static bool isHostAddress(void *addr);
 
     public:
         /// Query a host attribute by key (e.g. \c "emu"). Served by the dlcall plugin.
@@ -70,13 +103,31 @@ namespace lore::mod {
 
         /// Invoke a host function described by \a args, driving the reentry loop (host-to-guest
         /// callbacks, thread create/exit) until the call completes. Prefer the typed \c invoke*
-        /// helpers below.
+        /// helpers below. Async and deferred calls this thread issued earlier complete first.
         static int invokeFunction(const InvocationArguments *args);
 
+        /// Ask the host to flush every host stdio stream. Sent once, at guest exit, since qemu ends
+        /// the process without running the host's atexit handlers.
+        static void flushHostStdio();
+
+        /// Hand this side's trace rings to the host, which writes them with its own at guest exit
+        /// (\c DS_TraceSubmit). Does nothing unless \c LORELEI_TRACE_FILE turned tracing on.
+        static void submitTrace();
+
+        /// Send the host the guest functions it may call natively when they are passed as
+        /// callbacks (\c DS_ElideCallbacks): the rules of \a spec, a \c LORELEI_CALLBACK_ELISION
+        /// value (see \c CallbackElision::parse), resolved in the guest's default scope.
+        static void elideCallbacks(const char *spec);
+
         /// Look up the thunk-database entry for a library \a path. \a isReverse selects the
         /// reversed (host-to-guest) mapping instead of the forward one.
         static CThunkInfo getThunkInfo(const char *path, bool isReverse);
 
+        /// Snapshot the host's per-proc crossing statistics (\c DS_GetStats) into up to
+        /// \a capacity \a entries, busiest first. Returns the number of procs with statistics,
+        /// which may exceed \a capacity, or -1 if the host does not collect them.
+        static int getCrossingStats(CrossingStatsEntry *entries, int capacity);
+
     public:
         static inline void invokeStandard(void *proc, void **args, void *ret, void *metadata) {
             InvocationArguments ia;
@@ -88,6 +139,79 @@ namespace lore::mod {
             invokeFunction(&ia);
         }
 
+        /// Like \c invokeStandard, for a proc that never reenters the guest (\c CC_Leaf).
+        static inline void invokeLeaf(void *proc, void **args, void *ret, void *metadata) {
+            InvocationArguments ia;
+            ia.conv = CC_Leaf;
+            ia.standard.proc = proc;
+            ia.standard.args = args;
+            ia.standard.ret = ret;
+            ia.standard.metadata = metadata;
+            invokeFunction(&ia);
+        }
+
+        /// Invoke a \c CC_Register proc with its four argument words (unused ones are ignored) and
+        /// return its result word.
+        static inline uint64_t invokeRegister(void *proc, uint64_t a1, uint64_t a2, uint64_t a3,
+                                              uint64_t a4) {
+            InvocationArguments ia;
+            ia.conv = CC_Register;
+            ia.registers.proc = proc;
+            ia.registers.args[0] = a1;
+            ia.registers.args[1] = a2;
+            ia.registers.args[2] = a3;
+            ia.registers.args[3] = a4;
+            ia.registers.ret = 0;
+            invokeFunction(&ia);
+            return ia.registers.ret;
+        }
+
+        /// Like \c invokeRegister, for a proc that never reenters the guest (\c CC_RegisterLeaf).
+        static inline uint64_t invokeRegisterLeaf(void *proc, uint64_t a1, uint64_t a2,
+                                                  uint64_t a3, uint64_t a4) {
+            InvocationArguments ia;
+            ia.conv = CC_RegisterLeaf;
+            ia.registers.proc = proc;
+            ia.registers.args[0] = a1;
+            ia.registers.args[1] = a2;
+            ia.registers.args[2] = a3;
+            ia.registers.args[3] = a4;
+            ia.registers.ret = 0;
+            invokeFunction(&ia);
+            return ia.registers.ret;
+        }
+
+        /// Record a \c pass::Deferred call to \a proc (a host Entry) in this thread's command
+        /// buffer instead of crossing for it. \a argSizes gives the size of each of the \a argc
+        /// arguments, which are copied by value. The buffer is sent in one \c DS_InvokeBatch when it
+        /// fills, before any other invocation (or reentry return) from this thread, and at thread
+        /// exit.
+        static void invokeDeferred(void *proc, void **args, const unsigned *argSizes, int argc);
+
+        /// Send this thread's recorded deferred calls now, if there are any.
+        static void flushDeferred();
+
+        /// Identifies a call posted with \c invokeAsync, for \c waitAsync on the same thread.
+        using AsyncHandle = uint32_t;
+
+        /// Post a \c CC_Standard call to \a proc (a host Entry) to this thread's async ring and
+        /// return without waiting: a host worker runs it while the guest goes on. The \a argc
+        /// arguments are copied by value (\a argSizes gives their sizes). \a ret, if any, is written
+        /// by the host and must stay valid until the call completes. Calls from one thread run in
+        /// the order posted, and a reentry they make runs on this thread the next time it waits. Any
+        /// other invocation from this thread first waits for all of them (see \c drainAsync). Runs
+        /// the call synchronously when the host has no async workers or the arguments do not fit.
+        static AsyncHandle invokeAsync(void *proc, void **args, const unsigned *argSizes, int argc,
+                                       void *ret);
+
+        /// Wait for the async call \a handle (and every call posted before it) to complete,
+        /// running the reentries it needs. Must be called on the thread that posted it.
+        static void waitAsync(AsyncHandle handle);
+
+        /// Wait for every async call this thread has posted. A no-op inside a reentry of one of
+        /// those calls, which cannot complete until the reentry returns.
+        static void drainAsync();
+
         static inline void invokeStandardCallback(void *proc, void *callback, void **args,
                                                   void *ret, void *metadata) {
             InvocationArguments ia;
@@ -3,6 +3,8 @@
 #ifndef LORE_MODULES_GUESTRT_GUESTTHUNKCONTEXT_H
 #define LORE_MODULES_GUESTRT_GUESTTHUNKCONTEXT_H
 
+#include <mutex>
+#include <string>
 #include <vector>
 
 #include <lorelei/DLCall/ProcDefs.h>
@@ -14,7 +16,8 @@ namespace lore::mod {
     ///
     /// Holds the library's \c StaticThunkContext and the loaded host-thunk (HTL) handle.
     /// \c initialize brings the host thunk up so the guest's generated procs can call across the
-    /// boundary.
+    /// boundary. The callback trampolines the thunk allocates are owned by the context, which
+    /// releases them when it is destroyed.
     class LOREGUESTRT_EXPORT GuestThunkContext {
     public:
         inline GuestThunkContext(thunk::StaticThunkContext *localContext)
@@ -26,11 +29,27 @@ namespace lore::mod {
             return m_staticThunkContext;
         }
 
+        /// The owner of this thunk's callback trampolines in the \c FunctionTrampolineArena.
+        inline const void *trampolineOwner() const {
+            return this;
+        }
+
         void initialize();
 
+        /// Resolve \a name in the guest's own copy of the library this thunk stands in for, for
+        /// \c ProcPlacement: the file of this thunk's name in the first directory of
+        /// \c LORELEI_GUEST_LIBRARY_PATH (colon-separated) that has one, loaded on the first lookup.
+        /// Returns null if it has no such function or cannot be found.
+        void *guestFunction(const char *name);
+
     protected:
         thunk::StaticThunkContext *m_staticThunkContext;
         void *m_htlHandle = nullptr;
+        std::string m_modulePath;
+        std::once_flag m_guestLibraryOnce;
+        void *m_guestLibraryHandle = nullptr;
+
+        void openGuestLibrary();
     };
 
 }
@@ -0,0 +1,130 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef LORE_MODULES_GUESTRT_PROCPLACEMENT_H
+#define LORE_MODULES_GUESTRT_PROCPLACEMENT_H
+
+#include <atomic>
+#include <cstdint>
+
+#include <lorelei/Modules/GuestRT/Global.h>
+
+namespace lore::mod {
+
+    class GuestThunkContext;
+
+    /// ProcPlacement - Where the calls of one \c pass::Adaptive function run: across on the host,
+    /// or in the emulator on the guest's own copy of the library.
+    ///
+    /// Crossing costs about the same whatever the function does, while emulating it costs in
+    /// proportion to its work, so a small function can be cheaper to emulate. Each site keeps a
+    /// moving average of the guest-observed time of a call down either route. It times one call in
+    /// \c SampleInterval on its current route, and sends one in \c ProbeInterval down the other to
+    /// keep that average fresh. It switches only when the other route is faster by a quarter, so
+    /// it does not flip between two close ones. A function named in \c LORELEI_PLACEMENT stays
+    /// where it is put.
+    ///
+    /// A site is a static object of the function's Exec layer, constructed on its first call while
+    /// placement is enabled. The counters are updated without a lock: a lost sample only delays a
+    /// decision.
+    class LOREGUESTRT_EXPORT ProcPlacement {
+    public:
+        enum Route {
+            Host,
+            Guest,
+        };
+
+        /// Calls timed on the current route: one in this many.
+        static constexpr const uint32_t SampleInterval = 16;
+        /// Calls sent down the other route: one in this many.
+        static constexpr const uint32_t ProbeInterval = 512;
+        /// Calls at the start that alternate between the routes, each timed, to seed both.
+        static constexpr const uint32_t WarmupCalls = 32;
+
+        /// \a name is the function's, and must outlive the site. The guest function is resolved
+        /// from \a context's guest library now.
+        ProcPlacement(GuestThunkContext *context, const char *name);
+
+        ProcPlacement(const ProcPlacement &) = delete;
+        ProcPlacement &operator=(const ProcPlacement &) = delete;
+
+        /// Returns true if \c LORELEI_PLACEMENT is set.
+        static inline bool enabled() {
+            return s_enabled;
+        }
+
+        /// Parse \c LORELEI_PLACEMENT: a comma-separated list of \c name=host or \c name=guest
+        /// overrides, which may be empty. A null \a spec disables placement. Called once, at guest
+        /// runtime startup.
+        static void configure(const char *spec);
+
+        /// Log each site's final route, its averages and how often it switched.
+        static void report();
+
+        /// CLOCK_MONOTONIC in nanoseconds.
+        static uint64_t now();
+
+        /// The route for the next call, and whether to time it. The guest route is only returned
+        /// once the guest function is resolved.
+        inline Route route(bool &timed) {
+            if (m_fixed >= 0) {
+                timed = false;
+                return Route(m_fixed);
+            }
+            const uint64_t n = m_calls.fetch_add(1, std::memory_order_relaxed);
+            if (n < WarmupCalls) {
+                timed = true;
+                return Route(n & 1);
+            }
+            const Route current = Route(m_route.load(std::memory_order_relaxed));
+            if (n % ProbeInterval == 0) {
+                timed = true;
+                return current == Host ? Guest : Host;
+            }
+            timed = n % SampleInterval == 0;
+            return current;
+        }
+
+        /// Count a call down \a route, which took \a ns if it was timed (else 0).
+        void addCall(Route route, uint64_t ns);
+
+        /// The guest implementation, or null if the guest library does not have it.
+        inline void *guestFunction() const {
+            return m_guestFunction;
+        }
+
+        /// Times a call made down a route, for \c addCall.
+        class Timer {
+        public:
+            inline Timer(ProcPlacement &site, Route route, bool timed)
+                : m_site(site), m_route(route), m_start(timed ? now() : 0) {
+            }
+            inline ~Timer() {
+                m_site.addCall(m_route, m_start ? now() - m_start : 0);
+            }
+
+            Timer(const Timer &) = delete;
+            Timer &operator=(const Timer &) = delete;
+
+        protected:
+            ProcPlacement &m_site;
+            Route m_route;
+            uint64_t m_start;
+        };
+
+    protected:
+        const char *m_name;
+        void *m_guestFunction;
+        int m_fixed = -1; // The route a call always takes, or -1 to choose.
+        std::atomic<int> m_route = Host;
+        std::atomic<uint64_t> m_calls = 0;
+        std::atomic<uint64_t> m_routeCalls[2] = {0, 0};
+        std::atomic<uint64_t> m_average[2] = {0, 0}; // Nanoseconds, times 16; 0 before a sample.
+        std::atomic<uint32_t> m_switches = 0;
+        ProcPlacement *m_next = nullptr;
+
+        static bool s_enabled;
+    };
+
+}
+
+#endif // LORE_MODULES_GUESTRT_PROCPLACEMENT_H
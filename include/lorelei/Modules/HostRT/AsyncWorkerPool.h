@@ -0,0 +1,65 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef LORE_MODULES_HOSTRT_ASYNCWORKERPOOL_H
+#define LORE_MODULES_HOSTRT_ASYNCWORKERPOOL_H
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <lorelei/DLCall/Protocol.h>
+
+namespace lore::mod {
+
+    /// AsyncWorkerPool - The host threads that run guest async calls.
+    ///
+    /// Each guest thread that posts an async call gets an \c AsyncRing (see \c attach), assigned to
+    /// one worker round-robin. A worker drains its rings in order, runs each call through the
+    /// coroutine-based \c Invocation like a synchronous one, and parks when they all run dry. A
+    /// reentry is not run on the worker: it hands the \c ReentryArguments to the owning guest thread
+    /// through the ring and blocks until that thread, waiting in \c wait, has run it and called
+    /// \c resume. Since the call is bound to the worker's coroutine stack, the worker first hands
+    /// its other rings to a worker that is not blocked, starting a new one if there is none, so
+    /// that they keep running. Owned by \c HostServer.
+    class AsyncWorkerPool {
+    public:
+        /// Creates the pool. Its \a workerCount threads start with the first \c attach.
+        explicit AsyncWorkerPool(int workerCount);
+        ~AsyncWorkerPool();
+
+        /// Allocate a ring for a guest thread and hand it to a worker.
+        AsyncRing *attach();
+
+        /// Release a ring whose calls have all completed. Its worker frees it.
+        void detach(AsyncRing *ring);
+
+        /// Wake the worker of \a ring, which parked before the guest posted to it.
+        void notify(AsyncRing *ring);
+
+        /// Block the guest thread owning \a ring until call \a seq completes (returns 0) or the
+        /// running call needs a reentry (returns 1, with \c ring->ra set).
+        static int wait(AsyncRing *ring, uint32_t seq);
+
+        /// Let the call waiting on a reentry of \a ring continue, once the guest has run it.
+        static void resume(AsyncRing *ring);
+
+    protected:
+        class Worker;
+
+        /// Round-robin over the workers that are not blocked on a reentry, skipping \a except.
+        /// Starts a new worker if there is none. Called with \c m_mutex held.
+        Worker *pickWorker(const Worker *except);
+
+        /// Move the rings of \a from, which is about to block on a reentry of \a ring, elsewhere.
+        void handOff(Worker *from, AsyncRing *ring);
+
+        std::vector<std::unique_ptr<Worker>> m_workers;
+        std::mutex m_mutex;
+        int m_workerCount;
+        int m_next = 0;
+    };
+
+}
+
+#endif // LORE_MODULES_HOSTRT_ASYNCWORKERPOOL_H
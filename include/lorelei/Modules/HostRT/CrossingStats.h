@@ -0,0 +1,103 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef LORE_MODULES_HOSTRT_CROSSINGSTATS_H
+#define LORE_MODULES_HOSTRT_CROSSINGSTATS_H
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <lorelei/DLCall/ProcDefs.h>
+#include <lorelei/DLCall/Protocol.h>
+
+namespace lore::mod {
+
+    /// CrossingStats - Per-proc counters and latency histograms of the crossings the host serves.
+    ///
+    /// Every guest call the host runs (\c DS_InvokeFunction, a \c DS_InvokeBatch record, an async
+    /// call) is bracketed by \c begin and \c end, with \c pause and \c resume around each reentry,
+    /// so only host time is counted. Each thread keeps its own counters, keyed by the proc's host
+    /// Entry, and updates them without a lock. A snapshot (\c snapshot, \c DS_GetStats) sums the
+    /// threads and names each proc from the tables of the thunks registered with
+    /// \c registerThunk, where an Entry's index is its \c HostFunction_* or \c Callback_* slot.
+    ///
+    /// Off unless \c setEnabled is called at host runtime startup (\c LORELEI_HOST_STATS). The
+    /// instance is never destroyed, so threads that exit late can still retire their counters.
+    class CrossingStats {
+    public:
+        static CrossingStats &instance();
+
+        /// Returns true if crossings are counted.
+        static inline bool enabled() {
+            return s_enabled;
+        }
+
+        /// Turn collection on or off. Called at host runtime startup, before any crossing.
+        static void setEnabled(bool enabled);
+
+        /// Name the host Entries of a thunk's \c hostProcs tables after \a library and the table
+        /// keys. Called by \c HostThunkContext once the tables are filled, when the statistics or
+        /// the trace recorder need the names.
+        void registerThunk(const char *library, const thunk::StaticThunkContext *context);
+
+        /// Forget the names registered for \a context. Counters already taken are kept, and
+        /// reported by module path from then on.
+        void unregisterThunk(const thunk::StaticThunkContext *context);
+
+        /// Find the thunk and function names registered for the host Entry \a proc. Returns false
+        /// if no loaded thunk has it.
+        bool procName(void *proc, std::string *library, std::string *name);
+
+        /// A call to the host Entry \a proc starts on this thread.
+        void begin(void *proc);
+
+        /// The innermost call of this thread reenters the guest.
+        void pause();
+
+        /// The innermost call of this thread continues after its reentry.
+        void resume();
+
+        /// The innermost call of this thread completes.
+        void end();
+
+        /// Fill \a a with the statistics of every proc called so far (see \c DS_GetStats).
+        void snapshot(CrossingStatsArguments *a);
+
+        /// Log the statistics per library and per function. Called at guest exit.
+        void report();
+
+        struct Counters;
+        struct ThreadData;
+
+        /// Called when a thread that counted crossings exits.
+        void retire(ThreadData *data);
+
+    protected:
+        CrossingStats();
+        ~CrossingStats();
+
+        struct ProcName {
+            const std::string *library;
+            const char *name;
+            uint32_t kind;
+            uint32_t slot;
+        };
+
+        ThreadData *threadData();
+        std::vector<CrossingStatsEntry> collect();
+
+        std::mutex m_mutex;
+        std::vector<ThreadData *> m_threads;
+        std::unordered_map<void *, CrossingStatsEntry> m_retired;
+
+        std::unordered_map<const thunk::StaticThunkContext *, std::string> m_libraries;
+        std::unordered_map<void *, ProcName> m_names;
+
+        static bool s_enabled;
+    };
+
+}
+
+#endif // LORE_MODULES_HOSTRT_CROSSINGSTATS_H
@@ -3,12 +3,15 @@
 #ifndef LORE_MODULES_HOSTRT_HOSTSERVER_H
 #define LORE_MODULES_HOSTRT_HOSTSERVER_H
 
+#include <atomic>
+#include <cstdint>
 #include <filesystem>
 #include <map>
 #include <memory>
 #include <mutex>
 #include <string>
 #include <unordered_set>
+#include <vector>
 #include <cassert>
 
 #include <lorelei/DLCall/Protocol.h>
@@ -17,6 +20,8 @@
 
 namespace lore::mod {
 
+    class AsyncWorkerPool;
+
     /// HostServer - Host-side endpoint of the DLCall bridge.
     ///
     /// Lives in the host process (loaded into QEMU alongside the \c dlcall plugin) and is the
@@ -67,18 +72,93 @@ namespace lore::mod {
         /// guest can issue requests from several threads.
         void getThunkInfo(const char *path, bool isReverse, CThunkInfo *ret);
 
+        /// Set how host stdio is flushed after a completed invocation. \a everyCall flushes every
+        /// stream each time, the behaviour before the dirty check. Otherwise the standard streams are
+        /// flushed whenever they hold unwritten output, or, with a positive \a intervalMs, at most
+        /// once per that many milliseconds. Called at host runtime startup.
+        void configureStdioFlush(bool everyCall, int intervalMs);
+
+        /// Flush host stdio per the configured policy. Called after each completed invocation.
+        void flushStdioIfNeeded();
+
+        /// Flush every host stdio stream now. Answers DS_FlushStdio, which the guest sends before it
+        /// exits: qemu ends the process without running the host libc atexit handlers, so output
+        /// still buffered then would be lost.
+        static void flushStdio();
+
+        /// Set the number of host workers that run guest async calls (\c GuestClient::invokeAsync).
+        /// They start with the first guest thread to post one. 0 turns async calls off, so the guest
+        /// runs them synchronously. Called at host runtime startup.
+        void configureAsync(int workerCount);
+
+        /// Set the size of the coroutine stacks crossings run on (0 keeps the pthread default), and
+        /// whether to log the stack statistics (\c utils::Invocation::Stats) at guest exit. Called at
+        /// host runtime startup.
+        void configureStacks(size_t stackSize, bool reportStats);
+
+        /// Log the coroutine stack statistics if \c configureStacks asked for them. Called at guest
+        /// exit.
+        void reportStackStats() const;
+
+        /// Set whether every crossing is counted per proc (see \c CrossingStats), for \c DS_GetStats
+        /// and a report logged at guest exit. Called at host runtime startup.
+        void configureStats(bool enabled);
+
+        /// Set whether waits at the host's lock sites are timed (see \c LockSite), for a report
+        /// logged at guest exit. Called at host runtime startup.
+        void configureLockStats(bool enabled);
+
+        /// Log the host's lock waits, longest first, if \c configureLockStats asked for them.
+        /// Called at guest exit.
+        void reportLockStats() const;
+
+        /// Record a trace (see \c TraceRecorder) with rings of \a capacity events per thread, and
+        /// write it to \a path at guest exit. A null or empty \a path leaves tracing off. Called at
+        /// host runtime startup.
+        void configureTrace(const char *path, size_t capacity);
+
+        /// Name the trampolines and the thunks' proc Entries for Linux \c perf (see \c PerfMap):
+        /// \a mode "map" (or "1") appends to \c /tmp/perf-<pid>.map, "jitdump" writes a jitdump into
+        /// \a dir. A null or empty \a mode leaves it off. Called at host runtime startup.
+        void configurePerfMap(const char *mode, const char *dir);
+
+        /// Record the thunks' host library calls into the call log at \a path (see
+        /// \c CallRecorder), flushed at guest exit. A null or empty \a path leaves it off. Called at
+        /// host runtime startup.
+        void configureRecord(const char *path);
+
+        /// Make the host's variadic calls with \a name's \c VariadicAdaptor backend: "native"
+        /// (the default), "ffcall" or "libffi". A null or empty \a name leaves the default. Called
+        /// at host runtime startup.
+        void configureVariadicBackend(const char *name);
+
+        /// Keep the guest's trace rings for \c writeTrace. Answers DS_TraceSubmit, which the guest
+        /// sends at exit.
+        void submitGuestTrace(TraceBuffer *const *buffers, size_t count);
+
+        /// Write the guest's and the host's trace rings, if \c configureTrace asked for a trace.
+        /// Called at guest exit.
+        void writeTrace();
+
+        /// The async worker pool, or \c nullptr before \c configureAsync.
+        inline AsyncWorkerPool *asyncWorkerPool() const {
+            return m_asyncWorkerPool.get();
+        }
+
         /// Host-side reference address, set during host runtime startup. Used to tell host
         /// addresses apart from guest addresses (e.g. by the guard logic in HostThunkContext).
         static void *emuAddr;
 
-        /// Returns true if \a addr is a host address.
-        static bool isHostAddressNaive(void *addr);
+        /// Returns true if \a addr is a host address: it lies in a host-loaded object or a host
+        /// trampoline table (see \c AddressRangeIndex).
+        static bool isHostAddress(void *addr);
 
     public:
         /// Reenter the guest with a specific reentry convention. Called by host-side thunk code
         /// when a host function needs to call back into guest code mid-invocation. Delegates to the
         /// runtime's coroutine-based invocation machinery. The \c reenter* helpers below build the
-        /// \c ReentryArguments for each convention and forward here.
+        /// \c ReentryArguments for each convention and forward here. A \c CC_Leaf proc runs without a
+        /// coroutine and must never get here (the runtime aborts if it does).
         static void reenter(ReentryArguments *ra);
 
         static inline void reenterStandard(void *proc, void **args, void *ret, void *metadata) {
@@ -155,6 +235,21 @@ namespace lore::mod {
         bool m_thunkAutoDiscover = false;
         std::unordered_set<std::string> m_loadedPackPrefixes;
 
+        // Retained from configureStdioFlush(). m_lastFlushTime is the CLOCK_MONOTONIC_COARSE time of
+        // the last policy flush, in nanoseconds, shared by every guest thread.
+        bool m_flushEveryCall = false;
+        int64_t m_flushInterval = 0;
+        std::atomic<int64_t> m_lastFlushTime = 0;
+
+        std::unique_ptr<AsyncWorkerPool> m_asyncWorkerPool;
+
+        bool m_reportStackStats = false;
+
+        // Retained from configureTrace() and submitGuestTrace().
+        std::string m_traceFile;
+        std::vector<TraceBuffer *> m_guestTraceBuffers;
+        std::mutex m_traceMutex;
+
         static HostServer *self;
     };
 
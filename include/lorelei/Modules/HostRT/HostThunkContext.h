@@ -11,7 +11,8 @@ namespace lore::mod {
     /// HostThunkContext - The host runtime's per-thunk-library context.
     ///
     /// Holds the library's \c StaticThunkContext and the real host library handle. \c initialize
-    /// resolves the library so the host-side procs can invoke it.
+    /// resolves the library so the host-side procs can invoke it. The callback trampolines the
+    /// thunk allocates are owned by the context, which releases them when it is destroyed.
     class LOREHOSTRT_EXPORT HostThunkContext {
     public:
         inline HostThunkContext(thunk::StaticThunkContext *localContext)
@@ -23,6 +24,11 @@ namespace lore::mod {
             return m_staticThunkContext;
         }
 
+        /// The owner of this thunk's callback trampolines in the \c FunctionTrampolineArena.
+        inline const void *trampolineOwner() const {
+            return this;
+        }
+
         void initialize();
 
     protected:
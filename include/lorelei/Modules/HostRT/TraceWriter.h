@@ -0,0 +1,26 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef LORE_MODULES_HOSTRT_TRACEWRITER_H
+#define LORE_MODULES_HOSTRT_TRACEWRITER_H
+
+#include <vector>
+
+#include <lorelei/DLCall/Protocol.h>
+
+namespace lore::mod {
+
+    /// TraceWriter - Writes \c TraceRecorder rings as Chrome trace-event JSON, which Perfetto and
+    /// chrome://tracing open.
+    ///
+    /// Each thread is one track holding both sides' events, tagged "guest" or "host" as their
+    /// category. Host calls are named after the thunk function their Entry belongs to (see
+    /// \c CrossingStats::procName). Ends whose begin was overwritten in a full ring are dropped.
+    class TraceWriter {
+    public:
+        /// Write \a buffers to \a path. Returns false if the file cannot be written.
+        static bool write(const char *path, const std::vector<TraceBuffer *> &buffers);
+    };
+
+}
+
+#endif // LORE_MODULES_HOSTRT_TRACEWRITER_H
@@ -0,0 +1,129 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef LORE_SUPPORT_LOCKSTATS_H
+#define LORE_SUPPORT_LOCKSTATS_H
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include <lorelei/Support/Global.h>
+
+namespace lore {
+
+    class LogCategory;
+
+    /// LockSite - The time threads spent waiting at one lock site, for finding what stops the
+    /// crossings of many threads from scaling.
+    ///
+    /// A site is a static object next to the lock it counts, and is locked through
+    /// \c ProfiledLock or \c ProfiledSharedLock. An acquisition that gets the lock at once is not
+    /// counted, so the counters are only written by threads that waited anyway. Disabled, a lock
+    /// costs the test of \c enabled. Each side's LoreSupport keeps its own sites.
+    class LORESUPPORT_EXPORT LockSite {
+    public:
+        /// \a name must outlive the site; a string literal.
+        explicit LockSite(const char *name);
+
+        LockSite(const LockSite &) = delete;
+        LockSite &operator=(const LockSite &) = delete;
+
+        inline const char *name() const {
+            return m_name;
+        }
+
+        /// Returns true if waits are counted.
+        static inline bool enabled() {
+            return s_enabled;
+        }
+
+        static void setEnabled(bool enabled);
+
+        /// CLOCK_MONOTONIC in nanoseconds.
+        static uint64_t now();
+
+        /// Count one acquisition that waited \a ns nanoseconds.
+        void addWait(uint64_t ns);
+
+        struct Stats {
+            const char *name;
+            uint64_t contended; ///< Acquisitions that had to wait.
+            uint64_t waitTime;  ///< Nanoseconds waited, in total.
+            uint64_t maxWait;   ///< The longest single wait.
+        };
+
+        /// Every site that was waited at, longest total wait first.
+        static std::vector<Stats> collect();
+
+        /// Logs the sites of \c collect to \a category, one line each. Nothing if disabled.
+        static void report(LogCategory &category);
+
+    protected:
+        const char *m_name;
+        std::atomic<uint64_t> m_contended = 0;
+        std::atomic<uint64_t> m_waitTime = 0;
+        std::atomic<uint64_t> m_maxWait = 0;
+        LockSite *m_next = nullptr;
+
+        static bool s_enabled;
+    };
+
+    /// ProfiledLock - A \c std::lock_guard that counts its wait at \a site.
+    template <class Mutex>
+    class ProfiledLock {
+    public:
+        ProfiledLock(Mutex &mutex, LockSite &site) : m_mutex(mutex) {
+            if (!LockSite::enabled()) {
+                mutex.lock();
+                return;
+            }
+            if (mutex.try_lock()) {
+                return;
+            }
+            const uint64_t start = LockSite::now();
+            mutex.lock();
+            site.addWait(LockSite::now() - start);
+        }
+
+        ~ProfiledLock() {
+            m_mutex.unlock();
+        }
+
+        ProfiledLock(const ProfiledLock &) = delete;
+        ProfiledLock &operator=(const ProfiledLock &) = delete;
+
+    protected:
+        Mutex &m_mutex;
+    };
+
+    /// ProfiledSharedLock - A \c std::shared_lock that counts its wait at \a site.
+    template <class Mutex>
+    class ProfiledSharedLock {
+    public:
+        ProfiledSharedLock(Mutex &mutex, LockSite &site) : m_mutex(mutex) {
+            if (!LockSite::enabled()) {
+                mutex.lock_shared();
+                return;
+            }
+            if (mutex.try_lock_shared()) {
+                return;
+            }
+            const uint64_t start = LockSite::now();
+            mutex.lock_shared();
+            site.addWait(LockSite::now() - start);
+        }
+
+        ~ProfiledSharedLock() {
+            m_mutex.unlock_shared();
+        }
+
+        ProfiledSharedLock(const ProfiledSharedLock &) = delete;
+        ProfiledSharedLock &operator=(const ProfiledSharedLock &) = delete;
+
+    protected:
+        Mutex &m_mutex;
+    };
+
+}
+
+#endif // LORE_SUPPORT_LOCKSTATS_H
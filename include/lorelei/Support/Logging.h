@@ -100,7 +100,8 @@ namespace lore {
         /// The sink that receives every emitted record: (level, context, message).
         using LogCallback = void (*)(int, const LogContext &, const std::string_view &);
 
-        /// The process-wide sink. The default prints Success and above to stdout/stderr.
+        /// The process-wide sink. The default prints Success to stdout, and Information and above to
+        /// stderr.
         static LogCallback logCallback();
         static void setLogCallback(LogCallback callback);
 
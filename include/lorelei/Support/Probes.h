@@ -0,0 +1,39 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef LORE_SUPPORT_PROBES_H
+#define LORE_SUPPORT_PROBES_H
+
+/// LORE_PROBE(name, args...) - A USDT probe \c lorelei:name, for bpftrace, perf or SystemTap on a
+/// live process, e.g. <tt>bpftrace -e 'usdt:/path/libLoreHostRT.so:lorelei:host_invoke { ... }'</tt>.
+///
+/// With \c <sys/sdt.h> at build time the probe is a single nop plus an ELF note naming it and the
+/// locations of its operands, so nothing is called or loaded at run time. Without the header, or
+/// with \c LORE_NO_PROBES defined, it compiles to nothing. The thread is the probe context's own
+/// (\c tid in bpftrace), so no probe carries it. <tt>readelf -n</tt> lists the probes a build
+/// carries, with their operands, as \c stapsdt notes.
+///
+/// The probes, by library:
+/// - LoreHostRT:
+///   - \c host_entry(id): every \c LoreCommonHostEntry request, \a id a \c DLCallSecondaryID.
+///   - \c host_invoke(proc, conv), \c host_invoke_return(proc, conv, ret): a
+///     \c DS_InvokeFunction. \a ret is 1 if the call stopped at a reentry, 0 if it finished.
+///   - \c host_resume_return(ret): a \c DS_ResumeFunction, \a ret as above.
+///   - \c thunk_init(name, path): a host thunk initializing.
+///   - \c invocation_start(ia, depth), \c invocation_finish(ia, depth): a coroutine
+///     invocation's call running on its stack, \a depth the invocations live on the thread.
+///   - \c invocation_resume(depth), \c invocation_reenter(ra, depth): a switch into a suspended
+///     invocation, and one out of it to reenter the guest.
+/// - LoreDLCall:
+///   - \c thunk_pack(path, ok): a thunk pack's JSON loaded into a \c ThunkDatabase.
+#if defined(__has_include) && !defined(LORE_NO_PROBES)
+#  if __has_include(<sys/sdt.h>)
+#    include <sys/sdt.h>
+#    define LORE_PROBE(name, ...) STAP_PROBEV(lorelei, name, __VA_ARGS__)
+#  endif
+#endif
+
+#ifndef LORE_PROBE
+#  define LORE_PROBE(name, ...) ((void) 0)
+#endif
+
+#endif // LORE_SUPPORT_PROBES_H
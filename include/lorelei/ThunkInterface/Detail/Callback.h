@@ -3,8 +3,12 @@
 #ifndef LORE_THUNKINTERFACE_CALLBACK_H
 #define LORE_THUNKINTERFACE_CALLBACK_H
 
+#include <type_traits>
+
 #include <lorelei/BuildConfig.h>
+#include <lorelei/DLCall/Tools/CallbackElision.h>
 #include <lorelei/DLCall/Tools/FunctionTrampoline.h>
+#include <lorelei/ThunkInterface/Detail/Traits.h>
 
 #ifdef LORE_CONFIG_QEMU_SUPPORT_ADDRESS_SEPARATION
 #  define LORE_QEMU_SUPPORT_ADDRESS_SEPARATION
@@ -35,8 +39,6 @@ namespace lore {
 
 namespace lore::thunk {
 
-    static constexpr const size_t kMaxCallbackTrampolineCount = 16;
-
     /// Sentinel stamped into every trampoline block so guard code holding only a bare stub pointer
     /// can recognize it as one of ours and recover the original function (e.g. to revert a callback
     /// that has crossed back over the boundary). The value is UD2 (0F 0B) repeated: an invalid
@@ -45,31 +47,81 @@ namespace lore::thunk {
     /// offset.
     static constexpr const uintptr_t kTrampolineMagic = 0x0B0F0B0F0B0F0B0FULL;
 
-    /// GlobalTrampolineContext - Empty default \c Context for \c allocCallbackTrampoline. It
-    /// selects a single shared (thread-local) trampoline table per callback signature rather than
-    /// a per-context one.
+    /// GlobalTrampolineContext - Empty default \c Context for \c allocCallbackTrampoline. Its stubs
+    /// have no owner and live as long as the process. Any other context type owns its stubs, or,
+    /// if it has a static \c owner(), hands them to the object that returns.
     struct GlobalTrampolineContext {};
 
-    template <auto F, class Context = GlobalTrampolineContext,
-              size_t Count = kMaxCallbackTrampolineCount>
-    static auto allocCallbackTrampoline(void *input) {
+    namespace detail {
+
+        template <class Context>
+        struct TrampolineOwner {
+            static inline const char tag = 0;
+        };
+
+        template <class Context>
+        inline const void *trampolineOwner() {
+            if constexpr (std::is_same_v<Context, GlobalTrampolineContext>) {
+                return nullptr;
+            } else if constexpr (requires { Context::owner(); }) {
+                return Context::owner();
+            } else {
+                return &TrampolineOwner<Context>::tag;
+            }
+        }
+
+    }
+
+    /// Return the stub standing in for \a input in calls to \a F, allocated from the process-wide
+    /// \c FunctionTrampolineArena on first use, which dedups it across threads. \a owner groups
+    /// stubs for \c releaseCallbackTrampolines.
+    template <auto F>
+    static auto allocOwnedCallbackTrampoline(void *input, const void *owner) {
         using ReturnType = decltype(F);
         if (!input) {
             return (ReturnType) nullptr;
         }
-        static thread_local lore::FunctionTrampolineTable *trampoline = nullptr;
-        if (!trampoline) {
-            trampoline = lore::FunctionTrampolineTable::create(Count, (void *) F, kTrampolineMagic);
-        }
-        auto t = &trampoline->trampoline[0];
-        while (t->saved_function) {
-            if (t->saved_function == input) {
-                return (ReturnType) t->thunk_instr;
-            }
-            t++;
+        // Each thread remembers the last stub it got for F, which covers a callback passed on
+        // every call without taking the arena lock. Any release drops the memo.
+        static thread_local struct {
+            void *input;
+            const void *owner;
+            void *stub;
+            uint64_t epoch;
+        } last = {};
+        auto &arena = lore::FunctionTrampolineArena::instance();
+        const uint64_t epoch = arena.epoch();
+        if (last.input == input && last.owner == owner && last.epoch == epoch) {
+            return (ReturnType) last.stub;
         }
-        t->saved_function = input;
-        return (ReturnType) t->thunk_instr;
+        void *stub = arena.acquire((void *) F, input, owner, kTrampolineMagic);
+        last = {input, owner, stub, epoch};
+        return (ReturnType) stub;
+    }
+
+    /// \c allocOwnedCallbackTrampoline with the stubs owned by \a Context, a type. The default
+    /// context owns nothing, so its stubs are never released.
+    template <auto F, class Context = GlobalTrampolineContext>
+    static auto allocCallbackTrampoline(void *input) {
+        return allocOwnedCallbackTrampoline<F>(input, detail::trampolineOwner<Context>());
+    }
+
+    /// Release a stub handed out by \c allocCallbackTrampoline once its callback is dead, e.g.
+    /// after the library has unregistered it. Its slot is reused.
+    static inline void releaseCallbackTrampoline(void *stub) {
+        lore::FunctionTrampolineArena::instance().release(stub);
+    }
+
+    /// Release every stub allocated for \a owner, e.g. when the object owning the callbacks is
+    /// destroyed. Returns how many there were.
+    static inline size_t releaseCallbackTrampolines(const void *owner) {
+        return lore::FunctionTrampolineArena::instance().releaseOwner(owner);
+    }
+
+    /// \c releaseCallbackTrampolines for the stubs owned by \a Context.
+    template <class Context>
+    static size_t releaseCallbackTrampolines() {
+        return releaseCallbackTrampolines(detail::trampolineOwner<Context>());
     }
 
     static inline bool isHostAddress(void *addr)
@@ -111,7 +163,8 @@ namespace lore::thunk {
         /// Wrap \a fp so the side that will invoke it (the receiver) can call it, recording the
         /// original for \c fini to restore. \c isGuest is true when the callback belongs to the
         /// guest, so the receiver invoking it is then the host (and vice versa). \a allocator turns
-        /// a pointer foreign to the receiver into a receiver-callable trampoline.
+        /// a pointer foreign to the receiver into a receiver-callable trampoline. A guest callback
+        /// the host has a native equivalent for (see \c CallbackElision) is replaced by it instead.
         template <bool isGuest, class Alloc>
         void init(void *&fp, Alloc allocator) {
             // Resolve fp to the real callback first: a stub we handed out earlier carries its
@@ -121,6 +174,17 @@ namespace lore::thunk {
                 // real is foreign to the receiver: hand over a receiver-callable trampoline for it.
                 p_fp = &fp;
                 org_fp = fp;
+                if constexpr (isGuest) {
+                    // The allocator returns the callback's own pointer type.
+                    using Callback = decltype(allocator(real));
+                    if (CallbackElision::enabled()) {
+                        if (void *native = CallbackElision::lookup(
+                                real, detail::FormatSignature<Callback>::value)) {
+                            fp = native;
+                            return;
+                        }
+                    }
+                }
                 fp = (void *) allocator(real);
             } else if (real != fp) {
                 // fp was our stub but real is native to the receiver: pass the original through.
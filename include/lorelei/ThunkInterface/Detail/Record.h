@@ -0,0 +1,186 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef LORE_THUNKINTERFACE_RECORD_H
+#define LORE_THUNKINTERFACE_RECORD_H
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include <sys/types.h>
+
+#include <lorelei/Support/STLTraitExtras.h>
+#include <lorelei/DLCall/Tools/CallLog.h>
+#include <lorelei/ThunkInterface/Detail/Traits.h>
+
+namespace lore::thunk::detail {
+
+    // The host Exec layer's side of CallRecorder: the signature, roles and words of a library call,
+    // from the C++ types the thunk calls it with.
+
+    template <class T, class = void>
+    struct IsCompleteType : std::false_type {};
+
+    template <class T>
+    struct IsCompleteType<T, std::void_t<decltype(sizeof(T))>> : std::true_type {};
+
+    /// Stands for the argument after the last one.
+    struct RecordNoArgument {};
+
+    inline constexpr RecordNoArgument kRecordNoArgument = {};
+
+    /// Whether an argument of type \a T is a length: a \c size_t or \c ssize_t. Other integers
+    /// after a string are flags or counts of something else, as in \c dlopen(path,RTLD_NOW).
+    template <class T>
+    inline constexpr bool IsRecordLength =
+        std::is_same_v<T, size_t> || std::is_same_v<T, ssize_t>;
+
+    /// The role of an argument of type \a T followed by one of type \a Next (see
+    /// \c CallLogRecordKind). A pointer to a scalar may be an array as well as an object, so only a
+    /// pointer to a struct or a pointer is sized. A \c const \c char* followed by a length, as in
+    /// \c XML_Parse(s,len) or \c strncmp, is a buffer that need not be terminated.
+    template <class T, class Next = RecordNoArgument>
+    constexpr char recordRole() {
+        using U = std::remove_cv_t<T>;
+        using N = std::remove_cv_t<Next>;
+        if constexpr (std::is_pointer_v<U>) {
+            using P = std::remove_pointer_t<U>;
+            if constexpr (std::is_function_v<P>) {
+                return 'k';
+            } else if constexpr (std::is_same_v<P, const char>) {
+                return IsRecordLength<N> ? 'b' : 's';
+            } else if constexpr (!std::is_void_v<P> && !std::is_arithmetic_v<P> &&
+                                 !std::is_enum_v<P> && IsCompleteType<P>::value) {
+                return 'm';
+            } else {
+                return 'p';
+            }
+        } else {
+            return '-';
+        }
+    }
+
+    template <class T, class Next>
+    constexpr void appendRole(std::array<char, 64> &out, size_t &n) {
+        out[n++] = recordRole<T, Next>();
+        if constexpr (recordRole<T, Next>() == 'k') {
+            out[n++] = formatCode<return_type_of<std::remove_cv_t<T>>>();
+        }
+    }
+
+    template <class... Args, size_t... I>
+    constexpr std::array<char, 64> recordRoles(std::index_sequence<I...>) {
+        using Next = std::tuple<Args..., RecordNoArgument>;
+        std::array<char, 64> out = {};
+        size_t n = 0;
+        (appendRole<Args, std::tuple_element_t<I + 1, Next>>(out, n), ...);
+        return out;
+    }
+
+    /// RecordSignature - The signature and roles of a call of \a Fn with \a Args. A variadic
+    /// \a Fn gets a \c ? return code: \c callFormatBox64 cannot tell its fixed arguments apart.
+    template <class Fn, class Ret, class... Args>
+    struct RecordSignature {
+        static_assert(sizeof...(Args) < 32, "too many arguments to record");
+
+        static constexpr char signature[] = {
+            IsVariadicFunction<Fn>::value ? '?' : formatCode<Ret>(), '_', formatCode<Args>()...,
+            '\0'};
+
+        static constexpr std::array<char, 64> roles =
+            recordRoles<Args...>(std::index_sequence_for<Args...>());
+    };
+
+    template <class T>
+    inline uint64_t recordWord(const T &value) {
+        uint64_t word = 0;
+        if constexpr (std::is_trivially_copyable_v<T> && sizeof(T) <= sizeof(word)) {
+            std::memcpy(&word, &value, sizeof(T));
+        }
+        return word;
+    }
+
+    template <class T, class Next>
+    inline void recordRegion(CallRecorder::Call &call, uint32_t index, const T &value,
+                             const Next &next, uint32_t flags) {
+        constexpr char role = recordRole<T, Next>();
+        if constexpr (role == 'm') {
+            using P = std::remove_pointer_t<std::remove_cv_t<T>>;
+            if (value && (flags == CLRF_Before || !std::is_const_v<P>)) {
+                call.region(index, flags, value, sizeof(P));
+            }
+        } else if constexpr (role == 's') {
+            if (value && flags == CLRF_Before) {
+                call.region(index, flags, value, std::strlen(value) + 1);
+            }
+        } else if constexpr (role == 'b') {
+            // Up to the length, or a terminator within it: strncmp() and the like stop there. A
+            // length of 0 still gets its (empty) region, so the replay passes memory of its own. A
+            // negative ssize_t conventionally means "up to the terminator".
+            if (value && flags == CLRF_Before) {
+                if (static_cast<ssize_t>(next) < 0) {
+                    call.region(index, flags, value, std::strlen(value) + 1);
+                } else {
+                    const size_t size = static_cast<size_t>(next);
+                    const size_t length = strnlen(value, size);
+                    call.region(index, flags, value, length < size ? length + 1 : size);
+                }
+            }
+        }
+    }
+
+    template <class... Args, size_t... I>
+    inline void recordRegions(CallRecorder::Call &call, uint32_t flags, std::index_sequence<I...>,
+                              const Args &...args) {
+        const auto next = std::tie(args..., kRecordNoArgument);
+        (recordRegion(call, I, args, std::get<I + 1>(next), flags), ...);
+    }
+
+    /// Declares the library function \a addr, a \a Fn called with \a Args, to the recorder.
+    template <class Fn, class... Args>
+    inline uint32_t recordProc(const void *addr, const char *name) {
+        using Ret = return_type_of<Fn>;
+        using Sig = RecordSignature<Fn, Ret, std::decay_t<Args>...>;
+        return CallRecorder::addProc(addr, name, Sig::signature, Sig::roles.data());
+    }
+
+    /// Calls \a fn with \a args, recording the call as \a proc.
+    template <class Fn, class... Args>
+    inline auto recordCall(uint32_t proc, Fn fn, Args &...args) {
+        CallRecorder::Call call(proc, sizeof...(Args));
+        uint32_t i = 0;
+        ((call.arg(i, recordWord(args)), ++i), ...);
+        recordRegions(call, CLRF_Before, std::index_sequence_for<Args...>(), args...);
+
+        using Ret = decltype(fn(args...));
+        if constexpr (std::is_void_v<Ret>) {
+            fn(args...);
+            recordRegions(call, CLRF_After, std::index_sequence_for<Args...>(), args...);
+            call.finish(0);
+        } else {
+            Ret ret = fn(args...);
+            recordRegions(call, CLRF_After, std::index_sequence_for<Args...>(), args...);
+            call.finish(recordWord(ret));
+            return ret;
+        }
+    }
+
+    /// Records what a guest callback (or guest function) returning \a Ret left in \a ret.
+    template <class Ret>
+    inline void recordCallbackReturn(const void *ret) {
+        uint64_t word = 0;
+        if constexpr (!std::is_void_v<Ret>) {
+            if (ret && sizeof(Ret) <= sizeof(word)) {
+                std::memcpy(&word, ret, std::min(sizeof(Ret), sizeof(word)));
+            }
+        }
+        CallRecorder::callbackReturned(word);
+    }
+
+}
+
+#endif // LORE_THUNKINTERFACE_RECORD_H
@@ -0,0 +1,51 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef LORE_THUNKINTERFACE_REGISTER_H
+#define LORE_THUNKINTERFACE_REGISTER_H
+
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace lore::thunk {
+
+    /// RegisterFunctionThunk - The host Entry of a function crossing with \c CC_Register: up to
+    /// four scalar arguments and the scalar return, each carried as a 64-bit word.
+    using RegisterFunctionThunk = uint64_t (*)(uint64_t, uint64_t, uint64_t, uint64_t);
+
+    /// Carry a scalar (integer, enumeration, pointer or floating point, at most 8 bytes) in a
+    /// \c CC_Register word. Integers are widened per their signedness, everything else is copied
+    /// bit for bit.
+    template <class T>
+    inline uint64_t toRegister(T value) {
+        static_assert(std::is_scalar_v<T> && sizeof(T) <= sizeof(uint64_t));
+        if constexpr (std::is_integral_v<T> || std::is_enum_v<T>) {
+            return static_cast<uint64_t>(value);
+        } else if constexpr (std::is_pointer_v<T>) {
+            return reinterpret_cast<uintptr_t>(value);
+        } else {
+            uint64_t word = 0;
+            std::memcpy(&word, &value, sizeof(T));
+            return word;
+        }
+    }
+
+    /// The inverse of \c toRegister.
+    template <class T>
+    inline std::remove_cv_t<T> fromRegister(uint64_t word) {
+        using U = std::remove_cv_t<T>;
+        static_assert(std::is_scalar_v<U> && sizeof(U) <= sizeof(uint64_t));
+        if constexpr (std::is_integral_v<U> || std::is_enum_v<U>) {
+            return static_cast<U>(word);
+        } else if constexpr (std::is_pointer_v<U>) {
+            return reinterpret_cast<U>(static_cast<uintptr_t>(word));
+        } else {
+            U value;
+            std::memcpy(&value, &word, sizeof(U));
+            return value;
+        }
+    }
+
+}
+
+#endif // LORE_THUNKINTERFACE_REGISTER_H
@@ -3,10 +3,13 @@
 #ifndef LORE_THUNKINTERFACE_TRAITS_H
 #define LORE_THUNKINTERFACE_TRAITS_H
 
+#include <type_traits>
+
 namespace lore::thunk {
 
     /// CommonFunctionThunk - The uniform signature every generated function thunk presents: the
-    /// typed arguments packed as an \c args[] buffer, a return slot, and per-proc metadata.
+    /// typed arguments packed as an \c args[] buffer, a return slot, and per-proc metadata. A
+    /// function that crosses with \c CC_Register has a \c RegisterFunctionThunk host Entry instead.
     using CommonFunctionThunk = void (*)(void *[] /*args*/, void * /*ret*/, void * /*metadata*/);
 
     /// CommonCallbackThunk - Like \c CommonFunctionThunk, with a leading pointer to the guest
@@ -39,6 +42,58 @@ namespace lore::thunk {
         using type = Ret (*)(void *, Args..., ...);
     };
 
+    namespace detail {
+
+        template <class F>
+        struct IsVariadicFunction : std::false_type {};
+
+        template <class Ret, class... Args>
+        struct IsVariadicFunction<Ret (*)(Args..., ...)> : std::true_type {};
+
+        /// The \c VariadicAdaptor::callFormatBox64 code of \a T, or \c ? if it has none.
+        template <class T>
+        constexpr char formatCode() {
+            using U = std::remove_cv_t<T>;
+            if constexpr (std::is_void_v<U>) {
+                return 'v';
+            } else if constexpr (std::is_enum_v<U>) {
+                return formatCode<std::underlying_type_t<U>>();
+            } else if constexpr (std::is_pointer_v<U> || std::is_null_pointer_v<U>) {
+                return 'p';
+            } else if constexpr (std::is_same_v<U, float>) {
+                return 'f';
+            } else if constexpr (std::is_same_v<U, double>) {
+                return 'F';
+            } else if constexpr (std::is_integral_v<U> && sizeof(U) <= 8) {
+                constexpr bool s = std::is_signed_v<U>;
+                constexpr char codes[2][4] = {
+                    {'C', 'S', 'I', 'U'},
+                    {'c', 's', 'i', 'L'}
+                };
+                return codes[s][sizeof(U) == 1 ? 0 : sizeof(U) == 2 ? 1 : sizeof(U) == 4 ? 2 : 3];
+            } else {
+                return '?';
+            }
+        }
+
+        /// FormatSignature - The \c callFormatBox64 signature of the function pointer type \a F,
+        /// such as \c "i_pp" for \c int \c (*)(const \c void \c *, \c const \c void \c *), or
+        /// \c "?" for a variadic function.
+        template <class F>
+        struct FormatSignature {
+            static constexpr char value[] = "?";
+        };
+
+        template <class Ret, class... Args>
+        struct FormatSignature<Ret (*)(Args...)> {
+            static constexpr char value[] = {formatCode<Ret>(), '_', formatCode<Args>()..., '\0'};
+        };
+
+        template <class Ret, class... Args>
+        struct FormatSignature<Ret (*)(Args...) noexcept> : FormatSignature<Ret (*)(Args...)> {};
+
+    }
+
 }
 
 #endif // LORE_THUNKINTERFACE_TRAITS_H
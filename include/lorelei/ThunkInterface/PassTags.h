@@ -21,6 +21,10 @@ namespace lore::thunk::pass {
 
         /// Misc
         ID_GetProcAddress,
+        ID_Leaf,
+        ID_Deferred,
+        ID_Async,
+        ID_Adaptive,
 
         /// User
         ID_User = 0x1000,
@@ -83,12 +87,56 @@ namespace lore::thunk::pass {
 
     /// GetProcAddress - Misc tag for a \c *GetProcAddress*-style function that returns a host proc
     /// address. The pass rewrites the result into a guest-callable address. \a NameIndex is the
-    /// argument holding the symbol name. \c -1 lets TLC infer it.
-    template <int NameIndex = -1>
+    /// argument holding the symbol name. \c -1 lets TLC infer it. With \a Prefetch, the first
+    /// address returned also resolves and converts every function of this thunk in the library
+    /// holding it, in one request, so later lookups convert without crossing.
+    template <int NameIndex = -1, bool Prefetch = false>
     struct GetProcAddress : public PassTagBase {
         static constexpr const PassID ID = ID_GetProcAddress;
     };
 
+    /// Leaf - Misc tag for a function that never calls back into the guest: it runs no guest
+    /// callback, neither one it is given nor one an earlier call stored, and starts no thread that
+    /// could. The default builder then crosses it as a leaf (see \c CC_Leaf), which the host runs
+    /// on the calling stack instead of a coroutine stack that can suspend. Nothing in a signature
+    /// proves this, so untagged functions are never leaves. TLC reports an error if the tagged
+    /// function is variadic or takes a callback, or if its library imports guest functions.
+    struct Leaf : public PassTagBase {
+        static constexpr const PassID ID = ID_Leaf;
+    };
+
+    /// Deferred - Misc tag for a void function whose effect the guest does not observe right away
+    /// (a state setter, a logger, a command-stream call). The guest records the call, its arguments
+    /// copied by value, and sends the recorded calls in one crossing: when the buffer fills, before
+    /// any other call from the same thread, and at thread exit. Memory its pointer arguments refer
+    /// to must stay valid and unchanged until then. The function must not take a callback, and
+    /// since the host replays the calls without a coroutine, as it runs a \c Leaf, TLC refuses the
+    /// tag in a library that imports guest functions.
+    struct Deferred : public PassTagBase {
+        static constexpr const PassID ID = ID_Deferred;
+    };
+
+    /// Async - Misc tag for a long-running void function whose effect the guest reads only later
+    /// (compressing into a caller-owned buffer, say). The guest posts the call, its arguments copied
+    /// by value, to a host worker thread and goes on, so guest and host work overlap. Calls from one
+    /// thread run in order, and the thread's next ordinary call waits for all of them. A callback
+    /// the call runs still runs on the posting thread, once it waits. The function must not take a
+    /// callback, must not depend on host thread-local state, and its pointer arguments must stay
+    /// valid until then.
+    struct Async : public PassTagBase {
+        static constexpr const PassID ID = ID_Async;
+    };
+
+    /// Adaptive - Misc tag for a function the guest may run on its own copy of the library, in
+    /// the emulator, when that is cheaper than crossing: a small function that keeps no state of
+    /// its library's (a checksum, a conversion, a pure query). Under \c LORELEI_PLACEMENT the GTL
+    /// times both routes and sends each call down the cheaper one (see \c mod::ProcPlacement).
+    /// The guest library must be found for it, else the function always crosses. It must not be
+    /// variadic.
+    struct Adaptive : public PassTagBase {
+        static constexpr const PassID ID = ID_Adaptive;
+    };
+
 }
 
 #endif // LORE_THUNKINTERFACE_PASSTAGS_H
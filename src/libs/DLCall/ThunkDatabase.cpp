@@ -8,6 +8,7 @@
 
 #include <json11/json11.hpp>
 
+#include <lorelei/Support/Probes.h>
 #include <lorelei/Support/StringExtras.h>
 
 namespace lore {
@@ -238,6 +239,7 @@ namespace lore {
         packVars["HTL_DIR"] = hostThunkDir.string();
         const bool jsonOk = loadJsonDatabase(jsonPath, packVars, false);
         rebuildIndexes();
+        LORE_PROBE(thunk_pack, jsonPath.c_str(), int(jsonOk));
         return jsonOk;
     }
 
@@ -0,0 +1,207 @@
+// SPDX-License-Identifier: MIT
+
+#include "AddressRangeIndex.h"
+
+#include <algorithm>
+#include <mutex>
+
+#include <lorelei/Support/LockStats.h>
+
+#ifndef _WIN32
+#  include <link.h>
+#endif
+
+namespace lore {
+
+    static LockSite indexLookupSite("address index lookup");
+    static LockSite indexRescanSite("address index rescan");
+
+    // Bumped by noteLoaderChange. Each side loads its own LoreDLCall, so this counts the changes
+    // to that side's link map only.
+    static std::atomic<uint64_t> loaderChanges = 0;
+
+    AddressRangeIndex::AddressRangeIndex() = default;
+
+    AddressRangeIndex::~AddressRangeIndex() = default;
+
+    AddressRangeIndex &AddressRangeIndex::instance() {
+        static AddressRangeIndex index;
+        return index;
+    }
+
+    bool AddressRangeIndex::contains(const void *addr) {
+        const auto value = reinterpret_cast<uintptr_t>(addr);
+        if (value <= m_foreignTo.load(std::memory_order_relaxed) ||
+            value > m_foreignFrom.load(std::memory_order_relaxed)) {
+            return false;
+        }
+
+        uint64_t changes;
+        uint64_t generation;
+        {
+            ProfiledSharedLock<std::shared_mutex> lock(m_mutex, indexLookupSite);
+            if (lookup(value)) {
+                return true;
+            }
+            changes = m_changes;
+            generation = m_generation;
+        }
+
+        // A miss may be an object loaded since the last scan. The changes the runtime notes cost
+        // one atomic load to check. With the split on, the other side's addresses never get here,
+        // so a miss is rare enough to also read the loader's counters, which catch objects loaded
+        // behind the runtime's back.
+        if (loaderChanges.load(std::memory_order_acquire) == changes &&
+            (!isSplit() || loaderGeneration() == generation)) {
+            return false;
+        }
+        ProfiledLock<std::shared_mutex> lock(m_mutex, indexRescanSite);
+        if (m_changes == changes && m_generation == generation) {
+            scanModules();
+            rebuild();
+        }
+        return lookup(value);
+    }
+
+    void AddressRangeIndex::addRange(const void *begin, size_t size) {
+        const auto value = reinterpret_cast<uintptr_t>(begin);
+        std::unique_lock<std::shared_mutex> lock(m_mutex);
+        m_registered.push_back({value, value + size, 0});
+        rebuild();
+    }
+
+    void AddressRangeIndex::removeRange(const void *begin) {
+        const auto value = reinterpret_cast<uintptr_t>(begin);
+        std::unique_lock<std::shared_mutex> lock(m_mutex);
+        m_registered.erase(std::remove_if(m_registered.begin(), m_registered.end(),
+                                          [value](const Range &range) {
+                                              return range.begin == value;
+                                          }),
+                           m_registered.end());
+        rebuild();
+    }
+
+    void AddressRangeIndex::rescan() {
+        std::unique_lock<std::shared_mutex> lock(m_mutex);
+        scanModules();
+        rebuild();
+    }
+
+    void AddressRangeIndex::setPivot(const void *pivot, bool localAbove) {
+        std::unique_lock<std::shared_mutex> lock(m_mutex);
+        m_pivot = reinterpret_cast<uintptr_t>(pivot);
+        m_localAbove = localAbove;
+        scanModules();
+        rebuild();
+    }
+
+    void AddressRangeIndex::noteLoaderChange() {
+        loaderChanges.fetch_add(1, std::memory_order_release);
+    }
+
+    bool AddressRangeIndex::isSplit() const {
+        return m_foreignTo.load(std::memory_order_relaxed) != 0 ||
+               m_foreignFrom.load(std::memory_order_relaxed) != UINTPTR_MAX;
+    }
+
+#ifdef _WIN32
+    void AddressRangeIndex::scanModules() {
+        m_changes = loaderChanges.load(std::memory_order_acquire);
+        m_generation = loaderGeneration();
+    }
+
+    uint64_t AddressRangeIndex::loaderGeneration() {
+        return 0;
+    }
+#else
+    void AddressRangeIndex::scanModules() {
+        // Read before the scan, so that a change during it brings another one.
+        m_changes = loaderChanges.load(std::memory_order_acquire);
+
+        struct Scan {
+            std::vector<Range> *modules;
+            uint64_t generation;
+            uint32_t module;
+        };
+        Scan scan{&m_modules, 0, 0};
+        m_modules.clear();
+        dl_iterate_phdr(
+            [](struct dl_phdr_info *info, size_t, void *data) {
+                auto &scan = *static_cast<Scan *>(data);
+                scan.generation = info->dlpi_adds + info->dlpi_subs;
+                ++scan.module;
+                for (int i = 0; i < info->dlpi_phnum; ++i) {
+                    const auto &phdr = info->dlpi_phdr[i];
+                    if (phdr.p_type != PT_LOAD || phdr.p_memsz == 0) {
+                        continue;
+                    }
+                    const uintptr_t begin = info->dlpi_addr + phdr.p_vaddr;
+                    scan.modules->push_back({begin, begin + phdr.p_memsz, scan.module});
+                }
+                return 0;
+            },
+            &scan);
+        m_generation = scan.generation;
+    }
+
+    uint64_t AddressRangeIndex::loaderGeneration() {
+        // The counters are the same in every entry, so the first one is enough.
+        uint64_t generation = 0;
+        dl_iterate_phdr(
+            [](struct dl_phdr_info *info, size_t, void *data) {
+                *static_cast<uint64_t *>(data) = info->dlpi_adds + info->dlpi_subs;
+                return 1;
+            },
+            &generation);
+        return generation;
+    }
+#endif
+
+    void AddressRangeIndex::rebuild() {
+        m_ranges.clear();
+        m_ranges.reserve(m_modules.size() + m_registered.size());
+        m_ranges.insert(m_ranges.end(), m_modules.begin(), m_modules.end());
+        m_ranges.insert(m_ranges.end(), m_registered.begin(), m_registered.end());
+        std::sort(m_ranges.begin(), m_ranges.end(), [](const Range &lhs, const Range &rhs) {
+            return lhs.begin < rhs.begin;
+        });
+        updateSplit();
+    }
+
+    void AddressRangeIndex::updateSplit() {
+        uintptr_t foreignTo = 0;
+        uintptr_t foreignFrom = UINTPTR_MAX;
+        if (m_pivot != 0) {
+            // The object holding the pivot may straddle it.
+            uint32_t pivotModule = 0;
+            for (const auto &range : m_ranges) {
+                if (range.module != 0 && m_pivot >= range.begin && m_pivot < range.end) {
+                    pivotModule = range.module;
+                    break;
+                }
+            }
+            const bool separated = std::all_of(
+                m_ranges.begin(), m_ranges.end(), [this, pivotModule](const Range &range) {
+                    if (range.module != 0 && range.module == pivotModule) {
+                        return true;
+                    }
+                    return m_localAbove ? range.begin > m_pivot : range.end - 1 <= m_pivot;
+                });
+            if (separated) {
+                (m_localAbove ? foreignTo : foreignFrom) = m_pivot;
+            }
+        }
+        m_foreignTo.store(foreignTo, std::memory_order_relaxed);
+        m_foreignFrom.store(foreignFrom, std::memory_order_relaxed);
+    }
+
+    bool AddressRangeIndex::lookup(uintptr_t addr) const {
+        // The last range starting at or below addr is the only one that can hold it.
+        auto it = std::upper_bound(m_ranges.begin(), m_ranges.end(), addr,
+                                   [](uintptr_t value, const Range &range) {
+                                       return value < range.begin;
+                                   });
+        return it != m_ranges.begin() && addr < std::prev(it)->end;
+    }
+
+}
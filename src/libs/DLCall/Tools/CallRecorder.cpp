@@ -0,0 +1,163 @@
+// SPDX-License-Identifier: MIT
+
+#include "CallLog.h"
+
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+
+#include <dlfcn.h>
+#include <unistd.h>
+
+#include <lorelei/Support/LockStats.h>
+
+#ifdef __linux__
+#  include <sys/syscall.h>
+#endif
+
+namespace lore {
+
+    namespace {
+
+        struct Writer {
+            std::mutex mutex;
+            FILE *file = nullptr;
+            uint32_t procCount = 0;
+        };
+
+        // Never destroyed: threads may still call into the library during process teardown.
+        Writer &writer() {
+            static auto w = new Writer();
+            return *w;
+        }
+
+        LockSite writerSite("call recorder");
+
+        thread_local CallRecorder::Call *currentCall = nullptr;
+
+        uint32_t currentThreadId() {
+#ifdef __linux__
+            return static_cast<uint32_t>(syscall(SYS_gettid));
+#else
+            return 0;
+#endif
+        }
+
+        void pad8(std::string &buf) {
+            buf.append((8 - buf.size() % 8) % 8, '\0');
+        }
+
+        // Writes one record. The caller holds the writer's lock.
+        void writeRecord(Writer &w, CallLogRecordKind kind, const std::string &payload) {
+            const CallLogRecordHeader header = {kind, uint32_t(payload.size())};
+            std::fwrite(&header, sizeof(header), 1, w.file);
+            std::fwrite(payload.data(), 1, payload.size(), w.file);
+        }
+
+    }
+
+    bool CallRecorder::s_enabled = false;
+
+    bool CallRecorder::start(const char *path) {
+        auto &w = writer();
+        std::lock_guard<std::mutex> lock(w.mutex);
+        if (s_enabled) {
+            return true;
+        }
+        w.file = std::fopen(path, "wbe");
+        if (!w.file) {
+            return false;
+        }
+        // Records are written whole under the lock, so a large buffer keeps the lock short.
+        std::setvbuf(w.file, nullptr, _IOFBF, 1 << 20);
+
+        CallLogFileHeader header = {};
+        std::memcpy(header.magic, "LORECALL", sizeof(header.magic));
+        header.version = kVersion;
+        std::fwrite(&header, sizeof(header), 1, w.file);
+        s_enabled = true;
+        return true;
+    }
+
+    void CallRecorder::flush() {
+        if (!s_enabled) {
+            return;
+        }
+        auto &w = writer();
+        std::lock_guard<std::mutex> lock(w.mutex);
+        std::fflush(w.file);
+    }
+
+    uint32_t CallRecorder::addProc(const void *function, const char *name, const char *signature,
+                                   const char *roles) {
+        // The library by the function's address, so a proc names where it was actually bound.
+        Dl_info info = {};
+        const bool known = dladdr(function, &info) != 0;
+        if (!name) {
+            name = known && info.dli_sname && info.dli_saddr == function ? info.dli_sname : "";
+        }
+        const char *library = known && info.dli_fname ? info.dli_fname : "";
+
+        auto &w = writer();
+        std::lock_guard<std::mutex> lock(w.mutex);
+        const CallLogProc proc = {w.procCount++, 0};
+        std::string payload(reinterpret_cast<const char *>(&proc), sizeof(proc));
+        for (const char *str : {library, name, signature, roles}) {
+            payload.append(str).push_back('\0');
+        }
+        pad8(payload);
+        writeRecord(w, CLR_Proc, payload);
+        return proc.id;
+    }
+
+    CallRecorder::Call::Call(uint32_t proc, uint32_t argc)
+        : m_header{proc, currentThreadId(), argc, 0, 0, 0}, m_words(argc + 1),
+          m_outer(currentCall) {
+        currentCall = this;
+    }
+
+    CallRecorder::Call::~Call() {
+        if (currentCall == this) {
+            currentCall = m_outer;
+        }
+    }
+
+    void CallRecorder::Call::arg(uint32_t index, uint64_t value) {
+        m_words[index] = value;
+    }
+
+    void CallRecorder::Call::region(uint32_t index, uint32_t flags, const void *addr,
+                                    size_t size) {
+        const CallLogRegion region = {index, flags, uint64_t(uintptr_t(addr)), size};
+        m_regions.append(reinterpret_cast<const char *>(&region), sizeof(region));
+        m_regions.append(static_cast<const char *>(addr), size);
+        pad8(m_regions);
+        m_header.regionCount++;
+    }
+
+    void CallRecorder::Call::finish(uint64_t ret) {
+        if (currentCall == this) {
+            currentCall = m_outer;
+        }
+        m_words[m_header.argc] = ret;
+        m_header.callbackCount = uint32_t(m_callbacks.size());
+
+        std::string payload(reinterpret_cast<const char *>(&m_header), sizeof(m_header));
+        payload.append(reinterpret_cast<const char *>(m_words.data()),
+                       m_words.size() * sizeof(uint64_t));
+        payload.append(m_regions);
+        payload.append(reinterpret_cast<const char *>(m_callbacks.data()),
+                       m_callbacks.size() * sizeof(uint64_t));
+
+        auto &w = writer();
+        ProfiledLock<std::mutex> lock(w.mutex, writerSite);
+        writeRecord(w, CLR_Call, payload);
+    }
+
+    void CallRecorder::callbackReturned(uint64_t value) {
+        if (auto call = currentCall) {
+            call->m_callbacks.push_back(value);
+        }
+    }
+
+}
@@ -0,0 +1,444 @@
+// SPDX-License-Identifier: MIT
+
+#include "CallLog.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#include <dlfcn.h>
+
+#include "VariadicAdaptor.h"
+
+namespace lore {
+
+    namespace {
+
+        // What an unsized pointer the log never saw points at instead: zeroed, and shared.
+        static constexpr size_t kScratchSize = 64 * 1024;
+
+        // The callback returns of the call being replayed, popped by the stubs in turn.
+        struct CallbackQueue {
+            const std::vector<uint64_t> *values = nullptr;
+            size_t next = 0;
+            uint64_t served = 0;
+        };
+
+        CallbackQueue callbackQueue;
+
+        uint64_t nextCallbackReturn() {
+            auto &q = callbackQueue;
+            if (!q.values || q.next >= q.values->size()) {
+                return 0;
+            }
+            q.served++;
+            return (*q.values)[q.next++];
+        }
+
+        // The callback stubs. A caller passing them arguments is harmless: they read none.
+        uint64_t stubWord() {
+            return nextCallbackReturn();
+        }
+
+        float stubFloat() {
+            const uint64_t value = nextCallbackReturn();
+            float f;
+            std::memcpy(&f, &value, sizeof(f));
+            return f;
+        }
+
+        double stubDouble() {
+            const uint64_t value = nextCallbackReturn();
+            double d;
+            std::memcpy(&d, &value, sizeof(d));
+            return d;
+        }
+
+        void stubVoid() {
+            (void) nextCallbackReturn();
+        }
+
+        void *callbackStub(char code) {
+            switch (code) {
+                case 'f':
+                    return reinterpret_cast<void *>(stubFloat);
+                case 'F':
+                    return reinterpret_cast<void *>(stubDouble);
+                case 'v':
+                case '?':
+                    return reinterpret_cast<void *>(stubVoid);
+                default:
+                    return reinterpret_cast<void *>(stubWord);
+            }
+        }
+
+        // The bytes of a return word a value of \a code fills.
+        uint64_t returnMask(char code) {
+            switch (code) {
+                case 'c':
+                case 'C':
+                    return 0xFF;
+                case 's':
+                case 'S':
+                    return 0xFFFF;
+                case 'i':
+                case 'I':
+                case 'f':
+                    return 0xFFFFFFFF;
+                default:
+                    return ~uint64_t(0);
+            }
+        }
+
+        bool signatureSupported(const std::string &signature) {
+            if (signature.size() < 2 || signature[1] != '_' ||
+                signature.find('?') != std::string::npos) {
+                return false;
+            }
+            return signature.find('v', 2) == std::string::npos;
+        }
+
+        // A cursor over the loaded log, reading nothing past its end.
+        struct Reader {
+            const char *p;
+            const char *end;
+
+            template <class T>
+            bool read(T &out) {
+                if (size_t(end - p) < sizeof(T)) {
+                    return false;
+                }
+                std::memcpy(&out, p, sizeof(T));
+                p += sizeof(T);
+                return true;
+            }
+
+            bool readBytes(std::string &out, size_t size) {
+                if (size_t(end - p) < size) {
+                    return false;
+                }
+                out.assign(p, size);
+                p += (size + 7) & ~size_t(7);
+                if (p > end) {
+                    p = end;
+                }
+                return true;
+            }
+
+            bool readString(std::string &out) {
+                const void *nul = std::memchr(p, '\0', size_t(end - p));
+                if (!nul) {
+                    return false;
+                }
+                out.assign(p, static_cast<const char *>(nul));
+                p = static_cast<const char *>(nul) + 1;
+                return true;
+            }
+        };
+
+    }
+
+    CallReplayer::~CallReplayer() {
+        for (auto mem : m_allocations) {
+            std::free(mem);
+        }
+        std::free(m_scratch);
+        // The libraries stay loaded: they may have registered exit handlers of their own.
+    }
+
+    bool CallReplayer::load(const char *path) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in) {
+            m_error = std::string("cannot open ") + path;
+            return false;
+        }
+        std::stringstream ss;
+        ss << in.rdbuf();
+        const std::string data = ss.str();
+
+        Reader file = {data.data(), data.data() + data.size()};
+        CallLogFileHeader header;
+        if (!file.read(header) || std::memcmp(header.magic, "LORECALL", sizeof(header.magic)) != 0) {
+            m_error = std::string(path) + " is not a call log";
+            return false;
+        }
+        if (header.version != CallRecorder::kVersion) {
+            m_error = std::string(path) + ": unsupported call log version " +
+                      std::to_string(header.version);
+            return false;
+        }
+
+        CallLogRecordHeader record;
+        while (file.read(record)) {
+            if (size_t(file.end - file.p) < record.size) {
+                // A log cut short by a process that did not exit cleanly: keep what is whole.
+                break;
+            }
+            Reader payload = {file.p, file.p + record.size};
+            file.p += record.size;
+
+            if (record.kind == CLR_Proc) {
+                CallLogProc proc;
+                Proc entry;
+                if (!payload.read(proc) || !payload.readString(entry.library) ||
+                    !payload.readString(entry.name) || !payload.readString(entry.signature) ||
+                    !payload.readString(entry.roles)) {
+                    m_error = "malformed proc record";
+                    return false;
+                }
+                for (size_t i = 0; i < entry.roles.size(); ++i) {
+                    const char role = entry.roles[i];
+                    entry.argRoles.push_back(role);
+                    if (role == 'k' && i + 1 < entry.roles.size()) {
+                        entry.callbackCodes.push_back(entry.roles[++i]);
+                    } else {
+                        entry.callbackCodes.push_back('v');
+                    }
+                }
+                if (proc.id >= m_procs.size()) {
+                    m_procs.resize(proc.id + 1);
+                }
+                m_procs[proc.id] = std::move(entry);
+                continue;
+            }
+
+            if (record.kind != CLR_Call) {
+                continue;
+            }
+            CallLogCall call;
+            CallEntry entry;
+            if (!payload.read(call) || call.proc >= m_procs.size()) {
+                m_error = "malformed call record";
+                return false;
+            }
+            entry.proc = call.proc;
+            entry.args.resize(call.argc);
+            for (auto &arg : entry.args) {
+                payload.read(arg);
+            }
+            payload.read(entry.ret);
+            for (uint32_t i = 0; i < call.regionCount; ++i) {
+                CallLogRegion region;
+                Region r;
+                if (!payload.read(region) || !payload.readBytes(r.bytes, region.size)) {
+                    m_error = "malformed call record";
+                    return false;
+                }
+                r.arg = region.arg;
+                r.flags = region.flags;
+                r.addr = region.addr;
+                entry.regions.push_back(std::move(r));
+            }
+            entry.callbacks.resize(call.callbackCount);
+            for (auto &value : entry.callbacks) {
+                payload.read(value);
+            }
+            m_calls.push_back(std::move(entry));
+        }
+        return true;
+    }
+
+    size_t CallReplayer::resolve(const std::map<std::string, std::string> &libraryOverrides) {
+        std::map<std::string, void *> handles;
+        size_t resolved = 0;
+        for (auto &proc : m_procs) {
+            if (proc.skipped || proc.library.empty() || proc.name.empty() ||
+                !signatureSupported(proc.signature)) {
+                proc.skipped = true;
+                continue;
+            }
+
+            std::string path = proc.library;
+            if (auto it = libraryOverrides.find(path); it != libraryOverrides.end()) {
+                path = it->second;
+            } else if (auto slash = path.rfind('/'); slash != std::string::npos) {
+                if (auto it2 = libraryOverrides.find(path.substr(slash + 1));
+                    it2 != libraryOverrides.end()) {
+                    path = it2->second;
+                }
+            }
+
+            auto &handle = handles[path];
+            if (!handle) {
+                handle = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+                if (handle) {
+                    m_libraries.push_back(handle);
+                }
+            }
+            proc.addr = handle ? dlsym(handle, proc.name.c_str()) : nullptr;
+            if (!proc.addr) {
+                proc.skipped = true;
+                continue;
+            }
+            resolved++;
+        }
+        return resolved;
+    }
+
+    void CallReplayer::skipProc(const std::string &name) {
+        for (auto &proc : m_procs) {
+            if (proc.name == name) {
+                proc.skipped = true;
+            }
+        }
+    }
+
+    uint64_t CallReplayer::replay() {
+        // Each pass starts from nothing, like the recorded process did.
+        for (auto mem : m_allocations) {
+            std::free(mem);
+        }
+        m_allocations.clear();
+        m_objects.clear();
+        if (!m_scratch) {
+            m_scratch = std::calloc(1, kScratchSize);
+        }
+
+        callbackQueue = {};
+        uint64_t count = 0;
+        for (const auto &call : m_calls) {
+            if (m_procs[call.proc].skipped) {
+                continue;
+            }
+            replayCall(call);
+            count++;
+        }
+        m_callbacksServed = callbackQueue.served;
+        callbackQueue = {};
+        return count;
+    }
+
+    uint64_t CallReplayer::translate(uint64_t addr) const {
+        if (auto it = m_objects.find(addr); it != m_objects.end()) {
+            return uint64_t(uintptr_t(it->second.addr));
+        }
+        return addr;
+    }
+
+    void CallReplayer::copyTranslated(void *dst, const std::string &bytes,
+                                      const std::string *prev) const {
+        auto out = static_cast<char *>(dst);
+        const size_t words = bytes.size() / 8;
+        for (size_t i = 0; i < words; ++i) {
+            uint64_t word;
+            std::memcpy(&word, bytes.data() + i * 8, 8);
+            if (prev && std::memcmp(prev->data() + i * 8, &word, 8) == 0) {
+                continue;
+            }
+            word = translate(word);
+            std::memcpy(out + i * 8, &word, 8);
+        }
+        for (size_t i = words * 8; i < bytes.size(); ++i) {
+            if (!prev || (*prev)[i] != bytes[i]) {
+                out[i] = bytes[i];
+            }
+        }
+    }
+
+    void *CallReplayer::placeObject(const Region &before) {
+        const size_t size = before.bytes.size();
+        auto it = m_objects.find(before.addr);
+        if (it != m_objects.end()) {
+            auto &obj = it->second;
+            if (obj.after.size() == size) {
+                // Seen before at this size: only what the caller changed since.
+                copyTranslated(obj.addr, before.bytes, &obj.after);
+                obj.after = before.bytes;
+                return obj.addr;
+            }
+            if (obj.capacity == 0) {
+                // The library's own object, first seen by content: its bytes are already its own.
+                obj.after = before.bytes;
+                return obj.addr;
+            }
+            if (obj.capacity >= size) {
+                copyTranslated(obj.addr, before.bytes, nullptr);
+                obj.after = before.bytes;
+                return obj.addr;
+            }
+        }
+
+        // Rounded up, and never under a word, so a library reading a little past a string or a
+        // short object stays in bounds.
+        const size_t capacity = std::max<size_t>((size + 15) & ~size_t(15), 16);
+        void *mem = std::calloc(1, capacity);
+        m_allocations.push_back(mem);
+        copyTranslated(mem, before.bytes, nullptr);
+        m_objects[before.addr] = {mem, capacity, before.bytes};
+        return mem;
+    }
+
+    void CallReplayer::replayCall(const CallEntry &call) {
+        auto &proc = m_procs[call.proc];
+        const size_t argc = call.args.size();
+
+        std::vector<uint64_t> values(call.args);
+        std::vector<void *> argPtrs(argc);
+        for (size_t i = 0; i < argc; ++i) {
+            const char role = i < proc.argRoles.size() ? proc.argRoles[i] : '-';
+            uint64_t &value = values[i];
+            switch (role) {
+                case 'p':
+                    // A handle the replay got back may equal the recorded one, as dlopen's does.
+                    if (value) {
+                        auto it = m_objects.find(value);
+                        value = it != m_objects.end() ? uint64_t(uintptr_t(it->second.addr))
+                                                      : uint64_t(uintptr_t(m_scratch));
+                    }
+                    break;
+                case 'm':
+                case 's':
+                case 'b': {
+                    auto region = std::find_if(call.regions.begin(), call.regions.end(),
+                                               [i](const Region &r) {
+                                                   return r.arg == i && (r.flags & CLRF_Before);
+                                               });
+                    if (region != call.regions.end()) {
+                        value = uint64_t(uintptr_t(placeObject(*region)));
+                    } else if (value) {
+                        value = translate(value);
+                    }
+                    break;
+                }
+                case 'k':
+                    if (value) {
+                        value = uint64_t(uintptr_t(callbackStub(proc.callbackCodes[i])));
+                    }
+                    break;
+                default:
+                    break;
+            }
+            argPtrs[i] = &value;
+        }
+
+        callbackQueue.values = &call.callbacks;
+        callbackQueue.next = 0;
+
+        uint64_t ret = 0;
+        VariadicAdaptor::callFormatBox64(proc.addr, proc.signature.c_str(), argPtrs.data(), &ret);
+
+        callbackQueue.values = nullptr;
+        proc.calls++;
+
+        const char retCode = proc.signature[0];
+        if (retCode == 'p') {
+            // A handle the library returned: later calls passing the recorded one get this one.
+            if (call.ret && ret) {
+                m_objects[call.ret] = {reinterpret_cast<void *>(uintptr_t(ret)), 0, {}};
+            }
+        } else if (retCode != 'v' && ((ret ^ call.ret) & returnMask(retCode)) != 0) {
+            proc.mismatches++;
+        }
+
+        for (const auto &region : call.regions) {
+            if (region.flags & CLRF_After) {
+                if (auto it = m_objects.find(region.addr); it != m_objects.end()) {
+                    it->second.after = region.bytes;
+                }
+            }
+        }
+    }
+
+}
@@ -0,0 +1,193 @@
+// SPDX-License-Identifier: MIT
+
+#include "CallbackElision.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+
+namespace lore {
+
+    namespace {
+
+        struct DefaultRule {
+            const char *name;
+            const char *signature;
+            bool alloc;
+        };
+
+        // Signatures are callFormatBox64's: size_t is 'U' and int is 'i'. Nothing that reads the
+        // locale (strcoll, strcasecmp, ...): the host's is not the guest's.
+        const DefaultRule defaultRules[] = {
+            {"strcmp",      "i_pp",  false},
+            {"strncmp",     "i_ppU", false},
+            {"memcmp",      "i_ppU", false},
+            {"strlen",      "U_p",   false},
+            {"memcpy",      "p_ppU", false},
+            {"memmove",     "p_ppU", false},
+            {"memset",      "p_piU", false},
+            {"malloc",      "p_U",   true },
+            {"calloc",      "p_UU",  true },
+            {"realloc",     "p_pU",  true },
+            {"free",        "v_p",   true },
+            {"strdup",      "p_p",   true },
+            {"strndup",     "p_pU",  true },
+        };
+
+        bool isValidSignature(const std::string &sig) {
+            if (sig.size() < 2 || sig[1] != '_' || !std::strchr("vcsiLCSIUpfF", sig[0])) {
+                return false;
+            }
+            return std::all_of(sig.begin() + 2, sig.end(), [](char c) {
+                return c && std::strchr("csiLCSIUpfF", c);
+            });
+        }
+
+        struct Entry {
+            uintptr_t guestFunction;
+            void *hostFunction;
+            std::string signature;
+        };
+
+        // Sorted by guest address.
+        using Table = std::vector<Entry>;
+
+        std::atomic<const Table *> currentTable = nullptr;
+        std::mutex installMutex;
+
+        // Never destroyed: a reader may still hold any table that was ever published.
+        std::vector<const Table *> &retiredTables() {
+            static auto list = new std::vector<const Table *>();
+            return *list;
+        }
+
+        void publish(const Table *table) {
+            if (auto old = currentTable.exchange(table, std::memory_order_acq_rel)) {
+                retiredTables().push_back(old);
+            }
+        }
+
+    }
+
+    std::atomic<bool> CallbackElision::s_enabled = false;
+
+    std::vector<CallbackElision::Rule> CallbackElision::parse(const char *spec,
+                                                              std::vector<std::string> *bad) {
+        std::vector<Rule> rules;
+        if (spec && (std::strcmp(spec, "0") == 0 || std::strcmp(spec, "strict") == 0)) {
+            return rules;
+        }
+        for (const auto &rule : defaultRules) {
+            if (!rule.alloc) {
+                rules.push_back({rule.name, rule.signature, rule.name});
+            }
+        }
+        if (!spec) {
+            return rules;
+        }
+
+        const auto drop = [&rules](const std::string &name) {
+            rules.erase(std::remove_if(rules.begin(), rules.end(),
+                                       [&name](const Rule &rule) {
+                                           return rule.name == name;
+                                       }),
+                        rules.end());
+        };
+
+        for (const char *item = spec; *item;) {
+            const char *end = std::strchr(item, ',');
+            if (!end) {
+                end = item + std::strlen(item);
+            }
+            const std::string token(item, end);
+            item = *end ? end + 1 : end;
+
+            if (token.empty() || token == "1") {
+                continue; // "1": the defaults.
+            }
+            if (token == "alloc") {
+                for (const auto &rule : defaultRules) {
+                    if (rule.alloc) {
+                        drop(rule.name);
+                        rules.push_back({rule.name, rule.signature, rule.name});
+                    }
+                }
+                continue;
+            }
+            if (token[0] == '-') {
+                drop(token.substr(1));
+                continue;
+            }
+
+            const auto colon = token.find(':');
+            if (colon == std::string::npos || colon == 0) {
+                if (bad) {
+                    bad->push_back(token);
+                }
+                continue;
+            }
+            const auto eq = token.find('=', colon);
+            Rule rule;
+            rule.name = token.substr(0, colon);
+            rule.signature = token.substr(colon + 1, eq == std::string::npos ? eq : eq - colon - 1);
+            rule.hostName = eq == std::string::npos ? rule.name : token.substr(eq + 1);
+            if (!isValidSignature(rule.signature) || rule.hostName.empty()) {
+                if (bad) {
+                    bad->push_back(token);
+                }
+                continue;
+            }
+            drop(rule.name);
+            rules.push_back(std::move(rule));
+        }
+        return rules;
+    }
+
+    void CallbackElision::install(const void *guestFunction, void *hostFunction,
+                                  const char *signature) {
+        if (!guestFunction || !hostFunction) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(installMutex);
+        const auto old = currentTable.load(std::memory_order_relaxed);
+        auto table = old ? new Table(*old) : new Table();
+
+        const auto key = uintptr_t(guestFunction);
+        const auto it = std::lower_bound(table->begin(), table->end(), key,
+                                         [](const Entry &entry, uintptr_t key) {
+                                             return entry.guestFunction < key;
+                                         });
+        if (it != table->end() && it->guestFunction == key) {
+            it->hostFunction = hostFunction;
+            it->signature = signature;
+        } else {
+            table->insert(it, {key, hostFunction, signature});
+        }
+        publish(table);
+        s_enabled.store(true, std::memory_order_relaxed);
+    }
+
+    void *CallbackElision::lookup(const void *guestFunction, const char *signature) {
+        const auto table = currentTable.load(std::memory_order_acquire);
+        if (!table) {
+            return nullptr;
+        }
+        const auto key = uintptr_t(guestFunction);
+        const auto it = std::lower_bound(table->begin(), table->end(), key,
+                                         [](const Entry &entry, uintptr_t key) {
+                                             return entry.guestFunction < key;
+                                         });
+        if (it == table->end() || it->guestFunction != key || it->signature != signature) {
+            return nullptr;
+        }
+        return it->hostFunction;
+    }
+
+    void CallbackElision::clear() {
+        std::lock_guard<std::mutex> lock(installMutex);
+        s_enabled.store(false, std::memory_order_relaxed);
+        publish(nullptr);
+    }
+
+}
@@ -0,0 +1,191 @@
+// SPDX-License-Identifier: MIT
+
+#include "FormatCache.h"
+
+#include <cstddef>
+#include <cstring>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+
+#include <lorelei/Support/LockStats.h>
+#include <lorelei/DLCall/Tools/VariadicArgDefs.h>
+
+namespace lore {
+
+    namespace {
+
+        constexpr const int ShardBits = 4;
+
+        struct Shard {
+            std::shared_mutex mutex;
+            std::unordered_map<const char *, FormatCache::Format *> formats;
+        };
+
+        // Never destroyed: threads may still format during process teardown.
+        Shard *shards() {
+            static auto list = new Shard[1 << ShardBits];
+            return list;
+        }
+
+        LockSite cacheSite("format cache");
+
+        Shard &shardOf(const char *fmt) {
+            const auto hash = uint64_t(uintptr_t(fmt)) * 0x9E3779B97F4A7C15ull;
+            return shards()[hash >> (64 - ShardBits)];
+        }
+
+        inline bool isDigit(char c) {
+            return c >= '0' && c <= '9';
+        }
+
+    }
+
+    const FormatCache::Format *FormatCache::find(const char *fmt) {
+        auto &shard = shardOf(fmt);
+        {
+            ProfiledSharedLock<std::shared_mutex> lock(shard.mutex, cacheSite);
+            const auto it = shard.formats.find(fmt);
+            if (it != shard.formats.end()) {
+                const auto format = it->second;
+                if (format->unstable.load(std::memory_order_relaxed)) {
+                    return nullptr;
+                }
+                if (format->text != fmt) {
+                    format->unstable.store(true, std::memory_order_relaxed);
+                    return nullptr;
+                }
+                return format;
+            }
+            if (shard.formats.size() >= ShardCapacity) {
+                return nullptr;
+            }
+        }
+
+        auto format = new Format();
+        format->text = fmt;
+        parse(fmt, format->kinds);
+
+        ProfiledLock<std::shared_mutex> lock(shard.mutex, cacheSite);
+        const auto result = shard.formats.emplace(fmt, format);
+        if (!result.second) {
+            // Another thread parsed it first.
+            delete format;
+            format = result.first->second;
+            if (format->unstable.load(std::memory_order_relaxed) || format->text != fmt) {
+                return nullptr;
+            }
+        }
+        return format;
+    }
+
+    void FormatCache::parse(const char *fmt, std::vector<uint8_t> &kinds) {
+        // Mirrors the specifier parsing of mp_vsnprintf, which the fallback path still runs, so
+        // both consume the same arguments. The '%' search is libc's vectorized strchr.
+        for (const char *p = std::strchr(fmt, '%'); p; p = std::strchr(p, '%')) {
+            ++p;
+
+            // Flags.
+            while (*p == '0' || *p == '-' || *p == '+' || *p == ' ' || *p == '#') {
+                ++p;
+            }
+
+            // Width.
+            if (isDigit(*p)) {
+                while (isDigit(*p)) {
+                    ++p;
+                }
+            } else if (*p == '*') {
+                kinds.push_back(CVargType_Int);
+                ++p;
+            }
+
+            // Precision.
+            if (*p == '.') {
+                ++p;
+                if (isDigit(*p)) {
+                    while (isDigit(*p)) {
+                        ++p;
+                    }
+                } else if (*p == '*') {
+                    kinds.push_back(CVargType_Int);
+                    ++p;
+                }
+            }
+
+            // Length: 0 for int, 1 for long, 2 for long long.
+            int length = 0;
+            switch (*p) {
+                case 'l':
+                    length = 1;
+                    if (*++p == 'l') {
+                        length = 2;
+                        ++p;
+                    }
+                    break;
+                case 'h':
+                    if (*++p == 'h') {
+                        ++p;
+                    }
+                    break;
+                case 't':
+                    length = sizeof(ptrdiff_t) == sizeof(long) ? 1 : 2;
+                    ++p;
+                    break;
+                case 'j':
+                    length = sizeof(intmax_t) == sizeof(long) ? 1 : 2;
+                    ++p;
+                    break;
+                case 'z':
+                    length = sizeof(size_t) == sizeof(long) ? 1 : 2;
+                    ++p;
+                    break;
+                default:
+                    break;
+            }
+
+            // Specifier.
+            switch (*p) {
+                case 'd':
+                case 'i': {
+                    static constexpr const uint8_t types[] = {CVargType_Int, CVargType_Long,
+                                                              CVargType_LongLong};
+                    kinds.push_back(types[length]);
+                    break;
+                }
+                case 'u':
+                case 'x':
+                case 'X':
+                case 'o':
+                case 'b': {
+                    static constexpr const uint8_t types[] = {CVargType_UInt, CVargType_ULong,
+                                                              CVargType_ULongLong};
+                    kinds.push_back(types[length]);
+                    break;
+                }
+                case 'f':
+                case 'F':
+                case 'e':
+                case 'E':
+                case 'g':
+                case 'G':
+                    kinds.push_back(CVargType_Double);
+                    break;
+                case 'c':
+                    kinds.push_back(CVargType_Int);
+                    break;
+                case 's':
+                case 'p':
+                    kinds.push_back(CVargType_Pointer);
+                    break;
+                case '\0':
+                    return;
+                default:
+                    // "%%" and anything unknown take no argument.
+                    break;
+            }
+            ++p;
+        }
+    }
+
+}
@@ -0,0 +1,45 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef LORE_DLCALL_FORMATCACHE_H
+#define LORE_DLCALL_FORMATCACHE_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace lore {
+
+    /// FormatCache - The arguments of printf format strings, parsed once per string, for
+    /// \c VariadicAdaptor::extract.
+    ///
+    /// Format strings are nearly always literals, so a string is looked up by its address, and
+    /// its text is compared with the copy made when it was parsed in case the memory was reused.
+    /// An address whose text changed, such as a buffer a program formats into, is not cached
+    /// again, and neither is any string once a shard is full: the caller then walks the format
+    /// with the formatter, as before. The shards are keyed by address and read under a shared
+    /// lock; entries are never freed.
+    class FormatCache {
+    public:
+        struct Format {
+            std::string text;
+            /// The \c CVargType each argument is read as, in order, as \c mp_vsnprintf reads it.
+            std::vector<uint8_t> kinds;
+            /// Set once the address is seen with other text.
+            std::atomic<bool> unstable = false;
+        };
+
+        /// Strings parsed per shard at most.
+        static constexpr const size_t ShardCapacity = 256;
+
+        /// The parsed arguments of \a fmt, or null if it is not cached.
+        static const Format *find(const char *fmt);
+
+        /// Append the argument kinds of \a fmt to \a kinds, reading the conversions exactly as
+        /// \c mp_vsnprintf does.
+        static void parse(const char *fmt, std::vector<uint8_t> &kinds);
+    };
+
+}
+
+#endif // LORE_DLCALL_FORMATCACHE_H
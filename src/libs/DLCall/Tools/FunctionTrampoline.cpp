@@ -1,9 +1,18 @@
 // SPDX-License-Identifier: MIT
 
 #include "FunctionTrampoline.h"
+#include "AddressRangeIndex.h"
+#include "PerfMap.h"
+
+#include <algorithm>
+#include <functional>
+#include <mutex>
+
+#include <lorelei/Support/LockStats.h>
 
 #ifndef _WIN32
 #  include <sys/mman.h>
+#  include <unistd.h>
 #endif
 
 #ifndef _WIN32
@@ -45,6 +54,9 @@ namespace lore {
         auto trampoline =
             (FunctionTrampolineTable *) mmap(NULL, table_size, PROT_READ | PROT_WRITE | PROT_EXEC,
                                              MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (trampoline == MAP_FAILED) {
+            return nullptr;
+        }
         trampoline->count = count;
         for (size_t i = 0; i < count; i++) {
             auto thunk = &trampoline->trampoline[i];
@@ -56,14 +68,151 @@ namespace lore {
         // Flush the instruction cache over the just-written code so it is visible to execution on
         // architectures without a coherent I-cache (aarch64, riscv64), a no-op on x86_64.
         __builtin___clear_cache((char *) trampoline, (char *) trampoline + table_size);
+        // The stubs are called on this side, so they classify as this side's addresses.
+        AddressRangeIndex::instance().addRange(trampoline, table_size);
         return trampoline;
     }
 
     void FunctionTrampolineTable::destroy(FunctionTrampolineTable *table) {
         size_t table_size =
             sizeof(FunctionTrampolineTable) + table->count * sizeof(FunctionTrampoline);
+        AddressRangeIndex::instance().removeRange(table);
         munmap(table, table_size);
     }
 #endif
 
+    size_t FunctionTrampolineArena::KeyHash::operator()(const Key &key) const {
+        const std::hash<const void *> hash;
+        size_t value = hash(key.function);
+        value ^= hash(key.target) + 0x9E3779B97F4A7C15ULL + (value << 6) + (value >> 2);
+        value ^= hash(key.owner) + 0x9E3779B97F4A7C15ULL + (value << 6) + (value >> 2);
+        return value;
+    }
+
+    FunctionTrampolineArena::FunctionTrampolineArena() = default;
+
+    FunctionTrampolineArena::~FunctionTrampolineArena() {
+        for (auto slab : m_slabs) {
+            FunctionTrampolineTable::destroy(slab);
+        }
+    }
+
+    static LockSite arenaLookupSite("trampoline arena lookup");
+    static LockSite arenaInsertSite("trampoline arena insert");
+
+    FunctionTrampolineArena &FunctionTrampolineArena::instance() {
+        // Never destroyed: a library may still call a stub during exit.
+        static auto arena = new FunctionTrampolineArena();
+        return *arena;
+    }
+
+    void *FunctionTrampolineArena::acquire(void *target, void *function, const void *owner,
+                                           uintptr_t magic_sign) {
+        const Key key{target, function, owner};
+        {
+            ProfiledSharedLock<std::shared_mutex> lock(m_mutex, arenaLookupSite);
+            if (auto it = m_index.find(key); it != m_index.end()) {
+                return it->second->thunk_instr;
+            }
+        }
+
+        ProfiledLock<std::shared_mutex> lock(m_mutex, arenaInsertSite);
+        if (auto it = m_index.find(key); it != m_index.end()) {
+            return it->second->thunk_instr;
+        }
+        if (m_free.empty()) {
+            addSlab();
+            if (m_free.empty()) {
+                return nullptr;
+            }
+        }
+        auto trampoline = m_free.back();
+        m_free.pop_back();
+
+        // Nothing calls a free stub, so its code can be rewritten in place.
+        trampoline->saved_function = function;
+        trampoline->magic_sign = magic_sign;
+#ifndef _WIN32
+        tramp_gen_thunk(trampoline->thunk_instr, target);
+        __builtin___clear_cache(trampoline->thunk_instr,
+                                trampoline->thunk_instr + sizeof(trampoline->thunk_instr));
+#endif
+
+        if (PerfMap::enabled()) {
+            PerfMap::trampolineLoaded(trampoline->thunk_instr, sizeof(trampoline->thunk_instr),
+                                      target, function);
+        }
+
+        m_index.emplace(key, trampoline);
+        m_keys.emplace(trampoline, key);
+        ++m_acquired;
+        m_peak = std::max(m_peak, m_keys.size());
+        return trampoline->thunk_instr;
+    }
+
+    void FunctionTrampolineArena::release(void *stub) {
+        auto trampoline = reinterpret_cast<FunctionTrampoline *>(
+            static_cast<char *>(stub) - offsetof(FunctionTrampoline, thunk_instr));
+
+        std::unique_lock<std::shared_mutex> lock(m_mutex);
+        auto it = m_keys.find(trampoline);
+        if (it == m_keys.end()) {
+            return;
+        }
+        m_index.erase(it->second);
+        m_keys.erase(it);
+        recycle(trampoline);
+    }
+
+    size_t FunctionTrampolineArena::releaseOwner(const void *owner) {
+        std::unique_lock<std::shared_mutex> lock(m_mutex);
+        size_t count = 0;
+        for (auto it = m_keys.begin(); it != m_keys.end();) {
+            if (it->second.owner != owner) {
+                ++it;
+                continue;
+            }
+            m_index.erase(it->second);
+            recycle(it->first);
+            it = m_keys.erase(it);
+            ++count;
+        }
+        return count;
+    }
+
+    FunctionTrampolineArena::Stats FunctionTrampolineArena::stats() const {
+        std::shared_lock<std::shared_mutex> lock(m_mutex);
+        return {m_slabs.size(), m_capacity, m_keys.size(), m_peak, m_acquired, m_released};
+    }
+
+    void FunctionTrampolineArena::addSlab() {
+#ifndef _WIN32
+        static const size_t slabSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#else
+        static const size_t slabSize = 4096;
+#endif
+        const size_t count =
+            (slabSize - sizeof(FunctionTrampolineTable)) / sizeof(FunctionTrampoline);
+        // Stubs get their target when handed out.
+        auto slab = FunctionTrampolineTable::create(count, nullptr, 0);
+        if (!slab) {
+            return;
+        }
+        m_slabs.push_back(slab);
+        m_capacity += count;
+        // Hand out the lowest addresses first.
+        for (size_t i = count; i > 0; --i) {
+            m_free.push_back(&slab->trampoline[i - 1]);
+        }
+    }
+
+    void FunctionTrampolineArena::recycle(FunctionTrampoline *trampoline) {
+        // Clear the sign so unwrapping a stale pointer to the stub no longer resolves.
+        trampoline->magic_sign = 0;
+        trampoline->saved_function = nullptr;
+        m_free.push_back(trampoline);
+        ++m_released;
+        m_epoch.fetch_add(1, std::memory_order_release);
+    }
+
 }
@@ -0,0 +1,242 @@
+// SPDX-License-Identifier: MIT
+
+#include "PerfMap.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <tuple>
+
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <elf.h>
+#include <fcntl.h>
+#include <link.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#  include <sys/syscall.h>
+#endif
+
+namespace lore {
+
+    namespace {
+
+        // The jitdump layout, from perf's jitdump-specification.txt.
+        struct JitHeader {
+            uint32_t magic;
+            uint32_t version;
+            uint32_t totalSize;
+            uint32_t elfMach;
+            uint32_t pad1;
+            uint32_t pid;
+            uint64_t timestamp;
+            uint64_t flags;
+        };
+
+        struct JitRecordHeader {
+            uint32_t id;
+            uint32_t totalSize;
+            uint64_t timestamp;
+        };
+
+        struct JitCodeLoad {
+            JitRecordHeader header;
+            uint32_t pid;
+            uint32_t tid;
+            uint64_t vma;
+            uint64_t codeAddr;
+            uint64_t codeSize;
+            uint64_t codeIndex;
+            // Followed by the null-terminated name and the code bytes.
+        };
+
+        static constexpr uint32_t kJitMagic = 0x4A695444;
+        static constexpr uint32_t kJitCodeLoad = 0;
+
+#ifdef __x86_64__
+        static constexpr uint32_t kElfMach = EM_X86_64;
+#elif defined(__aarch64__)
+        static constexpr uint32_t kElfMach = EM_AARCH64;
+#elif defined(__riscv)
+        static constexpr uint32_t kElfMach = EM_RISCV;
+#else
+        static constexpr uint32_t kElfMach = EM_NONE;
+#endif
+
+        struct Recorder {
+            std::mutex mutex;
+            PerfMap::Format format = PerfMap::Map;
+            int fd = -1;
+            uint64_t codeIndex = 0;
+        };
+
+        // Never destroyed: a stub may still be handed out during process teardown.
+        Recorder &recorder() {
+            static auto rec = new Recorder();
+            return *rec;
+        }
+
+        // perf's clock for a jitdump, matched with `perf record -k 1`.
+        uint64_t monotonicNs() {
+            timespec ts;
+            clock_gettime(CLOCK_MONOTONIC, &ts);
+            return uint64_t(ts.tv_sec) * 1000000000ull + uint64_t(ts.tv_nsec);
+        }
+
+        uint32_t currentThreadId() {
+#ifdef __linux__
+            return static_cast<uint32_t>(syscall(SYS_gettid));
+#else
+            return 0;
+#endif
+        }
+
+        bool writeAll(int fd, const void *data, size_t size) {
+            auto p = static_cast<const char *>(data);
+            while (size > 0) {
+                const ssize_t n = ::write(fd, p, size);
+                if (n <= 0) {
+                    return false;
+                }
+                p += n;
+                size -= size_t(n);
+            }
+            return true;
+        }
+
+        bool openJitDump(Recorder &rec, const char *dir) {
+            std::string path = (dir && *dir) ? dir : ".";
+            path += "/jit-" + std::to_string(getpid()) + ".dump";
+            const int fd = ::open(path.c_str(), O_CREAT | O_TRUNC | O_RDWR | O_CLOEXEC, 0644);
+            if (fd < 0) {
+                return false;
+            }
+
+            // perf finds the dump through an executable mapping of it, recorded as an mmap event.
+            // The mapping stays for the life of the process.
+            const auto pageSize = size_t(sysconf(_SC_PAGESIZE));
+            void *marker = mmap(nullptr, pageSize, PROT_READ | PROT_EXEC, MAP_PRIVATE, fd, 0);
+            if (marker == MAP_FAILED) {
+                ::close(fd);
+                return false;
+            }
+
+            const JitHeader header = {kJitMagic, 1, sizeof(JitHeader), kElfMach, 0,
+                                      uint32_t(getpid()), monotonicNs(), 0};
+            if (!writeAll(fd, &header, sizeof(header))) {
+                ::close(fd);
+                return false;
+            }
+            rec.fd = fd;
+            return true;
+        }
+
+    }
+
+    bool PerfMap::s_enabled = false;
+
+    bool PerfMap::start(Format format, const char *dir) {
+        auto &rec = recorder();
+        std::lock_guard<std::mutex> lock(rec.mutex);
+        if (s_enabled) {
+            return true;
+        }
+        rec.format = format;
+        if (format == JitDump) {
+            if (!openJitDump(rec, dir)) {
+                return false;
+            }
+        } else {
+            const std::string path = "/tmp/perf-" + std::to_string(getpid()) + ".map";
+            rec.fd = ::open(path.c_str(), O_CREAT | O_APPEND | O_WRONLY | O_CLOEXEC, 0644);
+            if (rec.fd < 0) {
+                return false;
+            }
+        }
+        s_enabled = true;
+        return true;
+    }
+
+    void PerfMap::codeLoaded(const void *addr, size_t size, const char *name) {
+        if (!s_enabled || size == 0) {
+            return;
+        }
+        auto &rec = recorder();
+        std::lock_guard<std::mutex> lock(rec.mutex);
+
+        if (rec.format == Map) {
+            // One write per line, so the lines of other writers to the same map never interleave.
+            char line[64];
+            const int n = std::snprintf(line, sizeof(line), "%lx %zx ", (unsigned long) addr, size);
+            std::string entry(line, size_t(n));
+            entry.append(name).push_back('\n');
+            std::ignore = writeAll(rec.fd, entry.data(), entry.size());
+            return;
+        }
+
+        const size_t nameSize = std::strlen(name) + 1;
+        JitCodeLoad load = {};
+        load.header.id = kJitCodeLoad;
+        load.header.totalSize = uint32_t(sizeof(load) + nameSize + size);
+        load.header.timestamp = monotonicNs();
+        load.pid = uint32_t(getpid());
+        load.tid = currentThreadId();
+        load.vma = uint64_t(uintptr_t(addr));
+        load.codeAddr = load.vma;
+        load.codeSize = size;
+        load.codeIndex = rec.codeIndex++;
+        std::ignore = writeAll(rec.fd, &load, sizeof(load)) && writeAll(rec.fd, name, nameSize) &&
+                      writeAll(rec.fd, addr, size);
+    }
+
+    void PerfMap::trampolineLoaded(const void *stub, size_t size, const void *target,
+                                   const void *function) {
+        if (!s_enabled) {
+            return;
+        }
+        // The target names the callback signature (its Entry), the function which callback of
+        // it the stub stands in for.
+        const std::string name =
+            "lore_tramp " + symbolName(target) + " [" + symbolName(function) + "]";
+        codeLoaded(stub, size, name.c_str());
+    }
+
+    void PerfMap::procLoaded(const void *addr, size_t limit, const char *name) {
+        if (!s_enabled || !addr) {
+            return;
+        }
+        if (recorder().format == Map) {
+            return;
+        }
+        size_t size = limit;
+        Dl_info info;
+        ElfW(Sym) *sym = nullptr;
+        if (dladdr1(addr, &info, reinterpret_cast<void **>(&sym), RTLD_DL_SYMENT) && sym &&
+            info.dli_saddr == addr && sym->st_size) {
+            size = sym->st_size;
+        }
+        codeLoaded(addr, size, name);
+    }
+
+    std::string PerfMap::symbolName(const void *addr) {
+        Dl_info info;
+        if (dladdr(addr, &info) && info.dli_sname && info.dli_saddr == addr) {
+            int status = 0;
+            char *demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+            if (demangled) {
+                std::string name = demangled;
+                std::free(demangled);
+                return name;
+            }
+            return info.dli_sname;
+        }
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), "0x%lx", (unsigned long) addr);
+        return buf;
+    }
+
+}
@@ -0,0 +1,102 @@
+// SPDX-License-Identifier: MIT
+
+#include "TraceRecorder.h"
+
+#include <mutex>
+#include <string>
+#include <unordered_set>
+
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#  include <sys/syscall.h>
+#endif
+
+namespace lore {
+
+    namespace {
+
+        struct Registry {
+            std::mutex mutex;
+            std::vector<TraceBuffer *> buffers;
+            std::unordered_set<std::string> strings;
+            uint32_t side = 0;
+            uint64_t capacity = 0;
+        };
+
+        // Never destroyed: threads may still record during process teardown, and the host reads
+        // the rings last of all.
+        Registry &registry() {
+            static auto reg = new Registry();
+            return *reg;
+        }
+
+        thread_local TraceBuffer *threadBuffer = nullptr;
+
+        uint32_t currentThreadId() {
+#ifdef __linux__
+            return static_cast<uint32_t>(syscall(SYS_gettid));
+#else
+            return 0;
+#endif
+        }
+
+        TraceBuffer *createThreadBuffer() {
+            auto &reg = registry();
+            auto buffer = new TraceBuffer();
+            buffer->events = new TraceEvent[reg.capacity]();
+            buffer->mask = reg.capacity - 1;
+            buffer->tid = currentThreadId();
+            buffer->side = reg.side;
+
+            std::lock_guard<std::mutex> lock(reg.mutex);
+            reg.buffers.push_back(buffer);
+            return buffer;
+        }
+
+    }
+
+    bool TraceRecorder::s_enabled = false;
+
+    void TraceRecorder::start(uint32_t side, size_t capacity) {
+        auto &reg = registry();
+        uint64_t size = 1024;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        reg.side = side;
+        reg.capacity = size;
+        s_enabled = true;
+    }
+
+    void TraceRecorder::record(TraceEventKind kind, uint32_t phase, uint64_t arg) {
+        auto buffer = threadBuffer;
+        if (!buffer) {
+            buffer = threadBuffer = createThreadBuffer();
+        }
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+
+        auto &event = buffer->events[buffer->head & buffer->mask];
+        event.time = uint64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+        event.arg = arg;
+        event.kind = kind;
+        event.phase = phase;
+        // Only read once the thread is done, at exit, so a plain store is enough.
+        ++buffer->head;
+    }
+
+    const char *TraceRecorder::intern(const char *str) {
+        auto &reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        return reg.strings.emplace(str ? str : "").first->c_str();
+    }
+
+    std::vector<TraceBuffer *> TraceRecorder::buffers() {
+        auto &reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        return reg.buffers;
+    }
+
+}
@@ -2,6 +2,7 @@
 
 #include "VariadicAdaptor.h"
 
+#include <atomic>
 #include <cstdarg>
 #include <cassert>
 #include <cstring>
@@ -11,6 +12,8 @@
 
 #include <lorelei/Support/VarSizeArray.h>
 
+#include "FormatCache.h"
+
 namespace lore {
 
     static void callFormatBox64_arg_entry(char fmt, CVargEntry *entry, void *arg) {
@@ -149,7 +152,59 @@ namespace lore {
         return p - out;
     }
 
+    // Read the arguments of a parsed format by kind. scanf takes a pointer for every conversion,
+    // as mp_vsnprintf_scanf reads them.
+    static int extractParsedArgs(VariadicAdaptor::FormatStyle style,
+                                 const FormatCache::Format &format, va_list ap, CVargEntry *out) {
+        CVargEntry *p = out;
+        if (style == VariadicAdaptor::ScanF) {
+            for (size_t i = 0; i < format.kinds.size(); ++i, ++p) {
+                p->type = CVargType_Pointer;
+                p->p = va_arg(ap, void *);
+            }
+        } else {
+            for (const auto kind : format.kinds) {
+                p->type = kind;
+                switch (kind) {
+                    case CVargType_Int:
+                        p->i = va_arg(ap, int);
+                        break;
+                    case CVargType_UInt:
+                        p->u = va_arg(ap, unsigned int);
+                        break;
+                    case CVargType_Long:
+                        p->l = va_arg(ap, long);
+                        break;
+                    case CVargType_ULong:
+                        p->ul = va_arg(ap, unsigned long);
+                        break;
+                    case CVargType_LongLong:
+                        p->ll = va_arg(ap, long long);
+                        break;
+                    case CVargType_ULongLong:
+                        p->ull = va_arg(ap, unsigned long long);
+                        break;
+                    case CVargType_Double:
+                        p->d = va_arg(ap, double);
+                        break;
+                    default:
+                        p->p = va_arg(ap, void *);
+                        break;
+                }
+                ++p;
+            }
+        }
+        p->type = CVargType_Void;
+        p->p = nullptr;
+        return p - out;
+    }
+
     int VariadicAdaptor::extract(FormatStyle style, const char *fmt, va_list ap, CVargEntry *out) {
+        if (style == PrintF || style == ScanF) {
+            if (const auto format = FormatCache::find(fmt)) {
+                return extractParsedArgs(style, *format, ap, out);
+            }
+        }
         switch (style) {
             case PrintF:
                 return extractPrintFArgs(fmt, ap, out);
@@ -169,6 +224,11 @@ namespace lore {
         assert(std::strlen(fmt) >= 2);
         assert(fmt[1] == '_');
 
+        if (const auto invoker = findFormatInvoker(fmt)) {
+            invoker(func, args, ret);
+            return;
+        }
+
         const auto len = std::strlen(fmt);
         CVargEntry vret{};
         callFormatBox64_ret_entry(fmt[0], &vret);
@@ -236,8 +296,81 @@ namespace lore {
 
 }
 
-#if 1
-#  include "VariadicAdaptor_FFCall.cpp.inc"
-#else
+#include "VariadicAdaptor_Typed.cpp.inc"
+
+#include "VariadicAdaptor_FFCall.cpp.inc"
+#ifdef LORE_VARIADIC_HAS_LIBFFI
 #  include "VariadicAdaptor_FFI.cpp.inc"
 #endif
+
+#include "VariadicAdaptor_VaList.cpp.inc"
+
+namespace lore {
+
+    static std::atomic<VariadicAdaptor::Backend> currentBackend = VariadicAdaptor::NativeVaList;
+
+    VariadicAdaptor::Backend VariadicAdaptor::backend() {
+        return currentBackend.load(std::memory_order_relaxed);
+    }
+
+    bool VariadicAdaptor::setBackend(Backend backend) {
+        if (!hasBackend(backend)) {
+            return false;
+        }
+        currentBackend.store(backend, std::memory_order_relaxed);
+        return true;
+    }
+
+    bool VariadicAdaptor::hasBackend(Backend backend) {
+        switch (backend) {
+            case NativeVaList:
+            case FFCall:
+                return true;
+            case LibFFI:
+#ifdef LORE_VARIADIC_HAS_LIBFFI
+                return true;
+#else
+                return false;
+#endif
+            default:
+                break;
+        }
+        return false;
+    }
+
+    void VariadicAdaptor::call(void *func, int argc1, CVargEntry *argv1, int argc2,
+                               CVargEntry *argv2, CVargEntry *ret) {
+#ifdef LORE_VARIADIC_HAS_LIBFFI
+        if (backend() == LibFFI) {
+            libffi::call(func, argc1, argv1, argc2, argv2, ret);
+            return;
+        }
+#endif
+        ffcall::call(func, argc1, argv1, argc2, argv2, ret);
+    }
+
+    void VariadicAdaptor::vcall(void *func, int argc1, CVargEntry *argv1, int argc2,
+                                CVargEntry *argv2, CVargEntry *ret) {
+        switch (backend()) {
+            case NativeVaList:
+#ifdef LORE_VARIADIC_NATIVE_VA_LIST
+                if (argc1 < 0) {
+                    argc1 = CVargEntryLength(argv1);
+                }
+                if (vcallNative(func, argc1, argv1, argc2, argv2, ret)) {
+                    return;
+                }
+#endif
+                break;
+#ifdef LORE_VARIADIC_HAS_LIBFFI
+            case LibFFI:
+                libffi::vcall(func, argc1, argv1, argc2, argv2, ret);
+                return;
+#endif
+            default:
+                break;
+        }
+        ffcall::vcall(func, argc1, argv1, argc2, argv2, ret);
+    }
+
+}
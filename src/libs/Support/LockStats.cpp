@@ -0,0 +1,78 @@
+// SPDX-License-Identifier: MIT
+
+#include "LockStats.h"
+
+#include <algorithm>
+
+#include <time.h>
+
+#include "Logging.h"
+
+namespace lore {
+
+    // Sites are statics of any library linking this one, registered as they are constructed. They
+    // are never unlinked: a site lives as long as its library, which stays loaded.
+    static std::atomic<LockSite *> siteList = nullptr;
+
+    bool LockSite::s_enabled = false;
+
+    LockSite::LockSite(const char *name) : m_name(name) {
+        m_next = siteList.load(std::memory_order_relaxed);
+        while (!siteList.compare_exchange_weak(m_next, this, std::memory_order_release,
+                                               std::memory_order_relaxed)) {
+        }
+    }
+
+    void LockSite::setEnabled(bool enabled) {
+        s_enabled = enabled;
+    }
+
+    uint64_t LockSite::now() {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return uint64_t(ts.tv_sec) * 1000000000ull + uint64_t(ts.tv_nsec);
+    }
+
+    void LockSite::addWait(uint64_t ns) {
+        m_contended.fetch_add(1, std::memory_order_relaxed);
+        m_waitTime.fetch_add(ns, std::memory_order_relaxed);
+        uint64_t max = m_maxWait.load(std::memory_order_relaxed);
+        while (ns > max &&
+               !m_maxWait.compare_exchange_weak(max, ns, std::memory_order_relaxed)) {
+        }
+    }
+
+    std::vector<LockSite::Stats> LockSite::collect() {
+        std::vector<Stats> result;
+        for (auto site = siteList.load(std::memory_order_acquire); site; site = site->m_next) {
+            const uint64_t contended = site->m_contended.load(std::memory_order_relaxed);
+            if (contended == 0) {
+                continue;
+            }
+            result.push_back({site->m_name, contended,
+                              site->m_waitTime.load(std::memory_order_relaxed),
+                              site->m_maxWait.load(std::memory_order_relaxed)});
+        }
+        std::sort(result.begin(), result.end(), [](const Stats &a, const Stats &b) {
+            return a.waitTime > b.waitTime;
+        });
+        return result;
+    }
+
+    void LockSite::report(LogCategory &category) {
+        if (!s_enabled) {
+            return;
+        }
+        const auto sites = collect();
+        if (sites.empty()) {
+            category.loreInfo("locks: no thread waited");
+        }
+        for (const auto &site : sites) {
+            category.loreInfoF("locks: %s: %llu waits, %.3f ms (mean %.2f us, max %.2f us)",
+                               site.name, (unsigned long long) site.contended,
+                               site.waitTime / 1e6, site.waitTime / 1e3 / site.contended,
+                               site.maxWait / 1e3);
+        }
+    }
+
+}
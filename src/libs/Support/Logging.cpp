@@ -173,17 +173,20 @@ namespace lore {
                                    const std::string_view &message) {
         (void) context;
 
-        // The default sink only emits Success and above. Lower levels (Trace/Debug/Information)
-        // are dropped here regardless of category filtering, so they need a custom callback to show.
+        // The default sink only emits Success and above. Lower levels (Trace/Debug) are dropped
+        // here regardless of category filtering, so they need a custom callback to show.
         if (level < Logger::Success) {
             return;
         }
 
+        // Information goes with the diagnostics, so that the runtime's reports never mix into the
+        // program's own stdout.
         FILE *out;
         switch (level) {
             case Logger::Success:
                 out = stdout;
                 break;
+            case Logger::Information:
             case Logger::Warning:
             case Logger::Critical:
             case Logger::Fatal:
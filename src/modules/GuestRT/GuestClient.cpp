@@ -7,8 +7,19 @@
 
 #include <cassert>
 #include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
 #include <tuple>
+#include <unordered_map>
+#include <vector>
 
+#include <lorelei/Support/LockStats.h>
+#include <lorelei/DLCall/Tools/AddressRangeIndex.h>
+#include <lorelei/DLCall/Tools/CallbackElision.h>
+#include <lorelei/DLCall/Tools/TraceRecorder.h>
 #include <lorelei/DLCall/Tools/VariadicAdaptor.h>
 
 #include "LogCategory.h"
@@ -31,6 +42,12 @@ namespace lore::mod {
         // and used as the target of every DR_InvokeProc request.
         static void *g_commonProcEntry = nullptr;
 
+        // Host runtime's loopback entry (its LoreLoopbackEntry), installed via startLoopback. While
+        // set, every request is handed to it instead of issuing the syscall.
+        using LoopbackEntry = uint64_t (*)(uint64_t, uint64_t, uint64_t, uint64_t, uint64_t,
+                                           uint64_t);
+        static LoopbackEntry g_loopbackEntry = nullptr;
+
         struct NewThreadInfo {
             pthread_t thread;
             pthread_mutex_t mutex;
@@ -58,30 +75,142 @@ namespace lore::mod {
             return ret;
         }
 
+        // The per-thread buffer of deferred calls (DeferredCallHeader records), sent on the first
+        // non-deferred crossing after them.
+        struct DeferredBuffer {
+            static constexpr size_t Capacity = 8192;
+
+            alignas(16) char data[Capacity];
+            size_t used = 0;
+        };
+
+        // The calls a thread has issued but not yet seen complete: its deferred buffer and its async
+        // ring (attached on the first async call). The destructor settles both at thread exit, and,
+        // for the main thread, at exit() before the atexit handlers.
+        struct ThreadCalls {
+            DeferredBuffer deferred;
+            AsyncRing *ring = nullptr;
+            bool asyncUnavailable = false;
+            // Nonzero while the thread runs a reentry of one of its own async calls. That call
+            // cannot complete until the reentry returns, so nothing may wait for the ring meanwhile.
+            int asyncReentryDepth = 0;
+
+            ~ThreadCalls();
+        };
+
+        static thread_local ThreadCalls thread_calls;
+
+        static inline size_t alignRecord(size_t size) {
+            return (size + 15) & ~size_t(15);
+        }
+
+        LockSite procCacheLookupSite("proc address cache lookup");
+        LockSite procCacheInsertSite("proc address cache insert");
+        LockSite moduleOpenSite("module thunk open");
+
+        // The guest thunks that can stand in for one host library's functions, in the order to try
+        // them, opened on first use.
+        struct ModuleThunks {
+            std::vector<std::string> paths;
+            std::vector<void *> handles;
+            std::mutex mutex;
+        };
+
+        // What convertHostProcAddress has learned: the guest function of each host address it
+        // converted, and the guest thunks of each host library it met. Cleared when the guest frees a
+        // host library, since its addresses and path may then be reused.
+        class ProcAddressCache {
+        public:
+            void *find(void *addr, const char *name) {
+                ProfiledSharedLock<std::shared_mutex> lock(m_mutex, procCacheLookupSite);
+                auto it = m_procs.find(addr);
+                if (it == m_procs.end() || it->second.name != name) {
+                    return nullptr;
+                }
+                return it->second.func;
+            }
+
+            void add(void *addr, const char *name, void *func) {
+                ProfiledLock<std::shared_mutex> lock(m_mutex, procCacheInsertSite);
+                m_procs[addr] = {name, func};
+            }
+
+            std::shared_ptr<ModuleThunks> findModule(const char *hostLibPath) {
+                ProfiledSharedLock<std::shared_mutex> lock(m_mutex, procCacheLookupSite);
+                auto it = m_modules.find(hostLibPath);
+                return it != m_modules.end() ? it->second : nullptr;
+            }
+
+            std::shared_ptr<ModuleThunks> addModule(const char *hostLibPath,
+                                                    std::shared_ptr<ModuleThunks> module) {
+                std::unique_lock<std::shared_mutex> lock(m_mutex);
+                return m_modules.emplace(hostLibPath, std::move(module)).first->second;
+            }
+
+            void clear() {
+                std::unique_lock<std::shared_mutex> lock(m_mutex);
+                m_procs.clear();
+                m_modules.clear();
+            }
+
+        protected:
+            struct Proc {
+                std::string name;
+                void *func;
+            };
+
+            std::shared_mutex m_mutex;
+            std::unordered_map<void *, Proc> m_procs;
+            std::unordered_map<std::string, std::shared_ptr<ModuleThunks>> m_modules;
+        };
+
+        static ProcAddressCache &procAddressCache() {
+            static ProcAddressCache cache;
+            return cache;
+        }
+
     }
 
     static inline uint64_t send(uint64_t a1) {
+        if (g_loopbackEntry) {
+            return g_loopbackEntry(a1, 0, 0, 0, 0, 0);
+        }
         return syscall1(DLCallSyscallNumber, a1);
     }
 
     static inline uint64_t send(uint64_t a1, uint64_t a2) {
+        if (g_loopbackEntry) {
+            return g_loopbackEntry(a1, a2, 0, 0, 0, 0);
+        }
         return syscall2(DLCallSyscallNumber, a1, a2);
     }
 
     static inline uint64_t send(uint64_t a1, uint64_t a2, uint64_t a3) {
+        if (g_loopbackEntry) {
+            return g_loopbackEntry(a1, a2, a3, 0, 0, 0);
+        }
         return syscall3(DLCallSyscallNumber, a1, a2, a3);
     }
 
     static inline uint64_t send(uint64_t a1, uint64_t a2, uint64_t a3, uint64_t a4) {
+        if (g_loopbackEntry) {
+            return g_loopbackEntry(a1, a2, a3, a4, 0, 0);
+        }
         return syscall4(DLCallSyscallNumber, a1, a2, a3, a4);
     }
 
     static inline uint64_t send(uint64_t a1, uint64_t a2, uint64_t a3, uint64_t a4, uint64_t a5) {
+        if (g_loopbackEntry) {
+            return g_loopbackEntry(a1, a2, a3, a4, a5, 0);
+        }
         return syscall5(DLCallSyscallNumber, a1, a2, a3, a4, a5);
     }
 
     static inline uint64_t send(uint64_t a1, uint64_t a2, uint64_t a3, uint64_t a4, uint64_t a5,
                                 uint64_t a6) {
+        if (g_loopbackEntry) {
+            return g_loopbackEntry(a1, a2, a3, a4, a5, a6);
+        }
         return syscall6(DLCallSyscallNumber, a1, a2, a3, a4, a5, a6);
     }
 
@@ -94,10 +223,44 @@ namespace lore::mod {
                     reinterpret_cast<uintptr_t>(payload));
     }
 
-    static void *convertHostProcAddress_helper(const char *hostLibPath,
-                                               const CForwardThunkInfo &thunkInfo,
-                                               const char *name) {
-        const char *path = thunkInfo.guestThunk;
+    // Collect the guest thunks that can resolve \a hostLibPath's functions. Empty if there are
+    // none.
+    static std::shared_ptr<ModuleThunks> findModuleThunks(const char *hostLibPath) {
+        auto module = std::make_shared<ModuleThunks>();
+        auto thunkInfo = GuestClient::getThunkInfo(hostLibPath, true);
+        if (!thunkInfo.reversed) {
+            // The reverse mapping is not found, assume the guest thunk library has the same name
+            thunkInfo = GuestClient::getThunkInfo(hostLibPath, false);
+            if (!thunkInfo.forward) {
+                log::logger().loreCritical("failed to get forward thunk info for %1", hostLibPath);
+                return module;
+            }
+            module->paths.emplace_back(thunkInfo.forward->guestThunk);
+        } else {
+            // A reversed entry lists several candidate forward thunks, so try each until one
+            // resolves the symbol.
+            const auto *reversedThunks = thunkInfo.reversed->thunks;
+            for (size_t i = 0; i < thunkInfo.reversed->thunksCount; ++i) {
+                const char *thunk = reversedThunks[i];
+                auto subThunkInfo = GuestClient::getThunkInfo(thunk, false);
+                if (!subThunkInfo.forward) {
+                    log::logger().loreWarning("%1: failed to get forward thunk info for %2",
+                                              hostLibPath, thunk);
+                    continue;
+                }
+                module->paths.emplace_back(subThunkInfo.forward->guestThunk);
+            }
+        }
+        module->handles.resize(module->paths.size());
+        return module;
+    }
+
+    static void *openModuleThunk(const char *hostLibPath, ModuleThunks &module, size_t index) {
+        ProfiledLock<std::mutex> lock(module.mutex, moduleOpenSite);
+        if (void *handle = module.handles[index]) {
+            return handle;
+        }
+        const char *path = module.paths[index].c_str();
         // Prefer the already-loaded copy (RTLD_NOLOAD), and only actually dlopen it if it isn't
         // mapped.
         void *handle = dlopen(path, RTLD_NOW | RTLD_NOLOAD);
@@ -109,8 +272,10 @@ namespace lore::mod {
                                           hostLibPath, path, err ? err : "unknown error");
                 return nullptr;
             }
+            AddressRangeIndex::instance().rescan();
         }
-        return dlsym(handle, name);
+        module.handles[index] = handle;
+        return handle;
     }
 
     GuestClient *GuestClient::self = nullptr;
@@ -127,54 +292,121 @@ namespace lore::mod {
         g_commonProcEntry = entry;
     }
 
+    bool GuestClient::startLoopback(const char *hostRuntimePath) {
+        // A namespace of its own keeps the host side apart as QEMU does: its LoreDLCall, libc and
+        // link map are not ours, so each side's AddressRangeIndex still sees only its own objects,
+        // and an HTL's calls to the real library never bind to the guest thunk of the same name.
+        void *handle = dlmopen(LM_ID_NEWLM, hostRuntimePath, RTLD_NOW | RTLD_LOCAL);
+        if (!handle) {
+            return false;
+        }
+        auto entry = reinterpret_cast<LoopbackEntry>(dlsym(handle, "LoreLoopbackEntry"));
+        if (!entry) {
+            return false;
+        }
+        g_loopbackEntry = entry;
+        return true;
+    }
+
+    // Convert a host address known to lie in hostLibPath, recording the result.
+    static void *convertHostProcAddressIn(const char *name, void *addr, const char *hostLibPath,
+                                          bool quiet) {
+        auto module = procAddressCache().findModule(hostLibPath);
+        if (!module) {
+            module = procAddressCache().addModule(hostLibPath, findModuleThunks(hostLibPath));
+        }
+        for (size_t i = 0; i < module->paths.size(); ++i) {
+            void *handle = openModuleThunk(hostLibPath, *module, i);
+            if (!handle) {
+                continue;
+            }
+            if (void *func = dlsym(handle, name)) {
+                procAddressCache().add(addr, name, func);
+                return func;
+            }
+        }
+        if (!quiet && !module->paths.empty()) {
+            log::logger().loreWarningF(
+                "%s: failed to convert host function \"%s\" at %p to guest function", hostLibPath,
+                name, addr);
+        }
+        return nullptr;
+    }
+
     void *GuestClient::convertHostProcAddress(const char *name, void *addr) {
+        // Loaders ask for the same functions over and over, so answer repeats without crossing.
+        if (void *func = procAddressCache().find(addr, name)) {
+            return func;
+        }
+
         auto hostLibPath = getModulePath(addr, false);
         if (!hostLibPath) {
             log::logger().loreWarningF("failed to get module path for %p", addr);
             return nullptr;
         }
+        return convertHostProcAddressIn(name, addr, hostLibPath, false);
+    }
 
-        auto thunkInfo = getThunkInfo(hostLibPath, true);
-        if (!thunkInfo.reversed) {
-            // The reverse mapping is not found, assume the guest thunk library has the same name
-            thunkInfo = getThunkInfo(hostLibPath, false);
-            if (!thunkInfo.forward) {
-                log::logger().loreCritical("failed to get forward thunk info for %1", hostLibPath);
-                return nullptr;
-            }
-            return convertHostProcAddress_helper(hostLibPath, *thunkInfo.forward, name);
-        }
-
-        // A reversed entry lists several candidate forward thunks, so try each until one resolves
-        // the symbol.
-        const auto *reversedThunks = thunkInfo.reversed->thunks;
-        for (size_t i = 0; i < thunkInfo.reversed->thunksCount; ++i) {
-            const char *thunk = reversedThunks[i];
-            auto subThunkInfo = getThunkInfo(thunk, false);
-            if (!subThunkInfo.forward) {
-                log::logger().loreWarning("%1: failed to get forward thunk info for %2",
-                                          hostLibPath, thunk);
+    int GuestClient::resolveSymbols(void *handle, const char *const *names, void **addrs,
+                                    int count) {
+        ResolveSymbolsArguments a = {};
+        a.scope = handle;
+        a.names = names;
+        a.addrs = addrs;
+        a.count = static_cast<uint32_t>(count);
+        std::ignore = invokeHost(DS_ResolveSymbols, &a);
+        return static_cast<int>(a.found);
+    }
+
+    int GuestClient::resolveGuestSymbols(void *handle, const char *const *names, void **addrs,
+                                         int count) {
+        std::vector<const char *> modulePaths(count);
+        ResolveSymbolsArguments a = {};
+        a.scope = handle;
+        a.names = names;
+        a.addrs = addrs;
+        a.modulePaths = modulePaths.data();
+        a.count = static_cast<uint32_t>(count);
+        std::ignore = invokeHost(DS_ResolveSymbols, &a);
+
+        int found = 0;
+        for (int i = 0; i < count; ++i) {
+            if (!addrs[i]) {
                 continue;
             }
-            if (void *func = convertHostProcAddress_helper(hostLibPath, *subThunkInfo.forward, name)) {
-                return func;
+            void *func = procAddressCache().find(addrs[i], names[i]);
+            if (!func && modulePaths[i]) {
+                func = convertHostProcAddressIn(names[i], addrs[i], modulePaths[i], false);
+            }
+            addrs[i] = func;
+            found += func != nullptr;
+        }
+        return found;
+    }
+
+    void GuestClient::prefetchProcAddresses(void *hostAddr, const char *const *names, int count) {
+        std::vector<void *> addrs(count);
+        std::vector<const char *> modulePaths(count);
+        ResolveSymbolsArguments a = {};
+        a.scope = hostAddr;
+        a.names = names;
+        a.addrs = addrs.data();
+        a.modulePaths = modulePaths.data();
+        a.count = static_cast<uint32_t>(count);
+        a.flags = RS_ScopeIsAddress;
+        std::ignore = invokeHost(DS_ResolveSymbols, &a);
+
+        for (int i = 0; i < count; ++i) {
+            if (addrs[i] && modulePaths[i] && !procAddressCache().find(addrs[i], names[i])) {
+                std::ignore = convertHostProcAddressIn(names[i], addrs[i], modulePaths[i], true);
             }
         }
-        log::logger().loreWarningF(
-            "%s: failed to convert host function \"%s\" at %p to guest function", hostLibPath, name,
-            addr);
-        return nullptr;
     }
 
-    bool GuestClient::isHostAddressNaive(void *addr) {
-        // dladdr only resolves addresses in guest-mapped objects, so a failed lookup means the
-        // address belongs to the host.
-        // ##FIXME: dladdr cannot see anonymous-mmap trampolines, so this naive classification is
-        // sound only because callers unwrapTrampoline() first (itself an unchecked speculative
-        // read at a fixed offset). A dedicated trampoline mmap arena would let both be range-checked
-        // directly, the way separation mode uses emuAddr. Deferred.
-        Dl_info info;
-        return !dladdr(addr, &info);
+    bool GuestClient::isHostAddress(void *addr) {
+        // The index only holds guest-mapped objects and the guest's trampoline tables, so a miss
+        // means the address belongs to the host.
+        return !AddressRangeIndex::instance().contains(addr);
     }
 
     const char *GuestClient::getHostAttribute(const char *key) {
@@ -185,10 +417,18 @@ namespace lore::mod {
     }
 
     void *GuestClient::loadLibrary(const char *path, int flags) {
+        const uint64_t traceArg =
+            TraceRecorder::enabled() ? reinterpret_cast<uintptr_t>(TraceRecorder::intern(path)) : 0;
+        TraceRecorder::begin(TE_LoadLibrary, traceArg);
         void *ret = nullptr;
         std::ignore = send(static_cast<uint64_t>(DR_LoadLibrary),
                            reinterpret_cast<uintptr_t>(path), static_cast<uint64_t>(flags),
                            reinterpret_cast<uintptr_t>(&ret));
+        TraceRecorder::end(TE_LoadLibrary);
+        // The host runtime does not serve the request, so tell it its link map changed.
+        if (ret && g_commonProcEntry) {
+            std::ignore = invokeHost(DS_LoaderChanged, nullptr);
+        }
         return ret;
     }
 
@@ -204,6 +444,11 @@ namespace lore::mod {
         int ret = 0;
         std::ignore = send(static_cast<uint64_t>(DR_FreeLibrary),
                            reinterpret_cast<uintptr_t>(handle), reinterpret_cast<uintptr_t>(&ret));
+        // The library may be gone, and its addresses and path free for another one.
+        procAddressCache().clear();
+        if (g_commonProcEntry) {
+            std::ignore = invokeHost(DS_LoaderChanged, nullptr);
+        }
         return ret;
     }
 
@@ -234,7 +479,243 @@ namespace lore::mod {
         return ret;
     }
 
+    void GuestClient::invokeDeferred(void *proc, void **args, const unsigned *argSizes, int argc) {
+        size_t size = alignRecord(sizeof(DeferredCallHeader) + argc * sizeof(uint32_t));
+        for (int i = 0; i < argc; ++i) {
+            size += alignRecord(argSizes[i]);
+        }
+        if (argc > DeferredCallMaxArgs || size > DeferredBuffer::Capacity) {
+            // Too large to record: cross now (invokeFunction sends what is already buffered first).
+            invokeStandard(proc, args, nullptr, nullptr);
+            return;
+        }
+
+        auto &buffer = thread_calls.deferred;
+        if (buffer.used + size > DeferredBuffer::Capacity) {
+            flushDeferred();
+        }
+
+        char *record = buffer.data + buffer.used;
+        auto header = reinterpret_cast<DeferredCallHeader *>(record);
+        auto offsets = reinterpret_cast<uint32_t *>(header + 1);
+        header->proc = proc;
+        header->size = static_cast<uint32_t>(size);
+        header->argc = static_cast<uint32_t>(argc);
+        size_t pos = alignRecord(sizeof(DeferredCallHeader) + argc * sizeof(uint32_t));
+        for (int i = 0; i < argc; ++i) {
+            offsets[i] = static_cast<uint32_t>(pos);
+            std::memcpy(record + pos, args[i], argSizes[i]);
+            pos += alignRecord(argSizes[i]);
+        }
+        buffer.used += size;
+    }
+
+    void GuestClient::flushDeferred() {
+        auto &buffer = thread_calls.deferred;
+        if (buffer.used == 0) {
+            return;
+        }
+        // The batch runs on this thread's host side, so the async calls posted before it finish
+        // first.
+        drainAsync();
+        if (buffer.used == 0) {
+            return;
+        }
+        void *a[] = {
+            buffer.data,
+            reinterpret_cast<void *>(static_cast<uintptr_t>(buffer.used)),
+        };
+        std::ignore = invokeHost(DS_InvokeBatch, a);
+        buffer.used = 0;
+    }
+
+    // Run the guest side of a reentry the host asked for while one of this thread's invocations was
+    // in progress.
+    static void serviceReentry(ReentryArguments *ra) {
+        switch (ra->conv) {
+            case SC_Standard: {
+                using Func = void (*)(void * /*args*/, void * /*ret*/, void * /*metadata*/);
+
+                auto func = reinterpret_cast<Func>(ra->standard.proc);
+                func(ra->standard.args, ra->standard.ret, ra->standard.metadata);
+                break;
+            }
+
+            case SC_StandardCallback: {
+                using Func = void (*)(void * /*callback*/, void * /*args*/, void * /*ret*/,
+                                      void * /*metadata*/);
+
+                auto func = reinterpret_cast<Func>(ra->standardCallback.proc);
+                func(ra->standardCallback.callback, ra->standardCallback.args,
+                     ra->standardCallback.ret, ra->standardCallback.metadata);
+                break;
+            }
+
+            case SC_Format: {
+                VariadicAdaptor::callFormatBox64(ra->format.proc, ra->format.format,
+                                                 ra->format.args, ra->format.ret);
+                break;
+            }
+
+            case SC_ThreadCreate: {
+                NewThreadInfo info;
+                info.hostEntry = ra->threadCreate.start_routine;
+                info.hostArg = ra->threadCreate.arg;
+
+                pthread_mutex_init(&info.mutex, nullptr);
+                pthread_mutex_lock(&info.mutex);
+                pthread_cond_init(&info.cond, nullptr);
+
+                // Spawn the guest thread, then block until newThreadEntry signals that it has
+                // copied `info` out. Only then is it safe to let this stack frame unwind.
+                TraceRecorder::begin(TE_ThreadCreate,
+                                     reinterpret_cast<uintptr_t>(ra->threadCreate.start_routine));
+                int rc = pthread_create(
+                    &info.thread, reinterpret_cast<pthread_attr_t *>(ra->threadCreate.attr),
+                    newThreadEntry, &info);
+                if (rc == 0) {
+                    pthread_cond_wait(&info.cond, &info.mutex);
+                }
+                TraceRecorder::end(TE_ThreadCreate);
+
+                pthread_mutex_unlock(&info.mutex);
+                pthread_cond_destroy(&info.cond);
+                pthread_mutex_destroy(&info.mutex);
+                *ra->threadCreate.ret = rc;
+
+                break;
+            }
+
+            case SC_ThreadExit: {
+                TraceRecorder::instant(TE_ThreadExit);
+                pthread_exit(ra->threadExit.ret);
+                break;
+            }
+
+            default:
+                break;
+        }
+    }
+
+    static inline uint32_t loadAcquire(const uint32_t &value) {
+        return __atomic_load_n(&value, __ATOMIC_ACQUIRE);
+    }
+
+    // Attach this thread's async ring on first use. Returns nullptr when the host runs no async
+    // workers, in which case async calls run synchronously.
+    static AsyncRing *threadAsyncRing() {
+        auto &calls = thread_calls;
+        if (!calls.ring && !calls.asyncUnavailable) {
+            AsyncRing *ring = nullptr;
+            std::ignore = invokeHost(DS_AsyncAttach, &ring);
+            calls.ring = ring;
+            calls.asyncUnavailable = ring == nullptr;
+        }
+        return calls.ring;
+    }
+
+    ThreadCalls::~ThreadCalls() {
+        GuestClient::flushDeferred();
+        GuestClient::drainAsync();
+        if (ring) {
+            std::ignore = invokeHost(DS_AsyncDetach, ring);
+            ring = nullptr;
+        }
+    }
+
+    GuestClient::AsyncHandle GuestClient::invokeAsync(void *proc, void **args,
+                                                      const unsigned *argSizes, int argc,
+                                                      void *ret) {
+        // Deferred calls recorded before this one must reach the host first.
+        flushDeferred();
+
+        size_t size = 0;
+        for (int i = 0; i < argc; ++i) {
+            size += alignRecord(argSizes[i]);
+        }
+        AsyncRing *ring = threadAsyncRing();
+        if (!ring || argc > DeferredCallMaxArgs || size > sizeof(AsyncCall::data)) {
+            // No ring, or too large for a slot: run it now (invokeFunction drains the ring first), so
+            // the last call posted is complete too.
+            invokeStandard(proc, args, ret, nullptr);
+            return ring ? ring->tail - 1 : 0;
+        }
+
+        // Wait for the slot's previous call if the ring is full.
+        const uint32_t tail = ring->tail;
+        if (tail - loadAcquire(ring->done) >= AsyncRing::Size) {
+            waitAsync(tail - AsyncRing::Size);
+        }
+
+        auto &call = ring->slots[tail % AsyncRing::Size];
+        size_t pos = 0;
+        for (int i = 0; i < argc; ++i) {
+            call.args[i] = call.data + pos;
+            std::memcpy(call.data + pos, args[i], argSizes[i]);
+            pos += alignRecord(argSizes[i]);
+        }
+        call.ia.conv = CC_Standard;
+        call.ia.standard.proc = proc;
+        call.ia.standard.args = call.args;
+        call.ia.standard.ret = ret;
+        call.ia.standard.metadata = nullptr;
+
+        // Publish the call, then wake the worker if it parked. Both accesses are sequentially
+        // consistent, pairing with the worker raising `parked` before it rechecks `tail`, so one
+        // side always sees the other.
+        __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&ring->parked, __ATOMIC_SEQ_CST)) {
+            std::ignore = invokeHost(DS_AsyncNotify, ring);
+        }
+        return tail;
+    }
+
+    void GuestClient::waitAsync(AsyncHandle handle) {
+        AsyncRing *ring = thread_calls.ring;
+        if (!ring || static_cast<int32_t>(loadAcquire(ring->done) - handle) > 0) {
+            return;
+        }
+        assert(thread_calls.asyncReentryDepth == 0);
+
+        // The host answers 0 once the call is complete, or 1 while the running call waits for a
+        // reentry, which must run here, on the thread that posted it.
+        for (;;) {
+            int ret = 0;
+            void *a[] = {
+                ring,
+                reinterpret_cast<void *>(static_cast<uintptr_t>(handle)),
+                &ret,
+            };
+            std::ignore = invokeHost(DS_AsyncWait, a);
+            if (ret == 0) {
+                break;
+            }
+            assert(ret == 1 && ring->ra != nullptr);
+
+            thread_calls.asyncReentryDepth++;
+            TraceRecorder::begin(TE_Reentry, ring->ra->conv);
+            serviceReentry(ring->ra);
+            flushDeferred();
+            TraceRecorder::end(TE_Reentry);
+            thread_calls.asyncReentryDepth--;
+            std::ignore = invokeHost(DS_AsyncResume, ring);
+        }
+    }
+
+    void GuestClient::drainAsync() {
+        AsyncRing *ring = thread_calls.ring;
+        if (!ring || thread_calls.asyncReentryDepth > 0 || loadAcquire(ring->done) == ring->tail) {
+            return;
+        }
+        waitAsync(ring->tail - 1);
+    }
+
     int GuestClient::invokeFunction(const InvocationArguments *ia) {
+        // Async and deferred calls run before anything issued after them.
+        drainAsync();
+        flushDeferred();
+
+        TraceRecorder::begin(TE_Invoke, ia->conv);
         ReentryArguments *ra = nullptr;
         int ret = 0;
         void *opaque[] = {
@@ -250,69 +731,60 @@ namespace lore::mod {
         // returns 0, meaning the original invocation is complete.
         while (ret != 0) {
             assert(ret == 1 && ra != nullptr);
-            switch (ra->conv) {
-                case SC_Standard: {
-                    using Func = void (*)(void * /*args*/, void * /*ret*/, void * /*metadata*/);
-
-                    auto func = reinterpret_cast<Func>(ra->standard.proc);
-                    func(ra->standard.args, ra->standard.ret, ra->standard.metadata);
-                    break;
-                }
+            TraceRecorder::begin(TE_Reentry, ra->conv);
+            serviceReentry(ra);
 
-                case SC_StandardCallback: {
-                    using Func = void (*)(void * /*callback*/, void * /*args*/, void * /*ret*/,
-                                          void * /*metadata*/);
-
-                    auto func = reinterpret_cast<Func>(ra->standardCallback.proc);
-                    func(ra->standardCallback.callback, ra->standardCallback.args,
-                         ra->standardCallback.ret, ra->standardCallback.metadata);
-                    break;
-                }
+            // Deferred calls the reentry made must run before the host resumes.
+            flushDeferred();
+            TraceRecorder::end(TE_Reentry);
+            std::ignore = invokeHost(DS_ResumeFunction, &ret);
+        }
+        TraceRecorder::end(TE_Invoke);
+        return 0;
+    }
 
-                case SC_Format: {
-                    VariadicAdaptor::callFormatBox64(ra->format.proc, ra->format.format,
-                                                     ra->format.args, ra->format.ret);
-                    break;
-                }
+    void GuestClient::flushHostStdio() {
+        flushDeferred();
+        drainAsync();
+        std::ignore = invokeHost(DS_FlushStdio, nullptr);
+    }
 
-                case SC_ThreadCreate: {
-                    NewThreadInfo info;
-                    info.hostEntry = ra->threadCreate.start_routine;
-                    info.hostArg = ra->threadCreate.arg;
-
-                    pthread_mutex_init(&info.mutex, nullptr);
-                    pthread_mutex_lock(&info.mutex);
-                    pthread_cond_init(&info.cond, nullptr);
-
-                    // Spawn the guest thread, then block until newThreadEntry signals that it has
-                    // copied `info` out. Only then is it safe to let this stack frame unwind.
-                    int rc = pthread_create(
-                        &info.thread, reinterpret_cast<pthread_attr_t *>(ra->threadCreate.attr),
-                        newThreadEntry, &info);
-                    if (rc == 0) {
-                        pthread_cond_wait(&info.cond, &info.mutex);
-                    }
-
-                    pthread_mutex_unlock(&info.mutex);
-                    pthread_cond_destroy(&info.cond);
-                    pthread_mutex_destroy(&info.mutex);
-                    *ra->threadCreate.ret = rc;
-
-                    break;
-                }
+    void GuestClient::submitTrace() {
+        if (!TraceRecorder::enabled()) {
+            return;
+        }
+        const auto buffers = TraceRecorder::buffers();
+        TraceSubmitArguments a = {};
+        a.buffers = buffers.data();
+        a.count = static_cast<uint32_t>(buffers.size());
+        std::ignore = invokeHost(DS_TraceSubmit, &a);
+    }
 
-                case SC_ThreadExit: {
-                    pthread_exit(ra->threadExit.ret);
-                    break;
-                }
+    void GuestClient::elideCallbacks(const char *spec) {
+        std::vector<std::string> bad;
+        const auto rules = CallbackElision::parse(spec, &bad);
+        for (const auto &item : bad) {
+            log::logger().loreWarningF("callback elision: %s: expected name:signature[=host]",
+                                       item.c_str());
+        }
 
-                default:
-                    break;
+        std::vector<CallbackElisionEntry> entries;
+        for (const auto &rule : rules) {
+            const void *guestFunction = dlsym(RTLD_DEFAULT, rule.name.c_str());
+            if (!guestFunction) {
+                continue;
             }
-
-            std::ignore = invokeHost(DS_ResumeFunction, &ret);
+            entries.push_back({guestFunction, rule.hostName.c_str(), rule.signature.c_str()});
         }
-        return 0;
+        if (entries.empty()) {
+            return;
+        }
+        CallbackElisionArguments a = {};
+        a.entries = entries.data();
+        a.count = static_cast<uint32_t>(entries.size());
+        std::ignore = invokeHost(DS_ElideCallbacks, &a);
+        log::logger().loreDebugF("callback elision: %u of %u functions run on the host",
+                                 a.installed, a.count);
     }
 
     CThunkInfo GuestClient::getThunkInfo(const char *path, bool isReverse) {
@@ -326,4 +798,12 @@ namespace lore::mod {
         return ret;
     }
 
+    int GuestClient::getCrossingStats(CrossingStatsEntry *entries, int capacity) {
+        CrossingStatsArguments a = {};
+        a.entries = entries;
+        a.capacity = static_cast<uint32_t>(capacity);
+        std::ignore = invokeHost(DS_GetStats, &a);
+        return a.enabled ? static_cast<int>(a.count) : -1;
+    }
+
 }
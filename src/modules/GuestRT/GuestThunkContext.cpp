@@ -3,13 +3,17 @@
 #include "GuestThunkContext.h"
 
 #include <dlfcn.h>
+#include <sys/stat.h>
 
 #include <cstdio>
 #include <cstdint>
+#include <cstdlib>
 #include <map>
 #include <string>
 
 #include <lorelei/Support/Logging.h>
+#include <lorelei/DLCall/Tools/AddressRangeIndex.h>
+#include <lorelei/DLCall/Tools/FunctionTrampoline.h>
 
 #include <NextLibrary.h>
 
@@ -57,6 +61,8 @@ namespace lore::mod {
 #endif
 
     GuestThunkContext::~GuestThunkContext() {
+        // The stubs branch into this thunk's code, which is about to go away.
+        FunctionTrampolineArena::instance().releaseOwner(trampolineOwner());
         if (m_htlHandle) {
             std::ignore = GuestClient::freeLibrary(m_htlHandle);
         }
@@ -82,6 +88,7 @@ namespace lore::mod {
         }
         const char *modulePath = selfInfo.dli_fname;
 #endif
+        m_modulePath = modulePath;
 
         // Pick the host thunk library (HTL) to load. The database wins if it names one (a JSON entry);
         // otherwise the path baked into this thunk; otherwise the lib<name>_HTL.so name convention.
@@ -116,6 +123,63 @@ namespace lore::mod {
             &m_staticThunkContext,
         };
         GuestClient::invokeFormat(exchangeFunc, "v_p", args, nullptr);
+
+        // The exchange brought the host's emuAddr. When every guest object lies at or below it, the
+        // address index rejects the host's half numerically. Also indexes this thunk.
+        AddressRangeIndex::instance().setPivot(m_staticThunkContext->emuAddr, /*localAbove=*/false);
+    }
+
+    void *GuestThunkContext::guestFunction(const char *name) {
+        std::call_once(m_guestLibraryOnce, [this]() { openGuestLibrary(); });
+        return m_guestLibraryHandle ? dlsym(m_guestLibraryHandle, name) : nullptr;
+    }
+
+    void GuestThunkContext::openGuestLibrary() {
+        const char *searchPath = std::getenv("LORELEI_GUEST_LIBRARY_PATH");
+        if (!searchPath || !*searchPath) {
+            return;
+        }
+        const auto slash = m_modulePath.find_last_of('/');
+        const std::string fileName =
+            slash == std::string::npos ? m_modulePath : m_modulePath.substr(slash + 1);
+
+        // The thunk is on the loader's search path under the library's own name, so a directory
+        // that holds it is skipped by identity rather than by path.
+        struct stat self = {};
+        const bool hasSelf = ::stat(m_modulePath.c_str(), &self) == 0;
+
+        std::string dirs(searchPath);
+        for (size_t begin = 0; begin <= dirs.size();) {
+            size_t end = dirs.find(':', begin);
+            if (end == std::string::npos) {
+                end = dirs.size();
+            }
+            const std::string dir = dirs.substr(begin, end - begin);
+            begin = end + 1;
+            if (dir.empty()) {
+                continue;
+            }
+
+            const std::string path = dir + "/" + fileName;
+            struct stat st = {};
+            if (::stat(path.c_str(), &st) != 0 ||
+                (hasSelf && st.st_dev == self.st_dev && st.st_ino == self.st_ino)) {
+                continue;
+            }
+            // RTLD_DEEPBIND: the library's calls to its own functions must stay in it rather than
+            // bind to this thunk, which exports the same names first. It is never unloaded: a
+            // placement site may call into it until the process exits.
+            m_guestLibraryHandle = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL | RTLD_DEEPBIND);
+            if (!m_guestLibraryHandle) {
+                const char *err = dlerror();
+                log::logger().loreWarningF("%s: failed to load guest library (%s)", path.c_str(),
+                                           err ? err : "unknown error");
+                continue;
+            }
+            AddressRangeIndex::instance().rescan();
+            log::logger().loreDebugF("%s: guest library for placement", path.c_str());
+            return;
+        }
     }
 
 }
@@ -0,0 +1,155 @@
+// SPDX-License-Identifier: MIT
+
+#include "ProcPlacement.h"
+
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <time.h>
+
+#include "GuestThunkContext.h"
+#include "LogCategory.h"
+
+namespace lore::mod {
+
+    namespace {
+
+        // Never destroyed: sites may be constructed until the process exits.
+        std::vector<std::pair<std::string, ProcPlacement::Route>> &overrides() {
+            static auto list = new std::vector<std::pair<std::string, ProcPlacement::Route>>();
+            return *list;
+        }
+
+        // Sites are registered as they are constructed and never unlinked, as a LockSite is.
+        std::atomic<ProcPlacement *> siteList = nullptr;
+
+        const char *routeName(int route) {
+            return route == ProcPlacement::Guest ? "guest" : "host";
+        }
+
+    }
+
+    bool ProcPlacement::s_enabled = false;
+
+    ProcPlacement::ProcPlacement(GuestThunkContext *context, const char *name)
+        : m_name(name), m_guestFunction(context->guestFunction(name)) {
+        for (const auto &item : overrides()) {
+            if (item.first == name) {
+                m_fixed = item.second;
+                m_route = item.second;
+                break;
+            }
+        }
+        if (!m_guestFunction) {
+            if (m_fixed == Guest) {
+                log::logger().loreWarningF("placement: %s: no guest function, kept on the host",
+                                           name);
+            }
+            m_fixed = Host;
+            m_route = Host;
+        }
+
+        m_next = siteList.load(std::memory_order_relaxed);
+        while (!siteList.compare_exchange_weak(m_next, this, std::memory_order_release,
+                                               std::memory_order_relaxed)) {
+        }
+    }
+
+    void ProcPlacement::configure(const char *spec) {
+        s_enabled = spec != nullptr;
+        if (!spec) {
+            return;
+        }
+        for (const char *item = spec; *item;) {
+            const char *end = std::strchr(item, ',');
+            if (!end) {
+                end = item + std::strlen(item);
+            }
+            const std::string token(item, end);
+            item = *end ? end + 1 : end;
+
+            const auto eq = token.find('=');
+            if (eq == std::string::npos) {
+                continue; // "1" and the like: placement on, nothing forced.
+            }
+            const std::string value = token.substr(eq + 1);
+            if (value == "host" || value == "guest") {
+                overrides().emplace_back(token.substr(0, eq), value == "host" ? Host : Guest);
+            } else {
+                log::logger().loreWarningF("placement: %s: expected host or guest",
+                                           token.c_str());
+            }
+        }
+    }
+
+    uint64_t ProcPlacement::now() {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return uint64_t(ts.tv_sec) * 1000000000ull + uint64_t(ts.tv_nsec);
+    }
+
+    void ProcPlacement::addCall(Route route, uint64_t ns) {
+        m_routeCalls[route].fetch_add(1, std::memory_order_relaxed);
+        if (ns == 0) {
+            return;
+        }
+
+        // An exponential moving average over about 8 samples. A sample is clamped to 8 times the
+        // average, so one page fault or preemption does not swing the decision.
+        const uint64_t sample = ns * 16;
+        uint64_t average = m_average[route].load(std::memory_order_relaxed);
+        if (average == 0) {
+            average = sample;
+        } else {
+            const uint64_t clamped = sample < average * 8 ? sample : average * 8;
+            average = average - average / 8 + clamped / 8;
+        }
+        m_average[route].store(average, std::memory_order_relaxed);
+
+        const uint64_t host = m_average[Host].load(std::memory_order_relaxed);
+        const uint64_t guest = m_average[Guest].load(std::memory_order_relaxed);
+        if (m_fixed >= 0 || host == 0 || guest == 0) {
+            return;
+        }
+        // Hysteresis: the other route must be faster by a quarter.
+        const int current = m_route.load(std::memory_order_relaxed);
+        const uint64_t here = current == Host ? host : guest;
+        const uint64_t there = current == Host ? guest : host;
+        if (there * 4 < here * 3) {
+            int expected = current;
+            if (m_route.compare_exchange_strong(expected, current == Host ? Guest : Host,
+                                                std::memory_order_relaxed)) {
+                m_switches.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    void ProcPlacement::report() {
+        if (!s_enabled) {
+            return;
+        }
+        for (auto site = siteList.load(std::memory_order_acquire); site; site = site->m_next) {
+            const uint64_t hostCalls = site->m_routeCalls[Host].load(std::memory_order_relaxed);
+            const uint64_t guestCalls = site->m_routeCalls[Guest].load(std::memory_order_relaxed);
+            const int route = site->m_route.load(std::memory_order_relaxed);
+            if (site->m_fixed >= 0) {
+                log::logger().loreInfoF("placement: %s: %s, fixed%s (%llu calls)", site->m_name,
+                                        routeName(route),
+                                        site->m_guestFunction ? "" : " (no guest function)",
+                                        (unsigned long long) (hostCalls + guestCalls));
+                continue;
+            }
+            log::logger().loreInfoF(
+                "placement: %s: %s (%llu calls, %llu on the guest; host %.0f ns, guest %.0f ns; "
+                "%u switches)",
+                site->m_name, routeName(route), (unsigned long long) (hostCalls + guestCalls),
+                (unsigned long long) guestCalls,
+                site->m_average[Host].load(std::memory_order_relaxed) / 16.0,
+                site->m_average[Guest].load(std::memory_order_relaxed) / 16.0,
+                site->m_switches.load(std::memory_order_relaxed));
+        }
+    }
+
+}
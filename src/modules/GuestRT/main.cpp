@@ -5,10 +5,13 @@
 #include <cstdio>
 #include <cstdlib>
 
+#include <lorelei/Support/LockStats.h>
 #include <lorelei/Support/Logging.h>
+#include <lorelei/DLCall/Tools/TraceRecorder.h>
 
 #include "GuestClient.h"
 #include "LogCategory.h"
+#include "ProcPlacement.h"
 
 namespace lore {
 
@@ -30,6 +33,18 @@ namespace lore {
         mod::GuestClient client;
 
         GuestRuntime() {
+            // LORELEI_LOOPBACK runs the host runtime in this process instead of under QEMU (see
+            // GuestClient::startLoopback), so a native program can load a thunk pair directly. It
+            // must be set up before the first request below.
+            if (const char *loopback = std::getenv("LORELEI_LOOPBACK"); loopback && *loopback) {
+                if (!mod::GuestClient::startLoopback("libLoreHostRT.so")) {
+                    const char *err = dlerror();
+                    std::fprintf(stderr, "%s: failed to start loopback host runtime: %s\n",
+                                 log::logger().name(), err ? err : "unknown error");
+                    std::abort();
+                }
+            }
+
             void *hostRuntimeHandle = mod::GuestClient::loadLibrary("libLoreHostRT.so", RTLD_NOW);
             if (!hostRuntimeHandle) {
                 abortHostError("failed to load host runtime");
@@ -53,6 +68,37 @@ namespace lore {
                 }
             }
             Logger::setLogCallback(logCallback);
+
+            // The guest half of LORELEI_TRACE_FILE (see the host runtime). Its rings go to the host
+            // at exit, which writes both halves into the one file.
+            if (const char *traceFile = std::getenv("LORELEI_TRACE_FILE");
+                traceFile && *traceFile) {
+                size_t traceEvents = 65536;
+                if (const char *eventsStr = std::getenv("LORELEI_TRACE_BUFFER_EVENTS")) {
+                    traceEvents = std::strtoull(eventsStr, nullptr, 0);
+                }
+                TraceRecorder::start(0, traceEvents);
+            }
+
+            LockSite::setEnabled(std::getenv("LORELEI_LOCK_STATS") != nullptr);
+
+            // LORELEI_PLACEMENT lets pass::Adaptive functions run on the guest's own copy of their
+            // library when that is cheaper than crossing (see ProcPlacement).
+            mod::ProcPlacement::configure(std::getenv("LORELEI_PLACEMENT"));
+
+            // LORELEI_CALLBACK_ELISION: the guest's libc routines the host calls natively when
+            // they are passed as callbacks (see CallbackElision). Unset, the stateless ones.
+            mod::GuestClient::elideCallbacks(std::getenv("LORELEI_CALLBACK_ELISION"));
+        }
+
+        ~GuestRuntime() {
+            // Every thunk depends on this runtime, so its destructor runs after theirs and after the
+            // program's own atexit handlers, the last point before the guest's exit_group.
+            // LORELEI_LOCK_STATS: this side's lock sites are logged through the host.
+            LockSite::report(log::logger());
+            mod::ProcPlacement::report();
+            mod::GuestClient::submitTrace();
+            mod::GuestClient::flushHostStdio();
         }
     };
 
@@ -0,0 +1,325 @@
+// SPDX-License-Identifier: MIT
+
+#include "AsyncWorkerPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <thread>
+
+#include <Invocation.h>
+
+#include <lorelei/DLCall/Tools/TraceRecorder.h>
+
+#include "CrossingStats.h"
+#include "HostServer.h"
+
+namespace lore::mod {
+
+    namespace {
+
+        using AtomicU32 = std::atomic_ref<uint32_t>;
+        using AtomicPtr = std::atomic_ref<void *>;
+
+        // Wake the guest thread waiting on the ring, if any, after a completion or a reentry.
+        void signalRing(AsyncRing *ring) {
+            AtomicU32 event(ring->event);
+            event.fetch_add(1, std::memory_order_release);
+            event.notify_all();
+        }
+
+    }
+
+    class AsyncWorkerPool::Worker {
+    public:
+        explicit Worker(AsyncWorkerPool *pool) : m_pool(pool), m_thread([this]() { run(); }) {
+        }
+
+        ~Worker() {
+            m_stop.store(true, std::memory_order_release);
+            wake();
+            m_thread.join();
+            for (auto ring : m_rings) {
+                delete ring;
+            }
+            for (auto ring : m_added) {
+                delete ring;
+            }
+        }
+
+        void add(AsyncRing *ring) {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_added.push_back(ring);
+            }
+            m_changes.fetch_add(1, std::memory_order_release);
+            wake();
+        }
+
+        // Returns false if \a ring moved to another worker before this one could take it back.
+        bool remove(AsyncRing *ring) {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (AtomicPtr(ring->worker).load(std::memory_order_relaxed) != this) {
+                    return false;
+                }
+                m_removed.push_back(ring);
+            }
+            m_changes.fetch_add(1, std::memory_order_release);
+            wake();
+            return true;
+        }
+
+        void wake() {
+            m_epoch.fetch_add(1, std::memory_order_seq_cst);
+            m_epoch.notify_one();
+        }
+
+        // Whether the worker is running a call that has reentered the guest.
+        bool blocked() const {
+            return m_blocked.load(std::memory_order_acquire);
+        }
+
+        // Whether the worker serves a ring other than \a ring.
+        bool hasOtherRings(const AsyncRing *ring) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return !m_added.empty() || m_rings.size() > 1 ||
+                   (m_rings.size() == 1 && m_rings.front() != ring);
+        }
+
+        // Move every ring but \a ring to \a to. Called on the worker thread.
+        void moveRingsTo(Worker *to, AsyncRing *ring);
+
+    protected:
+        void run();
+        void updateRings();
+        void applyChanges();
+        bool drain(AsyncRing *ring);
+        void runCall(AsyncRing *ring, AsyncCall &call);
+
+        AsyncWorkerPool *m_pool;
+
+        // m_rings is the worker thread's own. Other threads hand rings over through m_added and
+        // m_removed, and only the worker frees a ring, so a ring it is reading is never freed. A
+        // ring's worker pointer changes only under the mutex of both its old and its new worker.
+        std::vector<AsyncRing *> m_rings;
+        std::vector<AsyncRing *> m_added;
+        std::vector<AsyncRing *> m_removed;
+        std::mutex m_mutex;
+        std::atomic<uint32_t> m_changes = 0;
+        uint32_t m_seenChanges = 0;
+
+        std::atomic<uint32_t> m_epoch = 0;
+        std::atomic<bool> m_stop = false;
+        std::atomic<bool> m_blocked = false;
+
+        // Last, so that the thread starts with every other member initialized.
+        std::thread m_thread;
+    };
+
+    void AsyncWorkerPool::Worker::run() {
+        while (!m_stop.load(std::memory_order_acquire)) {
+            if (m_changes.load(std::memory_order_acquire) != m_seenChanges) {
+                updateRings();
+            }
+
+            // By index: a call that reenters moves the other rings away (see moveRingsTo).
+            bool busy = false;
+            for (size_t i = 0; i < m_rings.size(); ++i) {
+                busy |= drain(m_rings[i]);
+            }
+            if (busy) {
+                continue;
+            }
+
+            // Park. Raise every ring's parked flag, then recheck for calls posted meanwhile: a guest
+            // that posted before seeing the flag is caught by the recheck, and one that posts after
+            // sees it and sends DS_AsyncNotify, which bumps m_epoch past the value read here.
+            const uint32_t epoch = m_epoch.load(std::memory_order_seq_cst);
+            bool pending = false;
+            for (auto ring : m_rings) {
+                AtomicU32(ring->parked).store(1, std::memory_order_seq_cst);
+            }
+            for (auto ring : m_rings) {
+                pending |= AtomicU32(ring->tail).load(std::memory_order_seq_cst) !=
+                           AtomicU32(ring->done).load(std::memory_order_relaxed);
+            }
+            if (!pending && m_changes.load(std::memory_order_acquire) == m_seenChanges) {
+                m_epoch.wait(epoch, std::memory_order_seq_cst);
+            }
+            for (auto ring : m_rings) {
+                AtomicU32(ring->parked).store(0, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    void AsyncWorkerPool::Worker::updateRings() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        applyChanges();
+    }
+
+    void AsyncWorkerPool::Worker::applyChanges() {
+        m_seenChanges = m_changes.load(std::memory_order_acquire);
+        m_rings.insert(m_rings.end(), m_added.begin(), m_added.end());
+        m_added.clear();
+        for (auto ring : m_removed) {
+            // The guest drains a ring before it detaches it.
+            assert(ring->tail == ring->done);
+            m_rings.erase(std::remove(m_rings.begin(), m_rings.end(), ring), m_rings.end());
+            delete ring;
+        }
+        m_removed.clear();
+    }
+
+    void AsyncWorkerPool::Worker::moveRingsTo(Worker *to, AsyncRing *ring) {
+        {
+            std::scoped_lock lock(m_mutex, to->m_mutex);
+            // Take in pending changes first, so that a ring its guest detached is freed here rather
+            // than moved.
+            applyChanges();
+            for (auto other : m_rings) {
+                if (other != ring) {
+                    AtomicPtr(other->worker).store(to, std::memory_order_relaxed);
+                    to->m_added.push_back(other);
+                }
+            }
+            m_rings.assign(1, ring);
+        }
+        to->m_changes.fetch_add(1, std::memory_order_release);
+        to->wake();
+    }
+
+    bool AsyncWorkerPool::Worker::drain(AsyncRing *ring) {
+        AtomicU32 tail(ring->tail);
+        AtomicU32 done(ring->done);
+
+        uint32_t next = done.load(std::memory_order_relaxed);
+        if (tail.load(std::memory_order_acquire) == next) {
+            return false;
+        }
+        do {
+            runCall(ring, ring->slots[next % AsyncRing::Size]);
+            done.store(++next, std::memory_order_release);
+            signalRing(ring);
+        } while (tail.load(std::memory_order_acquire) != next);
+
+        HostServer::instance()->flushStdioIfNeeded();
+        return true;
+    }
+
+    void AsyncWorkerPool::Worker::runCall(AsyncRing *ring, AsyncCall &call) {
+        // The same driver loop as a synchronous call (see utils::Invocation), except that the
+        // reentry runs on the guest thread that posted the call, which picks it up in wait().
+        TraceRecorder::begin(TE_Invoke, reinterpret_cast<uintptr_t>(call.ia.standard.proc));
+        const bool stats = CrossingStats::enabled();
+        if (stats) {
+            CrossingStats::instance().begin(call.ia.standard.proc);
+        }
+        ReentryArguments *ra = nullptr;
+        int64_t status = utils::Invocation::invoke(&call.ia, reinterpret_cast<void **>(&ra));
+        if (status == 1) {
+            // The call may wait on the guest for good, e.g. in an event loop: let the other rings
+            // run elsewhere meanwhile.
+            m_blocked.store(true, std::memory_order_release);
+            m_pool->handOff(this, ring);
+        }
+        while (status == 1) {
+            if (stats) {
+                CrossingStats::instance().pause();
+            }
+            AtomicU32 reentry(ring->reentry);
+            ring->ra = ra;
+            reentry.store(1, std::memory_order_release);
+            signalRing(ring);
+            while (reentry.load(std::memory_order_acquire) != 0) {
+                reentry.wait(1, std::memory_order_acquire);
+            }
+            if (stats) {
+                CrossingStats::instance().resume();
+            }
+            status = utils::Invocation::resume();
+        }
+        m_blocked.store(false, std::memory_order_release);
+        if (stats) {
+            CrossingStats::instance().end();
+        }
+        TraceRecorder::end(TE_Invoke);
+    }
+
+    AsyncWorkerPool::AsyncWorkerPool(int workerCount) : m_workerCount(workerCount) {
+    }
+
+    AsyncWorkerPool::~AsyncWorkerPool() = default;
+
+    AsyncRing *AsyncWorkerPool::attach() {
+        if (m_workerCount <= 0) {
+            return nullptr;
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_workers.empty()) {
+            for (int i = 0; i < m_workerCount; ++i) {
+                m_workers.push_back(std::make_unique<Worker>(this));
+            }
+        }
+
+        auto ring = new AsyncRing();
+        auto worker = pickWorker(nullptr);
+        ring->worker = worker;
+        worker->add(ring);
+        return ring;
+    }
+
+    void AsyncWorkerPool::detach(AsyncRing *ring) {
+        while (!static_cast<Worker *>(AtomicPtr(ring->worker).load(std::memory_order_acquire))
+                    ->remove(ring)) {
+        }
+    }
+
+    void AsyncWorkerPool::notify(AsyncRing *ring) {
+        // A worker that takes the ring over wakes itself, so a stale pointer loses no post.
+        static_cast<Worker *>(AtomicPtr(ring->worker).load(std::memory_order_acquire))->wake();
+    }
+
+    int AsyncWorkerPool::wait(AsyncRing *ring, uint32_t seq) {
+        AtomicU32 event(ring->event);
+        AtomicU32 done(ring->done);
+        AtomicU32 reentry(ring->reentry);
+        for (;;) {
+            // Read the event count before the state, so a change after the check ends the wait.
+            const uint32_t seen = event.load(std::memory_order_acquire);
+            if (static_cast<int32_t>(done.load(std::memory_order_acquire) - seq) > 0) {
+                return 0;
+            }
+            if (reentry.load(std::memory_order_acquire) != 0) {
+                return 1;
+            }
+            event.wait(seen, std::memory_order_acquire);
+        }
+    }
+
+    void AsyncWorkerPool::resume(AsyncRing *ring) {
+        AtomicU32 reentry(ring->reentry);
+        reentry.store(0, std::memory_order_release);
+        reentry.notify_one();
+    }
+
+    AsyncWorkerPool::Worker *AsyncWorkerPool::pickWorker(const Worker *except) {
+        for (size_t i = 0; i < m_workers.size(); ++i) {
+            auto worker = m_workers[m_next++ % m_workers.size()].get();
+            if (worker != except && !worker->blocked()) {
+                return worker;
+            }
+        }
+        m_workers.push_back(std::make_unique<Worker>(this));
+        return m_workers.back().get();
+    }
+
+    void AsyncWorkerPool::handOff(Worker *from, AsyncRing *ring) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (from->hasOtherRings(ring)) {
+            from->moveRingsTo(pickWorker(from), ring);
+        }
+    }
+
+}
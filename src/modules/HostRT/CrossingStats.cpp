@@ -0,0 +1,327 @@
+// SPDX-License-Identifier: MIT
+
+#include "CrossingStats.h"
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cstring>
+#include <map>
+#include <new>
+
+#include <dlfcn.h>
+#include <time.h>
+
+#include <lorelei/Support/Logging.h>
+
+#include "LogCategory.h"
+
+namespace lore::mod {
+
+    struct CrossingStats::Counters {
+        // Written by the owning thread only, read by snapshots.
+        std::atomic<uint64_t> calls;
+        std::atomic<uint64_t> reentries;
+        std::atomic<uint64_t> maxDepth;
+        std::atomic<uint64_t> wallTime;
+        std::atomic<uint64_t> cpuTime;
+        std::atomic<uint64_t> wallHistogram[CrossingHistogramBuckets];
+        std::atomic<uint64_t> cpuHistogram[CrossingHistogramBuckets];
+    };
+
+    struct CrossingStats::ThreadData {
+        struct Frame {
+            Counters *counters;
+            int64_t wallStart;
+            int64_t cpuStart;
+            uint64_t wallTime;
+            uint64_t cpuTime;
+            uint64_t reentries;
+        };
+
+        // Guards inserting into procs against a snapshot walking it. The owning thread looks its
+        // procs up without it.
+        std::mutex mutex;
+        std::unordered_map<void *, Counters> procs;
+        std::vector<Frame> frames;
+    };
+
+    namespace {
+
+        int64_t readClock(clockid_t clock) {
+            timespec ts;
+            clock_gettime(clock, &ts);
+            return int64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+        }
+
+        // Counters have a single writer, so a plain read-modify-write is enough.
+        void add(std::atomic<uint64_t> &counter, uint64_t value) {
+            counter.store(counter.load(std::memory_order_relaxed) + value,
+                          std::memory_order_relaxed);
+        }
+
+        int bucketOf(uint64_t ns) {
+            const int bucket = 63 - __builtin_clzll(ns | 1);
+            return std::min(bucket, CrossingHistogramBuckets - 1);
+        }
+
+        void accumulateCounters(CrossingStatsEntry &entry,
+                                const CrossingStats::Counters &counters) {
+            const auto load = [](const std::atomic<uint64_t> &counter) {
+                return counter.load(std::memory_order_relaxed);
+            };
+            entry.calls += load(counters.calls);
+            entry.reentries += load(counters.reentries);
+            entry.maxDepth = std::max(entry.maxDepth, load(counters.maxDepth));
+            entry.wallTime += load(counters.wallTime);
+            entry.cpuTime += load(counters.cpuTime);
+            for (int i = 0; i < CrossingHistogramBuckets; ++i) {
+                entry.wallHistogram[i] += load(counters.wallHistogram[i]);
+                entry.cpuHistogram[i] += load(counters.cpuHistogram[i]);
+            }
+        }
+
+        // The upper bound of the bucket holding the given fraction of the calls, in nanoseconds.
+        uint64_t percentile(const uint64_t *histogram, uint64_t calls, double fraction) {
+            const auto target = uint64_t(double(calls) * fraction);
+            uint64_t seen = 0;
+            for (int i = 0; i < CrossingHistogramBuckets; ++i) {
+                seen += histogram[i];
+                if (seen > target) {
+                    return uint64_t(2) << i;
+                }
+            }
+            return uint64_t(2) << (CrossingHistogramBuckets - 1);
+        }
+
+        struct ThreadSlot {
+            CrossingStats::ThreadData *data = nullptr;
+
+            ~ThreadSlot() {
+                if (data) {
+                    CrossingStats::instance().retire(data);
+                }
+            }
+        };
+
+        thread_local ThreadSlot threadSlot;
+
+    }
+
+    bool CrossingStats::s_enabled = false;
+
+    CrossingStats::CrossingStats() = default;
+
+    CrossingStats::~CrossingStats() = default;
+
+    CrossingStats &CrossingStats::instance() {
+        // Never destroyed: threads may retire their counters during process teardown.
+        static auto stats = new CrossingStats();
+        return *stats;
+    }
+
+    void CrossingStats::setEnabled(bool enabled) {
+        s_enabled = enabled;
+    }
+
+    void CrossingStats::registerThunk(const char *library,
+                                      const thunk::StaticThunkContext *context) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        const auto &name = m_libraries[context] = library ? library : "";
+        for (int kind = thunk::Function; kind < thunk::NumProcKind; ++kind) {
+            // The host Entries the guest invokes: the GuestToHost procs of this side.
+            const auto &procs = context->hostProcs[kind][thunk::GuestToHost];
+            for (size_t i = 0; i < procs.size; ++i) {
+                if (procs.arr[i].addr) {
+                    m_names[procs.arr[i].addr] = {&name, procs.arr[i].key, uint32_t(kind),
+                                                  uint32_t(i)};
+                }
+            }
+        }
+    }
+
+    void CrossingStats::unregisterThunk(const thunk::StaticThunkContext *context) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_libraries.find(context);
+        if (it == m_libraries.end()) {
+            return;
+        }
+        std::erase_if(m_names, [&](const auto &item) {
+            return item.second.library == &it->second;
+        });
+        m_libraries.erase(it);
+    }
+
+    bool CrossingStats::procName(void *proc, std::string *library, std::string *name) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_names.find(proc);
+        if (it == m_names.end()) {
+            return false;
+        }
+        *library = *it->second.library;
+        *name = it->second.name ? it->second.name : "";
+        return true;
+    }
+
+    CrossingStats::ThreadData *CrossingStats::threadData() {
+        if (!threadSlot.data) {
+            threadSlot.data = new ThreadData();
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_threads.push_back(threadSlot.data);
+        }
+        return threadSlot.data;
+    }
+
+    void CrossingStats::begin(void *proc) {
+        auto data = threadData();
+        auto it = data->procs.find(proc);
+        if (it == data->procs.end()) {
+            std::lock_guard<std::mutex> lock(data->mutex);
+            it = data->procs.try_emplace(proc).first;
+        }
+        data->frames.push_back({&it->second, readClock(CLOCK_MONOTONIC),
+                                readClock(CLOCK_THREAD_CPUTIME_ID), 0, 0, 0});
+    }
+
+    void CrossingStats::pause() {
+        auto data = threadData();
+        if (data->frames.empty()) {
+            return;
+        }
+        auto &frame = data->frames.back();
+        frame.wallTime += readClock(CLOCK_MONOTONIC) - frame.wallStart;
+        frame.cpuTime += readClock(CLOCK_THREAD_CPUTIME_ID) - frame.cpuStart;
+        ++frame.reentries;
+    }
+
+    void CrossingStats::resume() {
+        auto data = threadData();
+        if (data->frames.empty()) {
+            return;
+        }
+        auto &frame = data->frames.back();
+        frame.wallStart = readClock(CLOCK_MONOTONIC);
+        frame.cpuStart = readClock(CLOCK_THREAD_CPUTIME_ID);
+    }
+
+    void CrossingStats::end() {
+        auto data = threadData();
+        if (data->frames.empty()) {
+            return;
+        }
+        const uint64_t depth = data->frames.size();
+        const auto frame = data->frames.back();
+        data->frames.pop_back();
+
+        const uint64_t wallTime = frame.wallTime + (readClock(CLOCK_MONOTONIC) - frame.wallStart);
+        const uint64_t cpuTime =
+            frame.cpuTime + (readClock(CLOCK_THREAD_CPUTIME_ID) - frame.cpuStart);
+        auto &counters = *frame.counters;
+        add(counters.calls, 1);
+        add(counters.reentries, frame.reentries);
+        if (depth > counters.maxDepth.load(std::memory_order_relaxed)) {
+            counters.maxDepth.store(depth, std::memory_order_relaxed);
+        }
+        add(counters.wallTime, wallTime);
+        add(counters.cpuTime, cpuTime);
+        add(counters.wallHistogram[bucketOf(wallTime)], 1);
+        add(counters.cpuHistogram[bucketOf(cpuTime)], 1);
+    }
+
+    void CrossingStats::retire(ThreadData *data) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (const auto &[proc, counters] : data->procs) {
+                auto &entry = m_retired[proc];
+                entry.proc = proc;
+                accumulateCounters(entry, counters);
+            }
+            std::erase(m_threads, data);
+        }
+        delete data;
+    }
+
+    std::vector<CrossingStatsEntry> CrossingStats::collect() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto totals = m_retired;
+        for (auto data : m_threads) {
+            std::lock_guard<std::mutex> threadLock(data->mutex);
+            for (const auto &[proc, counters] : data->procs) {
+                auto &entry = totals[proc];
+                entry.proc = proc;
+                accumulateCounters(entry, counters);
+            }
+        }
+
+        std::vector<CrossingStatsEntry> entries;
+        entries.reserve(totals.size());
+        for (auto &[proc, entry] : totals) {
+            if (auto it = m_names.find(proc); it != m_names.end()) {
+                entry.library = it->second.library->c_str();
+                entry.name = it->second.name;
+                entry.kind = it->second.kind;
+                entry.slot = it->second.slot;
+            } else {
+                // Not a thunk Entry, e.g. the real function of a CC_Format call.
+                Dl_info info;
+                const bool found = dladdr(proc, &info) != 0;
+                entry.library = found ? info.dli_fname : nullptr;
+                entry.name = found ? info.dli_sname : nullptr;
+                entry.kind = thunk::Function;
+                entry.slot = UINT32_MAX;
+            }
+            entries.push_back(entry);
+        }
+        std::sort(entries.begin(), entries.end(), [](const auto &lhs, const auto &rhs) {
+            return lhs.wallTime > rhs.wallTime;
+        });
+        return entries;
+    }
+
+    void CrossingStats::snapshot(CrossingStatsArguments *a) {
+        a->enabled = s_enabled;
+        const auto entries = collect();
+        a->count = uint32_t(entries.size());
+        const size_t n = std::min<size_t>(entries.size(), a->capacity);
+        std::copy_n(entries.begin(), n, a->entries);
+    }
+
+    void CrossingStats::report() {
+        if (!s_enabled) {
+            return;
+        }
+        const auto entries = collect();
+
+        // Group by library, keeping each group busiest first.
+        std::map<std::string, std::vector<const CrossingStatsEntry *>> libraries;
+        for (const auto &entry : entries) {
+            libraries[entry.library ? entry.library : "<unknown>"].push_back(&entry);
+        }
+        for (const auto &[library, procs] : libraries) {
+            uint64_t calls = 0;
+            uint64_t wallTime = 0;
+            uint64_t cpuTime = 0;
+            for (auto entry : procs) {
+                calls += entry->calls;
+                wallTime += entry->wallTime;
+                cpuTime += entry->cpuTime;
+            }
+            log::logger().loreInfoF("crossings: %s: %llu calls, %.3f ms wall, %.3f ms cpu",
+                                    library.c_str(), (unsigned long long) calls, wallTime / 1e6,
+                                    cpuTime / 1e6);
+            for (auto entry : procs) {
+                log::logger().loreInfoF(
+                    "crossings:   %s: %llu calls, %llu reentries, depth %llu, %.3f ms wall "
+                    "(mean %.2f us, p50 < %.2f us, p99 < %.2f us), %.3f ms cpu",
+                    entry->name ? entry->name : "<unknown>", (unsigned long long) entry->calls,
+                    (unsigned long long) entry->reentries, (unsigned long long) entry->maxDepth,
+                    entry->wallTime / 1e6,
+                    entry->calls ? entry->wallTime / 1e3 / entry->calls : 0.0,
+                    percentile(entry->wallHistogram, entry->calls, 0.5) / 1e3,
+                    percentile(entry->wallHistogram, entry->calls, 0.99) / 1e3,
+                    entry->cpuTime / 1e6);
+            }
+        }
+    }
+
+}
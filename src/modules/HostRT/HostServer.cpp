@@ -6,26 +6,41 @@
 #include <cstdlib>
 #include <cstring>
 #include <cassert>
+#include <cerrno>
 
 #include <dlfcn.h>
 #include <limits.h>
+#include <stdio_ext.h>
+#include <time.h>
 
 #ifdef __linux__
 #  include <link.h>
 #endif
 
+#include <lorelei/Support/LockStats.h>
 #include <lorelei/Support/Logging.h>
+#include <lorelei/Support/Probes.h>
 #include <lorelei/Support/StringExtras.h>
+#include <lorelei/DLCall/Tools/AddressRangeIndex.h>
+#include <lorelei/DLCall/Tools/CallbackElision.h>
+#include <lorelei/DLCall/Tools/CallLog.h>
+#include <lorelei/DLCall/Tools/PerfMap.h>
+#include <lorelei/DLCall/Tools/TraceRecorder.h>
 #include <lorelei/DLCall/Tools/VariadicAdaptor.h>
 
 #include <Invocation.h>
 
+#include "AsyncWorkerPool.h"
+#include "CrossingStats.h"
 #include "LogCategory.h"
+#include "TraceWriter.h"
 
 namespace lore::mod {
 
     namespace {
 
+        LockSite thunkLookupSite("thunk database lookup");
+
         const char *pathGetName(const char *path) {
             const char *slashPos = std::strrchr(path, '/');
             if (!slashPos) {
@@ -78,6 +93,59 @@ namespace lore::mod {
             }
         }
 
+        // Look up every name of a DS_ResolveSymbols request in its scope.
+        void resolveSymbols(ResolveSymbolsArguments *a) {
+            void *handle = a->scope;
+            void *opened = nullptr;
+            if (a->flags & RS_ScopeIsAddress) {
+                // Hold the library the address belongs to for the duration of the lookups.
+                Dl_info info;
+                if (dladdr(a->scope, &info) && info.dli_fname) {
+                    opened = dlopen(info.dli_fname, RTLD_NOW | RTLD_NOLOAD);
+                }
+                handle = opened;
+            } else if (!handle) {
+                handle = RTLD_DEFAULT;
+            }
+
+            a->found = 0;
+            for (uint32_t i = 0; i < a->count; ++i) {
+                void *addr = handle ? dlsym(handle, a->names[i]) : nullptr;
+                a->addrs[i] = addr;
+                if (!addr) {
+                    if (a->modulePaths) {
+                        a->modulePaths[i] = nullptr;
+                    }
+                    continue;
+                }
+                ++a->found;
+                if (a->modulePaths) {
+                    Dl_info info;
+                    a->modulePaths[i] = dladdr(addr, &info) ? info.dli_fname : nullptr;
+                }
+            }
+
+            if (opened) {
+                std::ignore = dlclose(opened);
+            }
+        }
+
+        // Install the host function of each entry of a DS_ElideCallbacks request that has one.
+        void elideCallbacks(CallbackElisionArguments *a) {
+            a->installed = 0;
+            for (uint32_t i = 0; i < a->count; ++i) {
+                const auto &entry = a->entries[i];
+                void *hostFunction = dlsym(RTLD_DEFAULT, entry.hostName);
+                if (!hostFunction) {
+                    log::logger().loreDebugF("callback elision: %s: not found on the host",
+                                             entry.hostName);
+                    continue;
+                }
+                CallbackElision::install(entry.guestFunction, hostFunction, entry.signature);
+                ++a->installed;
+            }
+        }
+
         // Derive the thunk base name from a library path or bare name: the basename with the rightmost
         // ".so" (and a trailing "_HTL") stripped.
         std::string thunkNameOf(const char *path) {
@@ -90,6 +158,64 @@ namespace lore::mod {
             return name;
         }
 
+        // Set while a leaf or deferred proc runs, so HostServer::reenter can trap one that was wrongly
+        // tagged: it runs on the plugin's stack, with no coroutine to suspend, and returning to the
+        // guest from there would corrupt that stack. Checked in every build.
+        thread_local bool inLeafInvocation = false;
+
+        // Call a CC_Standard-shaped proc that never reenters directly, without Invocation::invoke's
+        // coroutine switch. Serves CC_Leaf invocations and the calls of a DS_InvokeBatch.
+        void invokeLeaf(void *proc, void **args, void *ret, void *metadata) {
+            using Func = void (*)(void ** /*args*/, void * /*ret*/, void * /*metadata*/);
+
+            auto func = reinterpret_cast<Func>(proc);
+            inLeafInvocation = true;
+            func(args, ret, metadata);
+            inLeafInvocation = false;
+        }
+
+        // Call a CC_Register-shaped proc with the argument words of \a ia. The block is the guest's
+        // own (a stack local of GuestClient::invokeRegister), so the result word is written in place.
+        void invokeRegister(const InvocationArguments *ia) {
+            using Func = uint64_t (*)(uint64_t, uint64_t, uint64_t, uint64_t);
+
+            auto &r = const_cast<InvocationArguments *>(ia)->registers;
+            auto func = reinterpret_cast<Func>(r.proc);
+            r.ret = func(r.args[0], r.args[1], r.args[2], r.args[3]);
+        }
+
+        // invokeRegister for a CC_RegisterLeaf proc, which runs without a coroutine like invokeLeaf.
+        void invokeRegisterLeaf(const InvocationArguments *ia) {
+            inLeafInvocation = true;
+            invokeRegister(ia);
+            inLeafInvocation = false;
+        }
+
+        // Replay a buffer of deferred calls, in the order the guest recorded them (see
+        // DeferredCallHeader for the record layout).
+        void invokeBatch(const char *buffer, size_t size) {
+            void *args[DeferredCallMaxArgs];
+            for (size_t pos = 0; pos < size;) {
+                const auto header = reinterpret_cast<const DeferredCallHeader *>(buffer + pos);
+                const auto offsets = reinterpret_cast<const uint32_t *>(header + 1);
+                assert(header->size > 0 && pos + header->size <= size);
+                assert(header->argc <= DeferredCallMaxArgs);
+                for (uint32_t i = 0; i < header->argc; ++i) {
+                    args[i] = const_cast<char *>(buffer + pos + offsets[i]);
+                }
+                TraceRecorder::begin(TE_Invoke, reinterpret_cast<uintptr_t>(header->proc));
+                if (CrossingStats::enabled()) {
+                    CrossingStats::instance().begin(header->proc);
+                }
+                invokeLeaf(header->proc, args, nullptr, nullptr);
+                if (CrossingStats::enabled()) {
+                    CrossingStats::instance().end();
+                }
+                TraceRecorder::end(TE_Invoke);
+                pos += header->size;
+            }
+        }
+
     }
 
     void *HostServer::emuAddr = nullptr;
@@ -129,7 +255,7 @@ namespace lore::mod {
     void HostServer::getThunkInfo(const char *path, bool isReverse, CThunkInfo *ret) {
         *ret = {};
 
-        std::lock_guard<std::mutex> lock(m_thunkMutex);
+        ProfiledLock<std::mutex> lock(m_thunkMutex, thunkLookupSite);
         assert(m_thunkDatabase != nullptr);
 
         const std::string name = thunkNameOf(path);
@@ -172,19 +298,167 @@ namespace lore::mod {
         return m_thunkDatabase->forwardThunk(name);
     }
 
-    bool HostServer::isHostAddressNaive(void *addr) {
-        // dladdr resolves addresses backed by a host-loaded module. Guest objects are mapped by the
-        // emulated loader and are not in the host link map, so a successful lookup means the address
-        // is host-side (the mirror of the guest-side check, where dladdr sees the guest's objects).
-        // ##FIXME: dladdr cannot see anonymous-mmap trampolines, so this naive classification is
-        // sound only because callers unwrapTrampoline() first (itself an unchecked speculative
-        // read at a fixed offset). A dedicated trampoline mmap arena would let both be range-checked
-        // directly, the way separation mode uses emuAddr. Deferred.
-        Dl_info info;
-        return dladdr(addr, &info) != 0;
+    void HostServer::configureStdioFlush(bool everyCall, int intervalMs) {
+        m_flushEveryCall = everyCall;
+        m_flushInterval = intervalMs > 0 ? int64_t(intervalMs) * 1000000 : 0;
+    }
+
+    void HostServer::flushStdioIfNeeded() {
+        if (m_flushEveryCall) {
+            std::fflush(nullptr);
+            return;
+        }
+
+        // Program output goes through the standard streams. __fpending reads a stream's buffer
+        // pointers without taking its lock, so most crossings, which write nothing, cost two loads
+        // instead of fflush(nullptr) locking and walking every open stream. Whatever they hold is
+        // written before the guest runs on, so a prompt without a newline shows before the guest
+        // blocks reading stdin. A stream a host library opened itself is fully buffered, as in a
+        // native process: it is written when its buffer fills, by its fclose, or by the
+        // DS_FlushStdio sent at guest exit.
+        if (__fpending(stdout) == 0 && __fpending(stderr) == 0) {
+            return;
+        }
+        if (m_flushInterval > 0) {
+            timespec ts;
+            clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+            const int64_t now = int64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+            int64_t last = m_lastFlushTime.load(std::memory_order_relaxed);
+            if (now - last < m_flushInterval ||
+                !m_lastFlushTime.compare_exchange_strong(last, now, std::memory_order_relaxed)) {
+                return;
+            }
+        }
+        std::fflush(stdout);
+        std::fflush(stderr);
+    }
+
+    void HostServer::configureAsync(int workerCount) {
+        m_asyncWorkerPool = std::make_unique<AsyncWorkerPool>(workerCount);
+    }
+
+    void HostServer::configureStacks(size_t stackSize, bool reportStats) {
+        utils::Invocation::setStackSize(stackSize);
+        m_reportStackStats = reportStats;
+    }
+
+    void HostServer::reportStackStats() const {
+        if (!m_reportStackStats) {
+            return;
+        }
+        const auto stats = utils::Invocation::stats();
+        log::logger().loreInfo(
+            "coroutine stacks: %1 of %2 bytes (%3 pooled), %4 bytes resident, max depth %5",
+            stats.stackCount, stats.stackSize, stats.pooledStacks, stats.residentBytes,
+            stats.maxDepth);
+    }
+
+    void HostServer::configureStats(bool enabled) {
+        CrossingStats::setEnabled(enabled);
+    }
+
+    void HostServer::configureLockStats(bool enabled) {
+        LockSite::setEnabled(enabled);
+    }
+
+    void HostServer::reportLockStats() const {
+        LockSite::report(log::logger());
+    }
+
+    void HostServer::configureTrace(const char *path, size_t capacity) {
+        if (!path || !*path) {
+            return;
+        }
+        m_traceFile = path;
+        TraceRecorder::start(1, capacity);
+    }
+
+    void HostServer::configurePerfMap(const char *mode, const char *dir) {
+        if (!mode || !*mode) {
+            return;
+        }
+        PerfMap::Format format;
+        if (std::strcmp(mode, "jitdump") == 0) {
+            format = PerfMap::JitDump;
+        } else if (std::strcmp(mode, "map") == 0 || std::strcmp(mode, "1") == 0) {
+            format = PerfMap::Map;
+        } else {
+            log::logger().loreWarning("unknown perf map mode %1", mode);
+            return;
+        }
+        if (!PerfMap::start(format, dir)) {
+            log::logger().loreWarning("failed to start the perf map (%1)", std::strerror(errno));
+        }
+    }
+
+    void HostServer::configureRecord(const char *path) {
+        if (!path || !*path) {
+            return;
+        }
+        if (!CallRecorder::start(path)) {
+            log::logger().loreWarning("failed to open the call log %1 (%2)", path,
+                                      std::strerror(errno));
+        }
+    }
+
+    void HostServer::configureVariadicBackend(const char *name) {
+        if (!name || !*name) {
+            return;
+        }
+        VariadicAdaptor::Backend backend;
+        if (std::strcmp(name, "native") == 0) {
+            backend = VariadicAdaptor::NativeVaList;
+        } else if (std::strcmp(name, "ffcall") == 0) {
+            backend = VariadicAdaptor::FFCall;
+        } else if (std::strcmp(name, "libffi") == 0) {
+            backend = VariadicAdaptor::LibFFI;
+        } else {
+            log::logger().loreWarning("unknown variadic backend %1", name);
+            return;
+        }
+        if (!VariadicAdaptor::setBackend(backend)) {
+            log::logger().loreWarning("variadic backend %1 is not built in", name);
+        }
+    }
+
+    void HostServer::submitGuestTrace(TraceBuffer *const *buffers, size_t count) {
+        std::lock_guard<std::mutex> lock(m_traceMutex);
+        m_guestTraceBuffers.assign(buffers, buffers + count);
+    }
+
+    void HostServer::writeTrace() {
+        if (m_traceFile.empty()) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(m_traceMutex);
+        auto buffers = m_guestTraceBuffers;
+        const auto hostBuffers = TraceRecorder::buffers();
+        buffers.insert(buffers.end(), hostBuffers.begin(), hostBuffers.end());
+        if (!TraceWriter::write(m_traceFile.c_str(), buffers)) {
+            log::logger().loreWarning("failed to write the trace to %1", m_traceFile);
+        }
+    }
+
+    void HostServer::flushStdio() {
+        std::fflush(nullptr);
+    }
+
+    bool HostServer::isHostAddress(void *addr) {
+        // The index holds the host link map and the host's trampoline tables. Guest objects are
+        // mapped by the emulated loader and are not in the host link map, so a hit means the address
+        // is host-side (the mirror of the guest-side check, where the index holds the guest's).
+        return AddressRangeIndex::instance().contains(addr);
     }
 
     void HostServer::reenter(ReentryArguments *ra) {
+        // The guest records the reentry's span. Here it only ends the host's current segment.
+        TraceRecorder::instant(TE_Reentry, ra->conv);
+        if (inLeafInvocation) {
+            log::logger().loreFatal("a leaf or deferred proc reentered the guest (conv %1)",
+                                    ra->conv);
+        }
+        // The guest runs again before the host call completes, so write what it printed so far.
+        instance()->flushStdioIfNeeded();
         utils::Invocation::reenter(ra);
     }
 
@@ -199,7 +473,8 @@ namespace lore::utils {
         // the concrete protocol layout that carries the per-convention argument boxes.
         const auto ia1 = static_cast<const lore::InvocationArguments *>(ia);
         switch (ia1->conv) {
-            case CC_Standard: {
+            case CC_Standard:
+            case CC_Leaf: {
                 using Func = void (*)(void ** /*args*/, void * /*ret*/, void * /*metadata*/);
 
                 auto func = reinterpret_cast<Func>(ia1->standard.proc);
@@ -207,6 +482,12 @@ namespace lore::utils {
                 return 0;
             }
 
+            case CC_Register:
+            case CC_RegisterLeaf: {
+                lore::mod::invokeRegister(ia1);
+                return 0;
+            }
+
             case CC_StandardCallback: {
                 using Func = void (*)(void * /*callback*/, void ** /*args*/, void * /*ret*/,
                                       void * /*metadata*/);
@@ -250,6 +531,7 @@ extern "C" LOREHOSTRT_EXPORT void LoreCommonHostEntry(void *secondaryId, void *p
     using namespace lore::utils;
 
     const auto id = static_cast<DLCallSecondaryID>(reinterpret_cast<uintptr_t>(secondaryId));
+    LORE_PROBE(host_entry, int(id));
     switch (id) {
         // payload: { const InvocationArguments *ia, ReentryArguments **outRa, int *outRet }.
         // outRet receives 1 if the host needs a guest reentry before finishing (outRa then points
@@ -260,13 +542,36 @@ extern "C" LOREHOSTRT_EXPORT void LoreCommonHostEntry(void *secondaryId, void *p
             auto ra_ptr = reinterpret_cast<ReentryArguments **>(a[1]);
             auto ret = reinterpret_cast<int *>(a[2]);
             assert(ia && ra_ptr && ret);
-            *ret = static_cast<int>(Invocation::invoke(ia, reinterpret_cast<void **>(ra_ptr)));
-            // A host function may have written to a host stdio stream. qemu tears the process down on
-            // guest exit without running the host libc atexit handlers, so a fully-buffered stream
-            // (output redirected or piped) would be lost. Flush at each completed invocation, a point
-            // reached before exit.
+            // Every convention's operands start with the proc.
+            LORE_PROBE(host_invoke, ia->standard.proc, ia->conv);
+            TraceRecorder::begin(TE_Invoke, reinterpret_cast<uintptr_t>(ia->standard.proc));
+            const bool stats = CrossingStats::enabled();
+            if (stats) {
+                CrossingStats::instance().begin(ia->standard.proc);
+            }
+            if (ia->conv == CC_Leaf) {
+                // A leaf never reenters, so it completes here without a coroutine switch.
+                invokeLeaf(ia->standard.proc, ia->standard.args, ia->standard.ret,
+                           ia->standard.metadata);
+                *ret = 0;
+            } else if (ia->conv == CC_RegisterLeaf) {
+                invokeRegisterLeaf(ia);
+                *ret = 0;
+            } else {
+                *ret = static_cast<int>(Invocation::invoke(ia, reinterpret_cast<void **>(ra_ptr)));
+            }
+            if (stats && *ret == 1) {
+                CrossingStats::instance().pause();
+            } else if (stats) {
+                CrossingStats::instance().end();
+            }
+            TraceRecorder::end(TE_Invoke);
+            LORE_PROBE(host_invoke_return, ia->standard.proc, ia->conv, *ret);
+            // A host function may have written to a host stdio stream, which a fully-buffered stream
+            // (output redirected or piped) would hold until exit. Flush it per the configured policy
+            // once the invocation completes, and fully at guest exit (DS_FlushStdio).
             if (*ret == 0) {
-                std::fflush(nullptr);
+                HostServer::instance()->flushStdioIfNeeded();
             }
             break;
         }
@@ -276,9 +581,21 @@ extern "C" LOREHOSTRT_EXPORT void LoreCommonHostEntry(void *secondaryId, void *p
         case DS_ResumeFunction: {
             auto ret = reinterpret_cast<int *>(payload);
             assert(ret);
+            TraceRecorder::begin(TE_Resume);
+            const bool stats = CrossingStats::enabled();
+            if (stats) {
+                CrossingStats::instance().resume();
+            }
             *ret = static_cast<int>(Invocation::resume());
+            if (stats && *ret == 1) {
+                CrossingStats::instance().pause();
+            } else if (stats) {
+                CrossingStats::instance().end();
+            }
+            TraceRecorder::end(TE_Resume);
+            LORE_PROBE(host_resume_return, *ret);
             if (*ret == 0) {
-                std::fflush(nullptr);
+                HostServer::instance()->flushStdioIfNeeded();
             }
             break;
         }
@@ -304,6 +621,44 @@ extern "C" LOREHOSTRT_EXPORT void LoreCommonHostEntry(void *secondaryId, void *p
             break;
         }
 
+        // payload: ResolveSymbolsArguments *, filled in place.
+        case DS_ResolveSymbols: {
+            auto a = reinterpret_cast<ResolveSymbolsArguments *>(payload);
+            assert(a);
+            resolveSymbols(a);
+            break;
+        }
+
+        // payload: CrossingStatsArguments *, filled in place.
+        case DS_GetStats: {
+            auto a = reinterpret_cast<CrossingStatsArguments *>(payload);
+            assert(a);
+            CrossingStats::instance().snapshot(a);
+            break;
+        }
+
+        // payload: TraceSubmitArguments *. The buffers stay valid until the process exits.
+        case DS_TraceSubmit: {
+            auto a = reinterpret_cast<TraceSubmitArguments *>(payload);
+            assert(a);
+            HostServer::instance()->submitGuestTrace(a->buffers, a->count);
+            break;
+        }
+
+        // payload: CallbackElisionArguments *, its installed count filled in place.
+        case DS_ElideCallbacks: {
+            auto a = reinterpret_cast<CallbackElisionArguments *>(payload);
+            assert(a);
+            elideCallbacks(a);
+            break;
+        }
+
+        // payload: unused.
+        case DS_LoaderChanged: {
+            AddressRangeIndex::noteLoaderChange();
+            break;
+        }
+
         // payload: { const char *path, bool isReverse, CThunkInfo *outInfo }.
         case DS_GetThunkInfo: {
             auto a = reinterpret_cast<void **>(payload);
@@ -315,6 +670,73 @@ extern "C" LOREHOSTRT_EXPORT void LoreCommonHostEntry(void *secondaryId, void *p
             break;
         }
 
+        // payload: { const char *buffer, size_t size }. The buffer holds DeferredCallHeader records.
+        case DS_InvokeBatch: {
+            auto a = reinterpret_cast<void **>(payload);
+            assert(a);
+            TraceRecorder::begin(TE_Batch, reinterpret_cast<uintptr_t>(a[1]));
+            invokeBatch(reinterpret_cast<const char *>(a[0]),
+                        static_cast<size_t>(reinterpret_cast<uintptr_t>(a[1])));
+            TraceRecorder::end(TE_Batch);
+            HostServer::instance()->flushStdioIfNeeded();
+            break;
+        }
+
+        // payload: AsyncRing **outRing. outRing receives nullptr when async calls are off.
+        case DS_AsyncAttach: {
+            auto ring = reinterpret_cast<AsyncRing **>(payload);
+            assert(ring);
+            auto pool = HostServer::instance()->asyncWorkerPool();
+            *ring = pool ? pool->attach() : nullptr;
+            break;
+        }
+
+        // payload: AsyncRing *ring, every call of which has completed.
+        case DS_AsyncDetach: {
+            auto ring = reinterpret_cast<AsyncRing *>(payload);
+            assert(ring);
+            HostServer::instance()->asyncWorkerPool()->detach(ring);
+            break;
+        }
+
+        // payload: AsyncRing *ring.
+        case DS_AsyncNotify: {
+            auto ring = reinterpret_cast<AsyncRing *>(payload);
+            assert(ring);
+            HostServer::instance()->asyncWorkerPool()->notify(ring);
+            break;
+        }
+
+        // payload: { AsyncRing *ring, uint32_t seq, int *outRet }. outRet receives 0 once call seq
+        // has completed, or 1 if the running call needs a reentry first (ring->ra points at it).
+        case DS_AsyncWait: {
+            auto a = reinterpret_cast<void **>(payload);
+            assert(a);
+            const auto seq = static_cast<uint32_t>(reinterpret_cast<uintptr_t>(a[1]));
+            *reinterpret_cast<int *>(a[2]) =
+                AsyncWorkerPool::wait(reinterpret_cast<AsyncRing *>(a[0]), seq);
+            break;
+        }
+
+        // payload: AsyncRing *ring, whose pending reentry the guest has serviced.
+        case DS_AsyncResume: {
+            auto ring = reinterpret_cast<AsyncRing *>(payload);
+            assert(ring);
+            AsyncWorkerPool::resume(ring);
+            break;
+        }
+
+        // payload: unused.
+        case DS_FlushStdio: {
+            HostServer::instance()->reportStackStats();
+            HostServer::instance()->reportLockStats();
+            CrossingStats::instance().report();
+            HostServer::instance()->writeTrace();
+            CallRecorder::flush();
+            HostServer::flushStdio();
+            break;
+        }
+
         default:
             break;
     }
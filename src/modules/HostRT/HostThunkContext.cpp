@@ -4,17 +4,25 @@
 
 #include <dlfcn.h>
 
+#include <algorithm>
 #include <cassert>
 #include <cstring>
 #include <map>
 #include <string>
+#include <vector>
 #include <strings.h>
 
 #include <lorelei/Support/Logging.h>
+#include <lorelei/Support/Probes.h>
 #include <lorelei/Support/StringExtras.h>
+#include <lorelei/DLCall/Tools/AddressRangeIndex.h>
+#include <lorelei/DLCall/Tools/FunctionTrampoline.h>
+#include <lorelei/DLCall/Tools/PerfMap.h>
+#include <lorelei/DLCall/Tools/TraceRecorder.h>
 
 #include <NextLibrary.h>
 
+#include "CrossingStats.h"
 #include "HostServer.h"
 #include "LogCategory.h"
 
@@ -63,11 +71,60 @@ namespace lore::mod {
             return name;
         }
 
+        // Name each host proc of a thunk for perf, "<thunk>!<proc>" with its table as a suffix.
+        // Their symbols are local, so the loader rarely knows a size: a proc without one runs up
+        // to the next proc of the thunk, or for at most a page.
+        static void reportProcsToPerf(const std::string &thunkName,
+                                      const thunk::StaticThunkContext *context) {
+            static const char *const kSuffixes[thunk::NumProcKind][thunk::NumProcDirection] = {
+                {"",            " [to guest]"          },
+                {" [callback]", " [callback, to guest]"},
+            };
+
+            struct Proc {
+                const void *addr;
+                std::string name;
+            };
+            std::vector<Proc> procs;
+            for (int kind = thunk::Function; kind < thunk::NumProcKind; ++kind) {
+                for (int dir = thunk::GuestToHost; dir < thunk::NumProcDirection; ++dir) {
+                    const auto &table = context->hostProcs[kind][dir];
+                    for (size_t i = 0; i < table.size; ++i) {
+                        if (table.arr[i].addr) {
+                            procs.push_back({table.arr[i].addr, thunkName + "!" +
+                                                                    table.arr[i].key +
+                                                                    kSuffixes[kind][dir]});
+                        }
+                    }
+                }
+            }
+            std::sort(procs.begin(), procs.end(), [](const Proc &a, const Proc &b) {
+                return a.addr < b.addr;
+            });
+
+            static constexpr size_t kMaxProcSize = 4096;
+            for (size_t i = 0; i < procs.size(); ++i) {
+                size_t limit = kMaxProcSize;
+                if (i + 1 < procs.size()) {
+                    const auto gap = size_t(static_cast<const char *>(procs[i + 1].addr) -
+                                            static_cast<const char *>(procs[i].addr));
+                    limit = std::min(limit, gap);
+                }
+                PerfMap::procLoaded(procs[i].addr, limit, procs[i].name.c_str());
+            }
+        }
+
     }
 
     HostThunkContext::~HostThunkContext() {
+        // The stubs branch into this thunk's code, which is about to go away.
+        FunctionTrampolineArena::instance().releaseOwner(trampolineOwner());
+        if (CrossingStats::enabled() || TraceRecorder::enabled()) {
+            CrossingStats::instance().unregisterThunk(m_staticThunkContext);
+        }
         if (m_hostLibraryHandle) {
             std::ignore = dlclose(m_hostLibraryHandle);
+            AddressRangeIndex::instance().rescan();
         }
     }
 
@@ -85,6 +142,16 @@ namespace lore::mod {
             std::abort();
         }
         const char *modulePath = selfInfo.dli_fname;
+        const auto thunkName = normalizeThunkName(modulePath);
+        LORE_PROBE(thunk_init, thunkName.c_str(), modulePath);
+
+        // Name this thunk's host Entries in the crossing statistics and trace.
+        if (CrossingStats::enabled() || TraceRecorder::enabled()) {
+            CrossingStats::instance().registerThunk(thunkName.c_str(), m_staticThunkContext);
+        }
+        if (PerfMap::enabled()) {
+            reportProcsToPerf(thunkName, m_staticThunkContext);
+        }
 
         // With AUTO_LINK the real library's symbols were folded in at link time, so there is nothing to
         // load or resolve here and no database entry is needed.
@@ -98,7 +165,6 @@ namespace lore::mod {
         assert(server != nullptr);
         const auto *config = server->thunkDatabase();
         assert(config != nullptr);
-        const auto thunkName = normalizeThunkName(modulePath);
 
         std::string next;
         if (const auto *forward = config->forwardThunk(thunkName);
@@ -115,13 +181,19 @@ namespace lore::mod {
             utils::resolveNextLibrary(str::varexp(next, server->thunkVars()), modulePath);
 
         /// STEP: load host library
+        const uint64_t traceArg =
+            TraceRecorder::enabled() ? uint64_t(TraceRecorder::intern(hostLib.c_str())) : 0;
+        TraceRecorder::begin(TE_LoadLibrary, traceArg);
         m_hostLibraryHandle = dlopen(hostLib.c_str(), RTLD_NOW);
+        TraceRecorder::end(TE_LoadLibrary, traceArg);
         if (!m_hostLibraryHandle) {
             const char *err = dlerror();
             log::logger().loreCriticalF("%s: failed to load host library %s (%s)", modulePath,
                          hostLib.c_str(), err ? err : "unknown error");
             std::abort();
         }
+        // Index the real library (and this thunk, loaded just before) as host ranges.
+        AddressRangeIndex::instance().rescan();
 
         /// STEP: resolve host library symbols
         // Resolve host-side real functions used by ProcFn<GuestToHost, Exec>.
@@ -0,0 +1,68 @@
+// SPDX-License-Identifier: MIT
+
+#include <dlfcn.h>
+
+#include <cstdint>
+
+#include <lorelei/DLCall/Protocol.h>
+#include <lorelei/Modules/HostRT/Global.h>
+
+/// The dlcall plugin's half of the bridge, for loopback mode (see
+/// \c GuestClient::startLoopback). The guest runtime, running natively in the same process, loads
+/// this runtime into a link-map namespace of its own and hands each request here instead of
+/// issuing the DLCall syscall: \a id is the \c lore::DLCallRequestID and \a a1 to \a a5 its operands,
+/// laid out as \c GuestClient sends them. The library requests run \c dlopen and friends from this
+/// namespace, so host libraries load next to this runtime, as they load into QEMU.
+extern "C" LOREHOSTRT_EXPORT uint64_t LoreLoopbackEntry(uint64_t id, uint64_t a1, uint64_t a2,
+                                                        uint64_t a3, uint64_t a4, uint64_t a5) {
+    using namespace lore;
+
+    (void) a4;
+    (void) a5;
+
+    switch (static_cast<DLCallRequestID>(id)) {
+        // { const char *key, const char **outValue }. No attributes without an emulator.
+        case DR_GetHostAttribute: {
+            *reinterpret_cast<const char **>(a2) = nullptr;
+            break;
+        }
+
+        // { const char *path, int flags, void **outHandle }.
+        case DR_LoadLibrary: {
+            *reinterpret_cast<void **>(a3) =
+                dlopen(reinterpret_cast<const char *>(a1), static_cast<int>(a2));
+            break;
+        }
+
+        // { void *handle, const char *name, void **outAddr }. A null handle searches the default
+        // scope.
+        case DR_GetProcAddress: {
+            void *handle = a1 ? reinterpret_cast<void *>(a1) : RTLD_DEFAULT;
+            *reinterpret_cast<void **>(a3) = dlsym(handle, reinterpret_cast<const char *>(a2));
+            break;
+        }
+
+        // { void *handle, int *outRet }.
+        case DR_FreeLibrary: {
+            *reinterpret_cast<int *>(a2) = dlclose(reinterpret_cast<void *>(a1));
+            break;
+        }
+
+        // { char **outError }.
+        case DR_GetLibraryError: {
+            *reinterpret_cast<char **>(a1) = dlerror();
+            break;
+        }
+
+        // { void (*proc)(void *, void *), void *op1, void *op2 }: proc(op1, op2).
+        case DR_InvokeProc: {
+            using Func = void (*)(void *, void *);
+            reinterpret_cast<Func>(a1)(reinterpret_cast<void *>(a2), reinterpret_cast<void *>(a3));
+            break;
+        }
+
+        default:
+            return uint64_t(-1);
+    }
+    return 0;
+}
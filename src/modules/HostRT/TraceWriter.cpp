@@ -0,0 +1,168 @@
+// SPDX-License-Identifier: MIT
+
+#include "TraceWriter.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <string>
+
+#include <dlfcn.h>
+#include <unistd.h>
+
+#include "CrossingStats.h"
+
+namespace lore::mod {
+
+    namespace {
+
+        const char *const kindNames[NumTraceEventKind] = {
+            "invoke", "resume", "reentry", "batch", "thread create", "thread exit", "load library",
+        };
+
+        struct EventRef {
+            const TraceBuffer *buffer;
+            const TraceEvent *event;
+        };
+
+        std::string escape(const char *str) {
+            std::string ret;
+            for (const char *p = str; *p; ++p) {
+                const auto c = static_cast<unsigned char>(*p);
+                if (c == '"' || c == '\\') {
+                    ret += '\\';
+                    ret += char(c);
+                } else if (c < 0x20) {
+                    char buf[8];
+                    std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+                    ret += buf;
+                } else {
+                    ret += char(c);
+                }
+            }
+            return ret;
+        }
+
+        // The "name" and "args" of a begin or instant event.
+        void describe(const TraceBuffer &buffer, const TraceEvent &event, std::string *name,
+                      std::string *args) {
+            char buf[64];
+            *name = kindNames[event.kind];
+            switch (event.kind) {
+                case TE_Invoke: {
+                    if (buffer.side == 0) {
+                        std::snprintf(buf, sizeof(buf), "{\"conv\":%" PRIu64 "}", event.arg);
+                        *args = buf;
+                        break;
+                    }
+                    const auto proc = reinterpret_cast<void *>(event.arg);
+                    std::string library;
+                    std::string function;
+                    if (!CrossingStats::instance().procName(proc, &library, &function)) {
+                        // Not a thunk Entry, e.g. the real function of a CC_Format call.
+                        Dl_info info;
+                        if (dladdr(proc, &info) && info.dli_saddr == proc && info.dli_sname) {
+                            function = info.dli_sname;
+                        }
+                    }
+                    if (!function.empty()) {
+                        *name = function;
+                    }
+                    std::snprintf(buf, sizeof(buf), "{\"proc\":\"%p\"", proc);
+                    *args = buf;
+                    if (!library.empty()) {
+                        *args += ",\"library\":\"" + escape(library.c_str()) + "\"";
+                    }
+                    *args += "}";
+                    break;
+                }
+                case TE_Reentry:
+                    std::snprintf(buf, sizeof(buf), "{\"conv\":%" PRIu64 "}", event.arg);
+                    *args = buf;
+                    break;
+                case TE_Batch:
+                    std::snprintf(buf, sizeof(buf), "{\"size\":%" PRIu64 "}", event.arg);
+                    *args = buf;
+                    break;
+                case TE_ThreadCreate:
+                    std::snprintf(buf, sizeof(buf), "{\"start\":\"%p\"}",
+                                  reinterpret_cast<void *>(event.arg));
+                    *args = buf;
+                    break;
+                case TE_LoadLibrary: {
+                    const auto path = reinterpret_cast<const char *>(event.arg);
+                    *args = "{\"path\":\"" + escape(path ? path : "") + "\"}";
+                    break;
+                }
+                default:
+                    *args = "{}";
+                    break;
+            }
+        }
+
+    }
+
+    bool TraceWriter::write(const char *path, const std::vector<TraceBuffer *> &buffers) {
+        FILE *file = std::fopen(path, "w");
+        if (!file) {
+            return false;
+        }
+
+        // Merge the rings by time, dropping each ring's ends left without their begin.
+        std::vector<EventRef> events;
+        for (const auto buffer : buffers) {
+            const uint64_t size = buffer->mask + 1;
+            const uint64_t first = buffer->head > size ? buffer->head - size : 0;
+            int depth = 0;
+            for (uint64_t i = first; i < buffer->head; ++i) {
+                const auto &event = buffer->events[i & buffer->mask];
+                if (event.kind >= NumTraceEventKind) {
+                    continue;
+                }
+                if (event.phase == 'B') {
+                    ++depth;
+                } else if (event.phase == 'E') {
+                    if (depth == 0) {
+                        continue;
+                    }
+                    --depth;
+                }
+                events.push_back({buffer, &event});
+            }
+        }
+        std::stable_sort(events.begin(), events.end(),
+                         [](const EventRef &lhs, const EventRef &rhs) {
+                             return lhs.event->time < rhs.event->time;
+                         });
+
+        const int pid = getpid();
+        std::fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+        std::fprintf(file,
+                     "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":"
+                     "\"lorelei\"}}",
+                     pid);
+        std::string name;
+        std::string args;
+        for (const auto &ref : events) {
+            const auto &event = *ref.event;
+            const char *category = ref.buffer->side == 0 ? "guest" : "host";
+            const double ts = double(event.time) / 1000.0;
+            if (event.phase == 'E') {
+                std::fprintf(file,
+                             ",\n{\"ph\":\"E\",\"cat\":\"%s\",\"pid\":%d,\"tid\":%u,\"ts\":%.3f}",
+                             category, pid, ref.buffer->tid, ts);
+                continue;
+            }
+            describe(*ref.buffer, event, &name, &args);
+            std::fprintf(file,
+                         ",\n{\"name\":\"%s\",\"ph\":\"%c\",%s\"cat\":\"%s\",\"pid\":%d,\"tid\":%u,"
+                         "\"ts\":%.3f,\"args\":%s}",
+                         escape(name.c_str()).c_str(), char(event.phase),
+                         event.phase == 'i' ? "\"s\":\"t\"," : "", category, pid, ref.buffer->tid,
+                         ts, args.c_str());
+        }
+        std::fprintf(file, "\n]}\n");
+        return std::fclose(file) == 0;
+    }
+
+}
@@ -13,6 +13,7 @@
 
 #include <lorelei/Support/Logging.h>
 #include <lorelei/Support/StringExtras.h>
+#include <lorelei/DLCall/Tools/AddressRangeIndex.h>
 
 #include "HostServer.h"
 #include "LogCategory.h"
@@ -76,15 +77,29 @@ namespace lore {
             defaultLogCallback = Logger::logCallback();
             Logger::setLogCallback(logCallback);
 
-            // Probe a qemu plugin symbol in the default scope: its presence confirms we are loaded
-            // inside the patched qemu and gives the host a stable anchor address into the emulator.
-            void *emuAddr = dlsym(RTLD_DEFAULT, "qemu_plugin_register_vcpu_syscall_filter_cb");
-            if (!emuAddr) {
-                log::logger().loreCritical(
-                    "failed to find qemu_plugin_register_vcpu_syscall_filter_cb");
-                exit(1);
+            // In loopback mode (LORELEI_LOOPBACK) the guest runtime loaded us into its own process,
+            // in a namespace apart, and serves as the plugin itself. There is no emulator, so no
+            // anchor address and no numeric split: each side's address index tells them apart.
+            if (const char *loopback = std::getenv("LORELEI_LOOPBACK"); loopback && *loopback) {
+                log::logger().loreDebug("running in loopback mode");
+            } else {
+                // Probe a qemu plugin symbol in the default scope: its presence confirms we are
+                // loaded inside the patched qemu and gives the host a stable anchor address into the
+                // emulator.
+                void *emuAddr =
+                    dlsym(RTLD_DEFAULT, "qemu_plugin_register_vcpu_syscall_filter_cb");
+                if (!emuAddr) {
+                    log::logger().loreCritical(
+                        "failed to find qemu_plugin_register_vcpu_syscall_filter_cb");
+                    exit(1);
+                }
+                mod::HostServer::emuAddr = emuAddr;
+
+                // When every host object other than the emulator lies above emuAddr, the address
+                // index rejects the guest's half numerically. The layout decides, not a build
+                // option.
+                AddressRangeIndex::instance().setPivot(emuAddr, /*localAbove=*/true);
             }
-            mod::HostServer::emuAddr = emuAddr;
 
             // Thunk discovery follows each thunk's own on-disk location: a guest thunk reports its
             // resolved path, and the host derives its host thunk around it (see
@@ -96,6 +111,71 @@ namespace lore {
             }
             const bool autoDiscover = std::getenv("LORELEI_THUNK_NO_AUTODISCOVER") == nullptr;
             server.configureThunkDiscovery(buildConfigVars(), overridePath, kHostArch, autoDiscover);
+
+            // Host stdio written during a crossing is flushed as soon as the crossing completes if the
+            // standard streams hold output, so host and guest output stay in order, and fully at
+            // guest exit. LORELEI_HOST_FLUSH_INTERVAL (milliseconds, default 0) throttles that to at
+            // most one flush per interval. LORELEI_HOST_FLUSH_EVERY_CALL flushes every stream at
+            // every completed invocation instead.
+            int flushInterval = 0;
+            if (const char *intervalStr = std::getenv("LORELEI_HOST_FLUSH_INTERVAL")) {
+                flushInterval = std::atoi(intervalStr);
+            }
+            const bool flushEveryCall = std::getenv("LORELEI_HOST_FLUSH_EVERY_CALL") != nullptr;
+            server.configureStdioFlush(flushEveryCall, flushInterval);
+
+            // Guest async calls run on LORELEI_HOST_ASYNC_WORKERS host threads (default 2, 0 runs
+            // them synchronously). The threads start only once a guest thread posts one.
+            int asyncWorkers = 2;
+            if (const char *workersStr = std::getenv("LORELEI_HOST_ASYNC_WORKERS")) {
+                asyncWorkers = std::atoi(workersStr);
+            }
+            server.configureAsync(asyncWorkers);
+
+            // Each host thread that crosses runs on a coroutine stack of LORELEI_HOST_STACK_SIZE
+            // bytes (default: the pthread stack size), committed only as it is used.
+            // LORELEI_HOST_STACK_STATS logs their footprint and the deepest reentry at guest exit.
+            size_t stackSize = 0;
+            if (const char *sizeStr = std::getenv("LORELEI_HOST_STACK_SIZE")) {
+                stackSize = std::strtoull(sizeStr, nullptr, 0);
+            }
+            const bool stackStats = std::getenv("LORELEI_HOST_STACK_STATS") != nullptr;
+            server.configureStacks(stackSize, stackStats);
+
+            // LORELEI_HOST_STATS counts every crossing per proc: calls, reentries, nesting depth,
+            // and host wall and CPU time histograms. The guest can snapshot them (DS_GetStats), and
+            // they are logged per library and per function at guest exit.
+            server.configureStats(std::getenv("LORELEI_HOST_STATS") != nullptr);
+
+            // LORELEI_LOCK_STATS times every wait at the runtime's lock sites (the thunk database,
+            // the trampoline arena, the address index, ...), logged per site at guest exit. The
+            // guest runtime reads it too, for its own sites.
+            server.configureLockStats(std::getenv("LORELEI_LOCK_STATS") != nullptr);
+
+            // LORELEI_TRACE_FILE records every crossing, reentry, guest thread and library load of
+            // both sides, and writes them there as Chrome trace-event JSON at guest exit. Each
+            // thread keeps its last LORELEI_TRACE_BUFFER_EVENTS events (default 65536).
+            size_t traceEvents = 65536;
+            if (const char *eventsStr = std::getenv("LORELEI_TRACE_BUFFER_EVENTS")) {
+                traceEvents = std::strtoull(eventsStr, nullptr, 0);
+            }
+            server.configureTrace(std::getenv("LORELEI_TRACE_FILE"), traceEvents);
+
+            // LORELEI_PERF_MAP names the trampolines, and with "jitdump" also the thunks' proc
+            // Entries, for Linux perf: "map" appends to /tmp/perf-<pid>.map, "jitdump" writes
+            // jit-<pid>.dump into LORELEI_PERF_MAP_DIR (default: the current directory).
+            server.configurePerfMap(std::getenv("LORELEI_PERF_MAP"),
+                                    std::getenv("LORELEI_PERF_MAP_DIR"));
+
+            // LORELEI_RECORD_FILE records every call the thunks make into a host library, with the
+            // memory its arguments point at and what guest callbacks returned, for LoreReplay to
+            // re-issue against the library alone.
+            server.configureRecord(std::getenv("LORELEI_RECORD_FILE"));
+
+            // LORELEI_VARIADIC_BACKEND picks how printf-style calls are re-issued on the host:
+            // "native" builds va_lists in place where it can (the default), "ffcall" and "libffi"
+            // build every call dynamically with that library.
+            server.configureVariadicBackend(std::getenv("LORELEI_VARIADIC_BACKEND"));
         }
 
         ~HostRuntime() {
@@ -105,7 +185,29 @@ namespace lore {
         }
     };
 
-    LOREHOSTRT_EXPORT HostRuntime runtime_instance;
+    // Destroyed with the library, except in loopback mode: there this namespace is finalized
+    // before the guest runtime's, whose exit work (the trace, the stdio flush) still calls into the
+    // server. The log file is flushed with the other streams at guest exit (DS_FlushStdio) either
+    // way. Constructed in place rather than with new, so runtime_instance is bound before the
+    // constructor logs through it.
+    static struct RuntimeStorage {
+        union {
+            HostRuntime runtime;
+        };
+        bool loopback;
+
+        RuntimeStorage() : runtime() {
+            const char *loopbackStr = std::getenv("LORELEI_LOOPBACK");
+            loopback = loopbackStr && *loopbackStr;
+        }
+        ~RuntimeStorage() {
+            if (!loopback) {
+                runtime.~HostRuntime();
+            }
+        }
+    } runtime_storage;
+
+    LOREHOSTRT_EXPORT HostRuntime &runtime_instance = runtime_storage.runtime;
 
     static void logCallback(int level, const LogContext &ctx, const std::string_view &s) {
         if (level < runtime_instance.level) {
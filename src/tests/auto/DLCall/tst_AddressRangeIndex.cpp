@@ -0,0 +1,138 @@
+// SPDX-License-Identifier: MIT
+
+#include <cstdint>
+#include <cstdlib>
+
+#include <dlfcn.h>
+#include <link.h>
+#include <sys/mman.h>
+
+#include <lorelei/DLCall/Tools/AddressRangeIndex.h>
+#include <lorelei/DLCall/Tools/FunctionTrampoline.h>
+
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+using namespace lore;
+
+BOOST_AUTO_TEST_SUITE(test_AddressRangeIndex)
+
+static int local_function(int a) {
+    return a + 1;
+}
+
+static int global_data = 1;
+
+BOOST_AUTO_TEST_CASE(contains_loaded_objects) {
+    AddressRangeIndex index;
+    index.rescan();
+
+    // This executable and the libraries it links are all in the link map.
+    BOOST_TEST(index.contains((void *) local_function));
+    BOOST_TEST(index.contains(&global_data));
+    BOOST_TEST(index.contains((void *) std::malloc));
+
+    BOOST_TEST(!index.contains(nullptr));
+    int stack_value = 0;
+    BOOST_TEST(!index.contains(&stack_value));
+}
+
+BOOST_AUTO_TEST_CASE(scans_on_first_miss) {
+    // No explicit rescan: the first lookup finds the index never scanned and scans.
+    AddressRangeIndex index;
+    BOOST_TEST(index.contains((void *) local_function));
+}
+
+BOOST_AUTO_TEST_CASE(noted_loader_change_rescans) {
+    AddressRangeIndex index;
+    index.rescan();
+
+    // Load a library this test does not link, and look up its dynamic section.
+    void *handle = nullptr;
+    for (const char *name : {"libz.so.1", "libutil.so.1", "libanl.so.1"}) {
+        if (!dlopen(name, RTLD_NOW | RTLD_NOLOAD) && (handle = dlopen(name, RTLD_NOW))) {
+            break;
+        }
+    }
+    if (!handle) {
+        BOOST_TEST_MESSAGE("no unloaded library to test with");
+        return;
+    }
+    struct link_map *map = nullptr;
+    BOOST_REQUIRE(dlinfo(handle, RTLD_DI_LINKMAP, &map) == 0);
+
+    // Without the split, a miss trusts the noted changes alone.
+    BOOST_TEST(!index.contains(map->l_ld));
+    AddressRangeIndex::noteLoaderChange();
+    BOOST_TEST(index.contains(map->l_ld));
+
+    dlclose(handle);
+}
+
+BOOST_AUTO_TEST_CASE(registered_ranges) {
+    AddressRangeIndex index;
+    index.rescan();
+
+    // Map a page more than is registered, so that the byte past the range is ours too and cannot
+    // belong to an object mapped next to the block.
+    const size_t size = 4096;
+    void *block =
+        mmap(nullptr, 2 * size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    BOOST_REQUIRE(block != MAP_FAILED);
+    auto *bytes = static_cast<char *>(block);
+
+    BOOST_TEST(!index.contains(bytes));
+
+    index.addRange(block, size);
+    BOOST_TEST(index.contains(bytes));
+    BOOST_TEST(index.contains(bytes + size - 1));
+    BOOST_TEST(!index.contains(bytes + size));
+
+    // Registered ranges survive a rescan of the modules.
+    index.rescan();
+    BOOST_TEST(index.contains(bytes));
+
+    index.removeRange(block);
+    BOOST_TEST(!index.contains(bytes));
+
+    munmap(block, 2 * size);
+}
+
+BOOST_AUTO_TEST_CASE(trampoline_tables_are_registered) {
+    auto *table = FunctionTrampolineTable::create(2, (void *) local_function, 0xABCDEF);
+    void *stub = table->trampoline[1].thunk_instr;
+    BOOST_TEST(AddressRangeIndex::instance().contains(stub));
+
+    FunctionTrampolineTable::destroy(table);
+    BOOST_TEST(!AddressRangeIndex::instance().contains(stub));
+}
+
+BOOST_AUTO_TEST_CASE(pivot_split) {
+    AddressRangeIndex index;
+
+    // Every object lies above address 1, so that split holds and the address below answers
+    // without a lookup, while the objects above are still looked up.
+    index.setPivot((void *) 1, true);
+    BOOST_TEST(index.isSplit());
+    BOOST_TEST(!index.contains((void *) 1));
+    BOOST_TEST(index.contains((void *) local_function));
+
+    // No object lies at or below address 1, so the reverse split does not hold.
+    index.setPivot((void *) 1, false);
+    BOOST_TEST(!index.isSplit());
+    BOOST_TEST(index.contains((void *) local_function));
+
+    // A pivot inside this executable ignores the executable itself. The other objects can lie on
+    // one side of it, but not on both.
+    index.setPivot((void *) local_function, true);
+    const bool above = index.isSplit();
+    index.setPivot((void *) local_function, false);
+    const bool below = index.isSplit();
+    BOOST_TEST(!(above && below));
+    BOOST_TEST(index.contains((void *) local_function));
+
+    index.setPivot(nullptr, true);
+    BOOST_TEST(!index.isSplit());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
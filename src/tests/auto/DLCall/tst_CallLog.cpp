@@ -0,0 +1,181 @@
+// SPDX-License-Identifier: MIT
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include <dlfcn.h>
+#include <unistd.h>
+
+#include <lorelei/DLCall/Tools/CallLog.h>
+#include <lorelei/ThunkInterface/Detail/Record.h>
+
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+using namespace lore;
+using namespace lore::thunk;
+
+BOOST_AUTO_TEST_SUITE(test_CallLog)
+
+using StrtolFn = long (*)(const char *, char **, int);
+using QsortFn = void (*)(void *, size_t, size_t, int (*)(const void *, const void *));
+using AbsFn = int (*)(int);
+using StrdupFn = char *(*) (const char *);
+using FreeFn = void (*)(void *);
+using StrncmpFn = int (*)(const char *, const char *, size_t);
+using DlopenFn = void *(*) (const char *, int);
+using DlcloseFn = int (*)(void *);
+using SetenvFn = int (*)(const char *, const char *, int);
+
+static int compareCount = 0;
+
+// Stands in for a guest callback: the Exec layer records what each one returned.
+static int compare(const void *a, const void *b) {
+    const int result = *static_cast<const int *>(a) - *static_cast<const int *>(b);
+    detail::recordCallbackReturn<int>(&result);
+    compareCount++;
+    return result;
+}
+
+template <class Fn>
+static Fn libc(const char *name) {
+    return reinterpret_cast<Fn>(dlsym(RTLD_DEFAULT, name));
+}
+
+BOOST_AUTO_TEST_CASE(signatures) {
+    using Strtol = detail::RecordSignature<StrtolFn, long, const char *, char **, int>;
+    BOOST_TEST(std::string(Strtol::signature) == "L_ppi");
+    BOOST_TEST(std::string(Strtol::roles.data()) == "sm-");
+
+    using Qsort = detail::RecordSignature<QsortFn, void, void *, size_t, size_t,
+                                          int (*)(const void *, const void *)>;
+    BOOST_TEST(std::string(Qsort::signature) == "v_pUUp");
+    BOOST_TEST(std::string(Qsort::roles.data()) == "p--ki");
+
+    // A string followed by a length is a buffer that need not be terminated.
+    using Strncmp = detail::RecordSignature<StrncmpFn, int, const char *, const char *, size_t>;
+    BOOST_TEST(std::string(Strncmp::roles.data()) == "sb-");
+
+    // An integer that is no size_t is a flag, not the length of the string before it.
+    using Dlopen = detail::RecordSignature<DlopenFn, void *, const char *, int>;
+    BOOST_TEST(std::string(Dlopen::roles.data()) == "s-");
+    using Setenv = detail::RecordSignature<SetenvFn, int, const char *, const char *, int>;
+    BOOST_TEST(std::string(Setenv::roles.data()) == "ss-");
+
+    // A variadic function cannot be replayed.
+    using Printf = detail::RecordSignature<int (*)(const char *, ...), int, const char *, double>;
+    BOOST_TEST(std::string(Printf::signature) == "?_pF");
+}
+
+BOOST_AUTO_TEST_CASE(record_and_replay) {
+    const std::string path = "/tmp/tst_CallLog-" + std::to_string(getpid()) + ".log";
+    BOOST_REQUIRE(CallRecorder::start(path.c_str()));
+    BOOST_TEST(CallRecorder::enabled());
+
+    const auto absFn = libc<AbsFn>("abs");
+    const auto strtolFn = libc<StrtolFn>("strtol");
+    const auto qsortFn = libc<QsortFn>("qsort");
+    const auto strdupFn = libc<StrdupFn>("strdup");
+    const auto freeFn = libc<FreeFn>("free");
+    const auto strncmpFn = libc<StrncmpFn>("strncmp");
+    const auto setenvFn = libc<SetenvFn>("setenv");
+    const auto dlopenFn = libc<DlopenFn>("dlopen");
+    const auto dlcloseFn = libc<DlcloseFn>("dlclose");
+
+    int value = -7;
+    const auto absProc = detail::recordProc<AbsFn, int &>((void *) absFn, "abs");
+    BOOST_TEST(detail::recordCall(absProc, absFn, value) == 7);
+
+    const char *text = "123xyz";
+    char *end = nullptr;
+    int base = 10;
+    char **endp = &end;
+    const auto strtolProc =
+        detail::recordProc<StrtolFn, const char *&, char **&, int &>((void *) strtolFn, "strtol");
+    BOOST_TEST(detail::recordCall(strtolProc, strtolFn, text, endp, base) == 123);
+    BOOST_TEST(end == text + 3);
+
+    int values[] = {3, 1, 2};
+    void *array = values;
+    size_t count = 3, size = sizeof(int);
+    int (*cmp)(const void *, const void *) = compare;
+    const auto qsortProc = detail::recordProc<QsortFn, void *&, size_t &, size_t &, decltype(cmp) &>(
+        (void *) qsortFn, "qsort");
+    detail::recordCall(qsortProc, qsortFn, array, count, size, cmp);
+    BOOST_TEST(values[0] == 1);
+    BOOST_TEST(compareCount > 0);
+
+    // A returned pointer passed back: the replay must free its own copy.
+    const char *str = "abc";
+    const auto strdupProc = detail::recordProc<StrdupFn, const char *&>((void *) strdupFn, "strdup");
+    void *copy = detail::recordCall(strdupProc, strdupFn, str);
+    const auto freeProc = detail::recordProc<FreeFn, void *&>((void *) freeFn, "free");
+    detail::recordCall(freeProc, freeFn, copy);
+
+    // Only the counted bytes of an unterminated buffer are recorded.
+    const char *word = "xyzw";
+    const char buffer[] = {'x', 'y', 'z'};
+    const char *bufferp = buffer;
+    size_t length = sizeof(buffer);
+    const auto strncmpProc = detail::recordProc<StrncmpFn, const char *&, const char *&, size_t &>(
+        (void *) strncmpFn, "strncmp");
+    BOOST_TEST(detail::recordCall(strncmpProc, strncmpFn, word, bufferp, length) == 0);
+
+    // A string followed by a flag is recorded whole, whatever the flag. The replay must pass those
+    // bytes, not the memory the recording pointed at, which is changed below.
+    char name[] = "LORE_TST_CALLLOG";
+    char envValue[] = "recorded";
+    const char *namep = name;
+    const char *valuep = envValue;
+    int overwrite = 0;
+    unsetenv(name);
+    const auto setenvProc = detail::recordProc<SetenvFn, const char *&, const char *&, int &>(
+        (void *) setenvFn, "setenv");
+    BOOST_TEST(detail::recordCall(setenvProc, setenvFn, namep, valuep, overwrite) == 0);
+
+    char library[] = "libm.so.6";
+    const char *libraryp = library;
+    int mode = RTLD_NOW;
+    const auto dlopenProc =
+        detail::recordProc<DlopenFn, const char *&, int &>((void *) dlopenFn, "dlopen");
+    void *handle = detail::recordCall(dlopenProc, dlopenFn, libraryp, mode);
+    BOOST_REQUIRE(handle);
+    const auto dlcloseProc = detail::recordProc<DlcloseFn, void *&>((void *) dlcloseFn, "dlclose");
+    BOOST_TEST(detail::recordCall(dlcloseProc, dlcloseFn, handle) == 0);
+
+    CallRecorder::flush();
+    std::strcpy(envValue, "mutated!");
+    std::strcpy(library, "libnone.");
+    unsetenv(name);
+
+    CallReplayer replayer;
+    BOOST_REQUIRE(replayer.load(path.c_str()));
+    std::remove(path.c_str());
+
+    BOOST_REQUIRE(replayer.procs().size() == 9u);
+    BOOST_TEST(replayer.callCount() == 9u);
+    BOOST_TEST(replayer.procs()[1].name == "strtol");
+    BOOST_TEST(replayer.procs()[1].signature == "L_ppi");
+    BOOST_TEST(replayer.procs()[6].argRoles == "ss-");
+    BOOST_TEST(replayer.procs()[7].argRoles == "s-");
+    BOOST_TEST(replayer.resolve() == 9u);
+
+    BOOST_TEST(replayer.replay() == 9u);
+    for (const auto &proc : replayer.procs()) {
+        BOOST_TEST(proc.calls == 1u);
+        BOOST_TEST(proc.mismatches == 0u);
+    }
+    const char *replayed = std::getenv(name);
+    BOOST_TEST((replayed && std::string(replayed) == "recorded"));
+    unsetenv(name);
+    // The comparator stub answered as the comparator did, so qsort compared as often.
+    BOOST_TEST(replayer.callbacksServed() == uint64_t(compareCount));
+
+    // A skipped function is left out.
+    replayer.skipProc("abs");
+    BOOST_TEST(replayer.replay() == 8u);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,128 @@
+// SPDX-License-Identifier: MIT
+
+#include <cstring>
+#include <string>
+
+#include <lorelei/DLCall/Tools/CallbackElision.h>
+#include <lorelei/ThunkInterface/Detail/Callback.h>
+
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+using namespace lore;
+
+BOOST_AUTO_TEST_SUITE(test_CallbackElision)
+
+static bool hasRule(const std::vector<CallbackElision::Rule> &rules, const char *name) {
+    for (const auto &rule : rules) {
+        if (rule.name == name) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static int guest_compare(const void *, const void *) {
+    return 0;
+}
+
+static int host_compare(const void *a, const void *b) {
+    return std::strcmp(static_cast<const char *>(a), static_cast<const char *>(b));
+}
+
+static void *trampoline(void *) {
+    return (void *) 1;
+}
+
+BOOST_AUTO_TEST_CASE(default_table) {
+    const auto rules = CallbackElision::parse(nullptr);
+    BOOST_TEST(hasRule(rules, "strcmp"));
+    BOOST_TEST(hasRule(rules, "memcpy"));
+    // The allocators are opt-in.
+    BOOST_TEST(!hasRule(rules, "malloc"));
+    BOOST_TEST(!hasRule(rules, "free"));
+    // The locale-dependent comparisons are left out.
+    BOOST_TEST(!hasRule(rules, "strcoll"));
+    BOOST_TEST(!hasRule(rules, "strcasecmp"));
+
+    BOOST_TEST(CallbackElision::parse("strict").empty());
+    BOOST_TEST(CallbackElision::parse("0").empty());
+    BOOST_TEST(CallbackElision::parse("1").size() == rules.size());
+}
+
+BOOST_AUTO_TEST_CASE(parse_items) {
+    std::vector<std::string> bad;
+    const auto rules =
+        CallbackElision::parse("alloc,-strcmp,my_cmp:i_pp=strcmp,my_len:U_p,x,y:i_p?", &bad);
+    BOOST_TEST(hasRule(rules, "malloc"));
+    BOOST_TEST(hasRule(rules, "free"));
+    BOOST_TEST(!hasRule(rules, "strcmp"));
+    BOOST_TEST(hasRule(rules, "strncmp"));
+
+    for (const auto &rule : rules) {
+        if (rule.name == "my_cmp") {
+            BOOST_TEST(rule.signature == "i_pp");
+            BOOST_TEST(rule.hostName == "strcmp");
+        } else if (rule.name == "my_len") {
+            BOOST_TEST(rule.signature == "U_p");
+            BOOST_TEST(rule.hostName == "my_len");
+        }
+    }
+    BOOST_TEST(hasRule(rules, "my_cmp"));
+    BOOST_TEST(hasRule(rules, "my_len"));
+
+    BOOST_REQUIRE(bad.size() == 2);
+    BOOST_TEST(bad[0] == "x");
+    BOOST_TEST(bad[1] == "y:i_p?");
+}
+
+BOOST_AUTO_TEST_CASE(lookup_matches_signature) {
+    CallbackElision::clear();
+    BOOST_TEST(!CallbackElision::enabled());
+    BOOST_TEST(!CallbackElision::lookup((void *) guest_compare, "i_pp"));
+
+    CallbackElision::install((void *) guest_compare, (void *) host_compare, "i_pp");
+    BOOST_TEST(CallbackElision::enabled());
+    BOOST_TEST(CallbackElision::lookup((void *) guest_compare, "i_pp") == (void *) host_compare);
+    // Passed where another signature is expected, it still crosses.
+    BOOST_TEST(!CallbackElision::lookup((void *) guest_compare, "i_ppU"));
+    BOOST_TEST(!CallbackElision::lookup((void *) host_compare, "i_pp"));
+
+    CallbackElision::clear();
+    BOOST_TEST(!CallbackElision::lookup((void *) guest_compare, "i_pp"));
+}
+
+BOOST_AUTO_TEST_CASE(format_signature) {
+    using namespace thunk::detail;
+    BOOST_TEST(std::string(FormatSignature<int (*)(const void *, const void *)>::value) == "i_pp");
+    BOOST_TEST(std::string(FormatSignature<size_t (*)(const char *)>::value) == "U_p");
+    BOOST_TEST(std::string(FormatSignature<void (*)(void *, int, double)>::value) == "v_piF");
+    BOOST_TEST(std::string(FormatSignature<int (*)(const char *, ...)>::value) == "?");
+}
+
+BOOST_AUTO_TEST_CASE(context_uses_native_function) {
+    using Compare = int (*)(const void *, const void *);
+    const auto allocator = [](void *input) {
+        return (Compare) trampoline(input);
+    };
+
+    CallbackElision::clear();
+    CallbackElision::install((void *) guest_compare, (void *) host_compare, "i_pp");
+
+    void *fp = (void *) guest_compare;
+    thunk::CallbackContext ctx;
+    ctx.init<true>(fp, +allocator);
+    BOOST_TEST(fp == (void *) host_compare);
+    ctx.fini();
+    BOOST_TEST(fp == (void *) guest_compare);
+
+    // Strict: a trampoline as before.
+    CallbackElision::clear();
+    thunk::CallbackContext strict;
+    strict.init<true>(fp, +allocator);
+    BOOST_TEST(fp == (void *) 1);
+    strict.fini();
+    BOOST_TEST(fp == (void *) guest_compare);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
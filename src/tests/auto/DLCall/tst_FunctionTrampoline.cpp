@@ -1,6 +1,7 @@
 // SPDX-License-Identifier: MIT
 
 #include <cstdint>
+#include <thread>
 
 #include <lorelei/DLCall/Tools/FunctionTrampoline.h>
 #include <lorelei/ThunkInterface/Detail/Callback.h>
@@ -168,4 +169,74 @@ BOOST_AUTO_TEST_CASE(forwards_register_and_stack_arguments_and_return) {
     BOOST_TEST(stub_fp(3, 4) == 0.75);
 }
 
+// The arena grows past one slab, keeps one stub per distinct callback, and reuses released ones.
+BOOST_AUTO_TEST_CASE(arena_grows_and_reclaims) {
+    FunctionTrampolineArena arena;
+    constexpr uintptr_t kMagic = thunk::kTrampolineMagic;
+    constexpr int kCount = 200;
+
+    // Distinct saved_function values. Only the first two are ever called.
+    void *stubs[kCount];
+    for (int i = 0; i < kCount; ++i) {
+        void *function = i == 0 ? (void *) add : i == 1 ? (void *) mul : (void *) uintptr_t(0x1000 + i);
+        stubs[i] = arena.acquire((void *) operator_thunk, function, nullptr, kMagic);
+        BOOST_REQUIRE(stubs[i] != nullptr);
+    }
+    BOOST_TEST(arena.acquire((void *) operator_thunk, (void *) mul, nullptr, kMagic) == stubs[1]);
+    BOOST_TEST(((Operator) stubs[0])(3, 4) == 7);
+    BOOST_TEST(((Operator) stubs[1])(3, 4) == 12);
+    BOOST_TEST(thunk::unwrapTrampoline(stubs[kCount - 1]) == (void *) (0x1000 + kCount - 1));
+
+    auto stats = arena.stats();
+    BOOST_TEST(stats.slabs > 1u);
+    BOOST_TEST(stats.live == size_t(kCount));
+    BOOST_TEST(stats.capacity >= stats.live);
+
+    // A released stub no longer unwraps, and its slot serves the next request.
+    const uint64_t epoch = arena.epoch();
+    arena.release(stubs[5]);
+    BOOST_TEST(arena.epoch() != epoch);
+    BOOST_TEST(thunk::unwrapTrampoline(stubs[5]) == stubs[5]);
+    void *reused = arena.acquire((void *) operator_thunk, (void *) add, &stats, kMagic);
+    BOOST_TEST(reused == stubs[5]);
+    BOOST_TEST(((Operator) reused)(3, 4) == 7);
+
+    // Releasing by owner only touches that owner's stubs.
+    BOOST_TEST(arena.releaseOwner(&stats) == 1u);
+    stats = arena.stats();
+    BOOST_TEST(stats.live == size_t(kCount - 1));
+    BOOST_TEST(stats.peak == size_t(kCount));
+    BOOST_TEST(stats.released == 2u);
+    BOOST_TEST(((Operator) stubs[0])(3, 4) == 7);
+}
+
+struct OwnedContext {};
+
+// Stubs handed out by allocCallbackTrampoline come from the shared arena, so other threads get the
+// same stub, and a context's stubs go away together.
+BOOST_AUTO_TEST_CASE(alloc_shares_across_threads_and_releases_by_context) {
+    using namespace lore::thunk;
+
+    auto s_add = allocCallbackTrampoline<operator_thunk, OwnedContext>((void *) add);
+    decltype(s_add) s_other = nullptr;
+    std::thread([&]() {
+        s_other = allocCallbackTrampoline<operator_thunk, OwnedContext>((void *) add);
+    }).join();
+    BOOST_TEST(s_add == s_other);
+    BOOST_TEST(s_add(3, 4) == 7);
+
+    // The default context owns a separate stub, which outlives the owned one.
+    auto s_global = allocCallbackTrampoline<operator_thunk>((void *) add);
+    BOOST_TEST(s_global != s_add);
+
+    BOOST_TEST(releaseCallbackTrampolines<OwnedContext>() == 1u);
+    BOOST_TEST(unwrapTrampoline((void *) s_add) == (void *) s_add);
+    BOOST_TEST(s_global(3, 4) == 7);
+
+    // A new request after the release gets a working stub again.
+    auto s_again = allocCallbackTrampoline<operator_thunk, OwnedContext>((void *) add);
+    BOOST_TEST(s_again(3, 4) == 7);
+    releaseCallbackTrampoline((void *) s_again);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
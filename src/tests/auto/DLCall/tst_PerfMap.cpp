@@ -0,0 +1,130 @@
+// SPDX-License-Identifier: MIT
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include <dlfcn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <lorelei/DLCall/Tools/FunctionTrampoline.h>
+#include <lorelei/DLCall/Tools/PerfMap.h>
+
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+using namespace lore;
+
+BOOST_AUTO_TEST_SUITE(test_PerfMap)
+
+static int handler(int a) {
+    return a;
+}
+
+static int callback(int a) {
+    return a + 1;
+}
+
+static std::string hex(const void *addr) {
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%lx", (unsigned long) addr);
+    return buf;
+}
+
+static std::string readFile(const std::string &path) {
+    std::ifstream in(path, std::ios::binary);
+    std::stringstream ss;
+    ss << in.rdbuf();
+    return ss.str();
+}
+
+BOOST_AUTO_TEST_CASE(symbol_names) {
+    // An exported function of LoreDLCall is named, demangled.
+    void *addr = dlsym(RTLD_DEFAULT, "_ZN4lore7PerfMap5startENS0_6FormatEPKc");
+    BOOST_REQUIRE(addr != nullptr);
+    BOOST_TEST(PerfMap::symbolName(addr) ==
+               "lore::PerfMap::start(lore::PerfMap::Format, char const*)");
+
+    // An address the loader has no symbol for is given in hex.
+    BOOST_TEST(PerfMap::symbolName((void *) handler) == "0x" + hex((void *) handler));
+}
+
+BOOST_AUTO_TEST_CASE(map_names_trampolines) {
+    // A format per process, so the map is written by a child.
+    const pid_t pid = fork();
+    BOOST_REQUIRE(pid >= 0);
+    if (pid == 0) {
+        if (!PerfMap::start(PerfMap::Map)) {
+            _exit(1);
+        }
+        FunctionTrampolineArena arena;
+        void *stub = arena.acquire((void *) handler, (void *) callback, nullptr, 1);
+        // Hand the stub address back in a file.
+        std::ofstream(std::string("/tmp/tst_PerfMap-") + std::to_string(getpid())) << hex(stub);
+        _exit(0);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    BOOST_REQUIRE(WIFEXITED(status));
+    BOOST_REQUIRE(WEXITSTATUS(status) == 0);
+
+    const auto stubPath = std::string("/tmp/tst_PerfMap-") + std::to_string(pid);
+    const auto mapPath = std::string("/tmp/perf-") + std::to_string(pid) + ".map";
+    const auto stub = readFile(stubPath);
+    const auto map = readFile(mapPath);
+    std::remove(stubPath.c_str());
+    std::remove(mapPath.c_str());
+
+    const auto expected = stub + " " + hex((void *) sizeof(FunctionTrampoline::thunk_instr)) +
+                          " lore_tramp 0x" + hex((void *) handler) + " [0x" +
+                          hex((void *) callback) + "]\n";
+    BOOST_TEST(map == expected);
+}
+
+BOOST_AUTO_TEST_CASE(jitdump_records_code) {
+    char dir[] = "/tmp/tst_PerfMap-XXXXXX";
+    BOOST_REQUIRE(mkdtemp(dir) != nullptr);
+    BOOST_REQUIRE(PerfMap::start(PerfMap::JitDump, dir));
+    BOOST_TEST(PerfMap::enabled());
+
+    static const unsigned char code[] = {0x90, 0x90, 0xC3};
+    PerfMap::codeLoaded(code, sizeof(code), "some_code");
+    PerfMap::procLoaded(nullptr, 16, "ignored");
+
+    const auto path = std::string(dir) + "/jit-" + std::to_string(getpid()) + ".dump";
+    const auto dump = readFile(path);
+    std::remove(path.c_str());
+    rmdir(dir);
+
+    // The file header: magic, version, header size.
+    BOOST_REQUIRE(dump.size() >= 40);
+    uint32_t header[3];
+    std::memcpy(header, dump.data(), sizeof(header));
+    BOOST_TEST(header[0] == 0x4A695444u);
+    BOOST_TEST(header[1] == 1u);
+    BOOST_TEST(header[2] == 40u);
+
+    // One JIT_CODE_LOAD record: its header, pid, tid, vma, code address, size and index, then the
+    // name and the code.
+    const char *record = dump.data() + 40;
+    uint32_t id, size;
+    uint64_t vma, codeSize;
+    std::memcpy(&id, record, 4);
+    std::memcpy(&size, record + 4, 4);
+    std::memcpy(&vma, record + 24, 8);
+    std::memcpy(&codeSize, record + 40, 8);
+    BOOST_TEST(id == 0u);
+    BOOST_TEST(size == 56 + sizeof("some_code") + sizeof(code));
+    BOOST_TEST(dump.size() == 40 + size);
+    BOOST_TEST(vma == uint64_t(uintptr_t(code)));
+    BOOST_TEST(codeSize == sizeof(code));
+    BOOST_TEST(std::strcmp(record + 56, "some_code") == 0);
+    BOOST_TEST(std::memcmp(record + 56 + sizeof("some_code"), code, sizeof(code)) == 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,106 @@
+// SPDX-License-Identifier: MIT
+
+#include <cstring>
+#include <thread>
+
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <lorelei/DLCall/Tools/TraceRecorder.h>
+
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+using namespace lore;
+
+BOOST_AUTO_TEST_SUITE(test_TraceRecorder)
+
+// Recording cannot be stopped once started, so this runs first.
+BOOST_AUTO_TEST_CASE(disabled_records_nothing) {
+    TraceRecorder::begin(TE_Invoke);
+    TraceRecorder::end(TE_Invoke);
+    BOOST_TEST(!TraceRecorder::enabled());
+    BOOST_TEST(TraceRecorder::buffers().empty());
+}
+
+// Starts the recorder, so that each case runs on its own too. A ring outlives the case that
+// allocated it, so the cases look up their thread's ring and count from its current head.
+struct RecorderFixture {
+    RecorderFixture() {
+        TraceRecorder::start(1, 1024);
+    }
+
+    // The ring of the calling thread, allocated by its first event.
+    static TraceBuffer *threadRing() {
+        TraceRecorder::instant(TE_Batch);
+        for (auto buffer : TraceRecorder::buffers()) {
+            if (buffer->tid == uint32_t(syscall(SYS_gettid))) {
+                return buffer;
+            }
+        }
+        return nullptr;
+    }
+};
+
+BOOST_FIXTURE_TEST_CASE(records_events_in_order, RecorderFixture) {
+    BOOST_TEST(TraceRecorder::enabled());
+    const auto buffer = threadRing();
+    BOOST_REQUIRE(buffer);
+    BOOST_TEST(buffer->side == 1u);
+    const uint64_t head = buffer->head;
+
+    TraceRecorder::begin(TE_Invoke, 42);
+    TraceRecorder::instant(TE_Reentry, 3);
+    TraceRecorder::end(TE_Invoke);
+    BOOST_REQUIRE(buffer->head == head + 3);
+
+    const auto event = [buffer, head](uint64_t i) -> const TraceEvent & {
+        return buffer->events[(head + i) & buffer->mask];
+    };
+    BOOST_TEST(event(0).kind == uint32_t(TE_Invoke));
+    BOOST_TEST(event(0).phase == uint32_t('B'));
+    BOOST_TEST(event(0).arg == 42u);
+    BOOST_TEST(event(1).kind == uint32_t(TE_Reentry));
+    BOOST_TEST(event(1).phase == uint32_t('i'));
+    BOOST_TEST(event(2).phase == uint32_t('E'));
+    BOOST_TEST(event(0).time <= event(1).time);
+    BOOST_TEST(event(1).time <= event(2).time);
+}
+
+BOOST_FIXTURE_TEST_CASE(ring_keeps_the_latest_events, RecorderFixture) {
+    const auto buffer = threadRing();
+    BOOST_REQUIRE(buffer);
+    const uint64_t size = buffer->mask + 1;
+    const uint64_t head = buffer->head;
+    for (uint64_t i = 0; i < size + 10; ++i) {
+        TraceRecorder::instant(TE_Batch, i);
+    }
+    BOOST_TEST(buffer->head == head + size + 10);
+    BOOST_TEST(buffer->events[(buffer->head - 1) & buffer->mask].arg == size + 9);
+}
+
+BOOST_FIXTURE_TEST_CASE(threads_get_their_own_rings, RecorderFixture) {
+    const auto mainBuffer = threadRing();
+    const auto before = TraceRecorder::buffers();
+    std::thread([]() {
+        TraceRecorder::instant(TE_ThreadExit);
+    }).join();
+
+    // The ring outlives its thread.
+    const auto buffers = TraceRecorder::buffers();
+    BOOST_REQUIRE(buffers.size() == before.size() + 1);
+    const auto buffer = buffers.back();
+    BOOST_TEST(buffer->tid != mainBuffer->tid);
+    BOOST_TEST(buffer->head == 1u);
+    BOOST_TEST(buffer->events[0].kind == uint32_t(TE_ThreadExit));
+}
+
+BOOST_AUTO_TEST_CASE(intern_keeps_strings) {
+    char path[] = "/usr/lib/libfoo.so";
+    const char *a = TraceRecorder::intern(path);
+    std::strcpy(path, "changed");
+    BOOST_TEST(std::strcmp(a, "/usr/lib/libfoo.so") == 0);
+    BOOST_TEST(TraceRecorder::intern("/usr/lib/libfoo.so") == a);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -2,6 +2,7 @@
 
 #include <cstdio>
 #include <cstdint>
+#include <string>
 #include <string_view>
 
 #include <lorelei/DLCall/Tools/VariadicAdaptor.h>
@@ -180,6 +181,47 @@ BOOST_AUTO_TEST_CASE(test_callFormatBox64) {
     BOOST_TEST(box64_effect == 35);
 }
 
+static void *box64_pick(void *a, int b, unsigned long long c) {
+    return static_cast<char *>(a) + b + c;
+}
+
+static double box64_scale(double x, double y) {
+    return x * y;
+}
+
+BOOST_AUTO_TEST_CASE(test_callFormatBox64_typed) {
+    // Common formats have a compiled invoker; the others, and anything past 8 characters, go
+    // through ffcall.
+    BOOST_TEST(VariadicAdaptor::findFormatInvoker("v_p") != nullptr);
+    BOOST_TEST(VariadicAdaptor::findFormatInvoker("i_pp") != nullptr);
+    BOOST_TEST(VariadicAdaptor::findFormatInvoker("F_FF") != nullptr);
+    BOOST_TEST(VariadicAdaptor::findFormatInvoker("U_iuLfFp") == nullptr);
+    BOOST_TEST(VariadicAdaptor::findFormatInvoker("v_pppppppp") == nullptr);
+    BOOST_TEST(VariadicAdaptor::findFormatInvoker("v_") != nullptr);
+
+    char buffer[64];
+    void *p = buffer;
+    int b = 3;
+    unsigned long long c = 5;
+    void *pick_args[] = {&p, &b, &c};
+    void *picked = nullptr;
+    VariadicAdaptor::callFormatBox64(reinterpret_cast<void *>(box64_pick), "p_piU", pick_args,
+                                     &picked);
+    BOOST_TEST(picked == buffer + 8);
+
+    double x = 1.5;
+    double y = 4.0;
+    void *scale_args[] = {&x, &y};
+    double scaled = 0;
+    VariadicAdaptor::callFormatBox64(reinterpret_cast<void *>(box64_scale), "F_FF", scale_args,
+                                     &scaled);
+    BOOST_TEST(scaled == 6.0);
+
+    // A null ret discards the result.
+    VariadicAdaptor::callFormatBox64(reinterpret_cast<void *>(box64_scale), "F_FF", scale_args,
+                                     nullptr);
+}
+
 BOOST_AUTO_TEST_CASE(test_printf_floating) {
     // Several floating-point values back to back. On ABIs where variadic FP shares the integer
     // argument area (riscv64), a half-width or wrongly-placed float misaligns everything after it.
@@ -222,6 +264,31 @@ BOOST_AUTO_TEST_CASE(test_printf_all_kinds) {
                  2.71828, "mixed", (void *) 0xABCD, 0xFF);
 }
 
+BOOST_AUTO_TEST_CASE(test_printf_widths_and_lengths) {
+    CHECK_PRINTF("%*d|%-*s|%.*f|%%", 6, 42, 8, "left", 3, 2.71828);
+    CHECK_PRINTF("%zu %zd %td %jd %hd %hhu", sizeof(int), ptrdiff_t(-3), ptrdiff_t(4),
+                 intmax_t(-5), short(-6), 250);
+    CHECK_PRINTF("%#x %+d % d %05d", 255, 7, 8, 9);
+}
+
+// A width on %% takes no argument. -Wformat rejects it in a literal, so the format is built here.
+BOOST_AUTO_TEST_CASE(test_printf_width_on_percent) {
+    std::string fmt = "%d|%";
+    fmt += "5%|%d";
+    CHECK_PRINTF(fmt.c_str(), 1, 2);
+}
+
+BOOST_AUTO_TEST_CASE(test_printf_reused_format_buffer) {
+    // Formats are cached by address, so a buffer rewritten with another format must be re-read.
+    char fmt[64];
+    for (int i = 0; i < 3; ++i) {
+        std::snprintf(fmt, sizeof(fmt), "%s", "%d and %s");
+        CHECK_PRINTF(fmt, i, "text");
+        std::snprintf(fmt, sizeof(fmt), "%s", "%f, %lld, %p");
+        CHECK_PRINTF(fmt, 0.25 * i, 1LL << 40, (void *) fmt);
+    }
+}
+
 BOOST_AUTO_TEST_CASE(test_sscanf_mixed) {
     const char *fmt = "%d %f %ld %s %lf";
     const char *input = "42 3.5 1000000 word 2.71828";
@@ -241,4 +308,39 @@ BOOST_AUTO_TEST_CASE(test_sscanf_mixed) {
     BOOST_TEST(a_d == e_d);
 }
 
+static double sum_mixed(int a, double b, long c, float d, char e, double f, unsigned g) {
+    return a + b + c + d + e + f + g;
+}
+
+BOOST_AUTO_TEST_CASE(test_backends) {
+    BOOST_TEST(VariadicAdaptor::backend() == VariadicAdaptor::NativeVaList);
+    for (const auto backend :
+         {VariadicAdaptor::NativeVaList, VariadicAdaptor::FFCall, VariadicAdaptor::LibFFI}) {
+        BOOST_TEST(VariadicAdaptor::setBackend(backend) == VariadicAdaptor::hasBackend(backend));
+        if (!VariadicAdaptor::hasBackend(backend)) {
+            continue;
+        }
+        BOOST_TEST(VariadicAdaptor::backend() == backend);
+
+        // Twice each: the second call of a signature may take what the first one prepared.
+        for (int i = 0; i < 2; ++i) {
+            CHECK_PRINTF("%d %s %f %lu", -i, "str", 0.5 * i, 7UL);
+            CHECK_PRINTF("%f %d %f %d %f %d %f %d %f %d", 0.5, 1, 1.5, 2, 2.5, 3, 3.5, 4, 4.5, i);
+
+            int a = 1;
+            double b = 2.5;
+            long c = 3;
+            float d = 4.5f;
+            char e = 5;
+            double f = 6.25;
+            unsigned g = 7;
+            void *args[] = {&a, &b, &c, &d, &e, &f, &g};
+            double ret = 0;
+            VariadicAdaptor::callFormatBox64((void *) sum_mixed, "F_iFlfcFI", args, &ret);
+            BOOST_TEST(ret == 29.25);
+        }
+    }
+    VariadicAdaptor::setBackend(VariadicAdaptor::NativeVaList);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
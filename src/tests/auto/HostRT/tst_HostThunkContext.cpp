@@ -0,0 +1,51 @@
+// SPDX-License-Identifier: MIT
+
+#include <lorelei/DLCall/Tools/FunctionTrampoline.h>
+#include <lorelei/Modules/HostRT/HostThunkContext.h>
+#include <lorelei/ThunkInterface/Detail/Callback.h>
+
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+using namespace lore;
+
+BOOST_AUTO_TEST_SUITE(test_HostThunkContext)
+
+static int handler(int a) {
+    return a;
+}
+
+static int first(int a) {
+    return a + 1;
+}
+
+static int second(int a) {
+    return a + 2;
+}
+
+// A thunk's callback stubs belong to its context, so destroying the context (unloading the thunk)
+// frees their slots for the next ones.
+BOOST_AUTO_TEST_CASE(destroyed_context_releases_its_trampolines) {
+    auto &arena = FunctionTrampolineArena::instance();
+    thunk::StaticThunkContext staticContext = {};
+
+    void *stub;
+    const auto before = arena.stats();
+    {
+        mod::HostThunkContext context(&staticContext);
+        stub = arena.acquire((void *) handler, (void *) first, context.trampolineOwner(),
+                             thunk::kTrampolineMagic);
+        BOOST_REQUIRE(stub != nullptr);
+        BOOST_TEST(arena.stats().live == before.live + 1);
+    }
+    BOOST_TEST(arena.stats().live == before.live);
+    BOOST_TEST(arena.stats().released == before.released + 1);
+    BOOST_TEST(thunk::unwrapTrampoline(stub) == stub);
+
+    void *next = arena.acquire((void *) handler, (void *) second, nullptr, thunk::kTrampolineMagic);
+    BOOST_TEST(next == stub);
+    BOOST_TEST(thunk::unwrapTrampoline(next) == (void *) second);
+    arena.release(next);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -27,4 +27,43 @@ namespace lore::thunk {
         _DESC pass::vprintf<2, 3> builder_pass = {};
     };
 
+    // le_mix calls nothing back, so pass::Leaf lets the host run it without a coroutine switch.
+    // le_call_handler, untagged, takes no callback yet runs the one le_set_handler stored: nothing
+    // in a signature tells the two apart, which is why a leaf is never inferred.
+    template <>
+    struct ProcFnDesc<::le_mix> {
+        _DESC pass::PassTagList<pass::Leaf> passes = {};
+    };
+
+    // le_tally and le_tally_reset return nothing and the guest reads their effect only through
+    // le_tally_total, so their calls can wait in the guest's command buffer and cross together.
+    template <>
+    struct ProcFnDesc<::le_tally> {
+        _DESC pass::PassTagList<pass::Deferred> passes = {};
+    };
+
+    template <>
+    struct ProcFnDesc<::le_tally_reset> {
+        _DESC pass::PassTagList<pass::Deferred> passes = {};
+    };
+
+    // le_fill and le_post_handler run on a host worker while the guest goes on. le_post_handler
+    // calls the stored handler, a reentry the thunk routes back to the posting guest thread.
+    template <>
+    struct ProcFnDesc<::le_fill> {
+        _DESC pass::PassTagList<pass::Async> passes = {};
+    };
+
+    template <>
+    struct ProcFnDesc<::le_post_handler> {
+        _DESC pass::PassTagList<pass::Async> passes = {};
+    };
+
+    // le_checksum only reads the buffer it is given, so the guest may run its own copy of it when
+    // that is cheaper than crossing, and it is a leaf when it does cross.
+    template <>
+    struct ProcFnDesc<::le_checksum> {
+        _DESC pass::PassTagList<pass::Adaptive, pass::Leaf> passes = {};
+    };
+
 }
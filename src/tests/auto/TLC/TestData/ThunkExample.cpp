@@ -2,6 +2,7 @@
 
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 
 // Host-side implementation of the example library. Each function just forwards to the real libc
 // routine, so the interesting part is purely the thunk that carries the call across the boundary.
@@ -116,4 +117,38 @@ extern "C" {
         *out = le_stored_handler;
     }
 
+    static int le_total = 0;
+
+    void le_tally(int value) {
+        le_total += value;
+    }
+
+    void le_tally_reset(void) {
+        le_total = 0;
+    }
+
+    int le_tally_total(void) {
+        return le_total;
+    }
+
+    void le_fill(unsigned char *buf, size_t size, unsigned char value) {
+        std::memset(buf, value, size);
+    }
+
+    unsigned long le_checksum(const unsigned char *buf, size_t size) {
+        unsigned long sum = 0;
+        for (size_t i = 0; i < size; ++i) {
+            sum += buf[i];
+        }
+        return sum;
+    }
+
+    void le_post_handler(int x) {
+        le_call_handler(x);
+    }
+
+    double le_sum6(char a, short b, int c, long d, float e, double f) {
+        return a + b + c + d + e + f;
+    }
+
 }
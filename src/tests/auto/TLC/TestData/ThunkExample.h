@@ -18,6 +18,9 @@
 //   le_emit*  / le_vemit*      printf-style functions whose names do not reveal it, covering the
 //                              full matrix of {`...`, va_list} x {has format attribute, none}
 //   le_mix                     a function that takes and returns long double
+//   le_tally / le_tally_reset  void functions whose calls are deferred and sent in a batch
+//   le_fill / le_post_handler  void functions the host runs asynchronously, one calling back
+//   le_sum6                    a function of six scalars, which cross in a packed frame
 
 #ifdef __cplusplus
 extern "C" {
@@ -117,6 +120,32 @@ extern "C" {
     /// the original guest function).
     void le_get_handler(le_handler_fn *out);
 
+    /// Adds \a value to a host-side total. Nothing comes back, so the guest may defer the call and
+    /// send it together with later ones (see pass::Deferred in Desc.h).
+    void le_tally(int value);
+
+    /// Sets the host-side total back to 0. Deferred like le_tally, with no arguments to record.
+    void le_tally_reset(void);
+
+    /// Returns the host-side total. An ordinary call, so every deferred le_tally before it has
+    /// already run on the host.
+    int le_tally_total(void);
+
+    /// Fills \a size bytes at \a buf with \a value. Runs on a host worker while the guest goes on
+    /// (see pass::Async in Desc.h): \a buf is complete by the guest's next ordinary call.
+    void le_fill(unsigned char *buf, size_t size, unsigned char value);
+
+    /// Sums \a size bytes at \a buf. An ordinary call, so a le_fill posted before it has finished.
+    unsigned long le_checksum(const unsigned char *buf, size_t size);
+
+    /// Like le_call_handler, but asynchronous: the stored handler is called from a host worker, and
+    /// the thunk has the guest thread that posted the call run it.
+    void le_post_handler(int x);
+
+    /// Sums its arguments. Six scalars of mixed sizes are too many for CC_Register, so the thunk
+    /// packs them by value into a frame, padding included.
+    double le_sum6(char a, short b, int c, long d, float e, double f);
+
 #ifdef __cplusplus
 }
 #endif
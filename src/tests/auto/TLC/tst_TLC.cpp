@@ -3,6 +3,7 @@
 #include <fstream>
 #include <sstream>
 #include <string>
+#include <utility>
 
 #define BOOST_TEST_MAIN
 #include <boost/test/unit_test.hpp>
@@ -45,6 +46,32 @@ static std::string callerBody(const std::string &src, const std::string &name) {
     return phaseBody(src, name, "Caller");
 }
 
+// Whether the GuestToHost \a phase body of function \a name contains \a needle. The calling
+// convention tests check what TLC emitted this way; tst_Loopback then compiles the same thunk and
+// runs every fixture function through it.
+static bool emits(const std::string &src, const std::string &name, const char *phase,
+                  const std::string &needle) {
+    return phaseBody(src, name, phase).find(needle) != std::string::npos;
+}
+
+// Returns the \a direction \a phase definition body of callback type \a name, or "" if absent.
+static std::string callbackPhaseBody(const std::string &src, const std::string &name,
+                                     const char *direction, const char *phase) {
+    auto key = "ProcCb<" + name + ", " + direction + ", " + phase + ">::";
+    auto pos = src.find(key);
+    if (pos == std::string::npos) {
+        return {};
+    }
+    auto end = src.find("\n}", pos);
+    return src.substr(pos, end == std::string::npos ? std::string::npos : end - pos);
+}
+
+// Like emits(), for the \a direction \a phase body of callback type \a name.
+static bool callbackEmits(const std::string &src, const std::string &name, const char *direction,
+                          const char *phase, const std::string &needle) {
+    return callbackPhaseBody(src, name, direction, phase).find(needle) != std::string::npos;
+}
+
 // Whether function \a name is marshalled through the variadic adaptor (i.e. the format builder
 // picked it up). The host emits the adaptor call in the Caller, and the guest emits it in the Entry
 // that packs the varargs before forwarding. Look in both.
@@ -100,8 +127,11 @@ BOOST_AUTO_TEST_CASE(format_detected_by_attribute) {
 
 BOOST_AUTO_TEST_CASE(callback_is_substituted) {
     // The comparator is wrapped in a trampoline via the callback context on the receiving (host)
-    // side. The guest, which supplies the comparator, emits the matching ProcCb trampoline support.
+    // side, and its stub is owned by the thunk's context. The guest, which supplies the
+    // comparator, emits the matching ProcCb trampoline support.
     BOOST_TEST(hostSrc().find("CallbackContext") != std::string::npos);
+    BOOST_TEST(emits(hostSrc(), "le_qsort", "Adapt",
+                     "::invoke, lore::thunk::detail::ThunkTrampolineContext>)"));
     BOOST_TEST(guestSrc().find("ProcCb<le_compare_fn") != std::string::npos);
 }
 
@@ -149,4 +179,96 @@ BOOST_AUTO_TEST_CASE(format_kind_and_index) {
     BOOST_TEST(phaseBody(guestSrc(), "le_sscanf", "Entry").find("ScanF, arg2,") != std::string::npos);
 }
 
+// le_mix is tagged pass::Leaf, so it crosses as a leaf (no coroutine switch on the host). Untagged
+// functions keep the standard invoke, whether they take a callback or, like le_call_handler and
+// le_tally_total, show nothing in their signature.
+BOOST_AUTO_TEST_CASE(leaf_function_uses_leaf_invoke) {
+    BOOST_TEST(emits(guestSrc(), "le_mix", "Caller", "::invokeLeaf("));
+    BOOST_TEST(!emits(guestSrc(), "le_qsort", "Caller", "::invokeLeaf("));
+    BOOST_TEST(!emits(guestSrc(), "le_visit", "Caller", "::invokeLeaf("));
+    BOOST_TEST(!emits(guestSrc(), "le_call_handler", "Caller", "::invokeLeaf("));
+    BOOST_TEST(!emits(guestSrc(), "le_tally_total", "Caller", "Leaf("));
+}
+
+// le_tally is tagged pass::Deferred, so its guest Caller records the call with its argument sizes.
+// le_tally_reset, deferred too, has no arguments and passes null arrays rather than empty ones.
+// le_tally_total is untagged and crosses as usual.
+BOOST_AUTO_TEST_CASE(deferred_function_uses_deferred_invoke) {
+    BOOST_TEST(emits(guestSrc(), "le_tally", "Caller", "::invokeDeferred(args, argSizes, 1)"));
+    BOOST_TEST(emits(guestSrc(), "le_tally", "Caller", "sizeof(arg1)"));
+    const auto &src = guestSrc();
+    BOOST_TEST(emits(src, "le_tally_reset", "Caller", "void **args = nullptr;"));
+    BOOST_TEST(emits(src, "le_tally_reset", "Caller", "const unsigned *argSizes = nullptr;"));
+    BOOST_TEST(emits(src, "le_tally_reset", "Caller", "::invokeDeferred(args, argSizes, 0)"));
+    BOOST_TEST(!emits(guestSrc(), "le_tally_total", "Caller", "::invokeDeferred("));
+}
+
+// le_fill is tagged pass::Async, so its guest Caller posts the call to a host worker.
+BOOST_AUTO_TEST_CASE(async_function_uses_async_invoke) {
+    BOOST_TEST(emits(guestSrc(), "le_fill", "Caller", "::invokeAsync(args, argSizes, 3)"));
+    BOOST_TEST(emits(guestSrc(), "le_post_handler", "Caller", "::invokeAsync("));
+    BOOST_TEST(!emits(guestSrc(), "le_checksum", "Caller", "::invokeAsync("));
+}
+
+// le_checksum takes a pointer and a size_t and returns unsigned long, so it crosses with CC_Register:
+// the guest passes the words by value and the host Entry takes them as parameters. le_mix (long
+// double) and le_qsort (a callback) keep the args[] form.
+BOOST_AUTO_TEST_CASE(scalar_function_uses_register_invoke) {
+    BOOST_TEST(emits(guestSrc(), "le_checksum", "Caller", "::invokeRegisterLeaf("));
+    BOOST_TEST(!emits(guestSrc(), "le_checksum", "Caller", "void *args[]"));
+    BOOST_TEST(emits(hostSrc(), "le_checksum", "Entry", "fromRegister<"));
+    BOOST_TEST(emits(guestSrc(), "le_call_handler", "Caller", "::invokeRegister("));
+    BOOST_TEST(!emits(guestSrc(), "le_mix", "Caller", "::invokeRegister"));
+    BOOST_TEST(!emits(guestSrc(), "le_qsort", "Caller", "::invokeRegister"));
+}
+
+// le_checksum is tagged pass::Adaptive, so its guest Entry hands the Adapt layer to Exec, which
+// picks the route per call. Its Caller and the host side are unchanged. tst_Loopback_Placement runs
+// its guest route.
+BOOST_AUTO_TEST_CASE(adaptive_function_uses_adaptive_entry) {
+    BOOST_TEST(emits(guestSrc(), "le_checksum", "Entry",
+                     "Exec>::invokeAdaptive(ProcFn<::le_checksum, GuestToHost, Adapt>::invoke,"));
+    BOOST_TEST(emits(guestSrc(), "le_checksum", "Caller", "::invokeRegisterLeaf("));
+    BOOST_TEST(!emits(hostSrc(), "le_checksum", "Entry", "invokeAdaptive"));
+    BOOST_TEST(!emits(guestSrc(), "le_mix", "Entry", "invokeAdaptive"));
+}
+
+// le_compare_fn takes two data pointers and is no register proc (a callback), so the host Caller
+// packs them by value into a frame and the guest Entry reads its fields. le_qsort, which passes a
+// callback, and le_tally, whose deferred call copies each argument, keep args[].
+BOOST_AUTO_TEST_CASE(scalar_callback_uses_argument_frame) {
+    const auto &host = hostSrc();
+    const auto &guest = guestSrc();
+    BOOST_TEST(callbackEmits(host, "le_compare_fn", "HostToGuest", "Caller",
+                             "Frame frame = {arg1, arg2};"));
+    BOOST_TEST(callbackEmits(host, "le_compare_fn", "HostToGuest", "Caller",
+                             "::invoke(callback, (void **) &frame, &ret, nullptr)"));
+    BOOST_TEST(!callbackEmits(host, "le_compare_fn", "HostToGuest", "Caller", "void *args[]"));
+    BOOST_TEST(callbackEmits(guest, "le_compare_fn", "HostToGuest", "Entry",
+                             "static_assert(sizeof(Frame) == 16"));
+    BOOST_TEST(callbackEmits(guest, "le_compare_fn", "HostToGuest", "Entry",
+                             "auto &frame = *(Frame *) args;"));
+    BOOST_TEST(callbackEmits(guest, "le_compare_fn", "HostToGuest", "Entry",
+                             "auto &arg2 = frame.arg2;"));
+    BOOST_TEST(emits(guest, "le_qsort", "Caller", "void *args[]"));
+    BOOST_TEST(emits(guest, "le_tally", "Caller", "void *args[]"));
+}
+
+// le_sum6 takes six scalars, too many for CC_Register, so the guest Caller packs them into a frame
+// laid out with the padding of each field, and the host Entry reads them back. The layout both
+// sides assert does not depend on the target they were generated for. tst_Loopback checks the sum.
+BOOST_AUTO_TEST_CASE(scalar_function_uses_argument_frame) {
+    BOOST_TEST(emits(guestSrc(), "le_sum6", "Caller",
+                     "Frame frame = {arg1, arg2, arg3, arg4, arg5, arg6};"));
+    BOOST_TEST(emits(guestSrc(), "le_sum6", "Caller", "::invoke((void **) &frame, &ret, nullptr)"));
+    BOOST_TEST(!emits(guestSrc(), "le_sum6", "Caller", "::invokeRegister"));
+    for (const auto &[src, phase] : {std::pair{&guestSrc(), "Caller"}, {&hostSrc(), "Entry"}}) {
+        BOOST_TEST(emits(*src, "le_sum6", phase, "static_assert(offsetof(Frame, arg2) == 2"));
+        BOOST_TEST(emits(*src, "le_sum6", phase, "static_assert(offsetof(Frame, arg4) == 8"));
+        BOOST_TEST(emits(*src, "le_sum6", phase, "static_assert(offsetof(Frame, arg6) == 24"));
+        BOOST_TEST(emits(*src, "le_sum6", phase, "static_assert(sizeof(Frame) == 32"));
+    }
+    BOOST_TEST(emits(hostSrc(), "le_sum6", "Entry", "auto &arg6 = frame.arg6;"));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,436 @@
+// Crossing-cost benchmark. An ordinary x86_64 program that calls the lb_* functions of the
+// benchmark thunk (libLoreBenchThunk.so); run under the patched QEMU with the dlcall plugin, each
+// call crosses to the host implementation, which does next to nothing, so the time per call is the
+// cost of the bridge. See the run_lore_bench target and README in this directory.
+//
+// Usage: LoreBench [-o output.json] [-s scale] [-r repeats]
+//
+// Writes one JSON object (to stdout, or to the -o file) whose "results" map each benchmark to its
+// median and minimum nanoseconds per operation over the repeats. Lower is better for every entry,
+// so two runs compare entry by entry (see Run.cmake).
+
+#include "LoreBenchThunk.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_RESULTS 96
+#define MAX_REPEATS 64
+#define MAX_THREADS 64
+
+struct result {
+    char name[48];
+    double median;
+    double min;
+    long ops;
+    int threads;
+};
+
+static struct result results[MAX_RESULTS];
+static int num_results = 0;
+
+static long scale = 1;
+static int repeats = 5;
+static int max_threads = 8;
+static int failures = 0;
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec * 1e9 + (double) ts.tv_nsec;
+}
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *) a;
+    double y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+// Check a result the benchmark relies on, so a broken thunk does not pass for a fast one.
+#define CHECK(cond)                                                                                \
+    do {                                                                                           \
+        if (!(cond)) {                                                                             \
+            fprintf(stderr, "LoreBench: check failed: %s\n", #cond);                               \
+            failures++;                                                                            \
+        }                                                                                          \
+    } while (0)
+
+// A benchmark body: run the operation `iters` times.
+typedef void (*bench_fn)(long iters);
+
+// Record the median and minimum of `count` samples, in ns per operation.
+static void add_result(const char *name, double *samples, int count, long ops, int threads) {
+    struct result *r;
+    if (num_results == MAX_RESULTS) {
+        return;
+    }
+    r = &results[num_results++];
+    qsort(samples, count, sizeof(double), compare_double);
+    snprintf(r->name, sizeof(r->name), "%s", name);
+    r->median = samples[count / 2];
+    r->min = samples[0];
+    r->ops = ops;
+    r->threads = threads;
+    fprintf(stderr, "  %-28s %12.1f ns/op  (min %.1f)\n", name, r->median, r->min);
+}
+
+// Time `iters` operations `repeats` times after a warm-up run, and record ns per operation.
+static void run(const char *name, bench_fn fn, long iters) {
+    double samples[MAX_REPEATS];
+    iters *= scale;
+    fn(iters / 10 + 1);
+    for (int i = 0; i < repeats; ++i) {
+        double start = now_ns();
+        fn(iters);
+        samples[i] = (now_ns() - start) / (double) iters;
+    }
+    add_result(name, samples, repeats, iters, 1);
+}
+
+// --- Calls by argument count --------------------------------------------------------------------
+
+static volatile int sink;
+static volatile double sink_d;
+
+static void bench_null(long iters) {
+    for (long i = 0; i < iters; ++i) {
+        lb_null();
+    }
+}
+
+static void bench_args1(long iters) {
+    for (long i = 0; i < iters; ++i) {
+        sink = lb_args1((int) i);
+    }
+}
+
+static void bench_args2(long iters) {
+    for (long i = 0; i < iters; ++i) {
+        sink = lb_args2((int) i, 2);
+    }
+}
+
+static void bench_args4(long iters) {
+    for (long i = 0; i < iters; ++i) {
+        sink = lb_args4((int) i, 2, 3, 4);
+    }
+}
+
+static void bench_args8(long iters) {
+    for (long i = 0; i < iters; ++i) {
+        sink = lb_args8((int) i, 2, 3, 4, 5, 6, 7, 8);
+    }
+}
+
+static void bench_args8d(long iters) {
+    for (long i = 0; i < iters; ++i) {
+        sink_d = lb_args8d((double) i, 2, 3, 4, 5, 6, 7, 8);
+    }
+}
+
+// --- Format marshalling -------------------------------------------------------------------------
+
+static void bench_snprintf_int(long iters) {
+    char buf[64];
+    for (long i = 0; i < iters; ++i) {
+        sink = lb_snprintf(buf, sizeof(buf), "%d", (int) i);
+    }
+}
+
+static void bench_snprintf_mixed(long iters) {
+    char buf[128];
+    for (long i = 0; i < iters; ++i) {
+        sink = lb_snprintf(buf, sizeof(buf), "%s %d %ld %.3f %c %p", "name", (int) i, -i, 0.5,
+                           'x', (void *) buf);
+    }
+}
+
+static void bench_sscanf(long iters) {
+    int a, b;
+    double c;
+    for (long i = 0; i < iters; ++i) {
+        sink = lb_sscanf("12 34 5.5", "%d %d %lf", &a, &b, &c);
+    }
+}
+
+// --- Reentry ------------------------------------------------------------------------------------
+
+static int identity(int x) {
+    return x;
+}
+
+static void bench_callback(long iters) {
+    for (long i = 0; i < iters; ++i) {
+        sink = lb_callback(identity, (int) i);
+    }
+}
+
+static int nest(int depth) {
+    return lb_nest(depth - 1, nest) + 1;
+}
+
+static int nest_depth;
+
+static void bench_nest(long iters) {
+    for (long i = 0; i < iters; ++i) {
+        sink = lb_nest(nest_depth, nest);
+    }
+}
+
+// --- Host proc address conversion ---------------------------------------------------------------
+
+static void bench_proc_address(long iters) {
+    for (long i = 0; i < iters; ++i) {
+        sink = lb_get_proc_address("lb_args1") != NULL;
+    }
+}
+
+// --- Host thread creation -----------------------------------------------------------------------
+
+static pthread_attr_t detached_attr;
+
+static void bench_spawn(long iters) {
+    // Batches of 8 threads, so the host waits on several starts at once as a real spawner would.
+    for (long i = 0; i < iters; i += 8) {
+        long count = iters - i < 8 ? iters - i : 8;
+        sink = lb_spawn((int) count, &detached_attr);
+    }
+}
+
+// --- Multi-threaded throughput ------------------------------------------------------------------
+
+struct mt_context {
+    pthread_barrier_t start;
+    pthread_barrier_t done;
+    bench_fn fn;
+    long iters;
+    int rounds;
+};
+
+static void *mt_thread(void *arg) {
+    struct mt_context *ctx = arg;
+    for (int round = 0; round < ctx->rounds; ++round) {
+        pthread_barrier_wait(&ctx->start);
+        ctx->fn(ctx->iters);
+        pthread_barrier_wait(&ctx->done);
+    }
+    return NULL;
+}
+
+static void bench_mt_call(long iters) {
+    for (long i = 0; i < iters; ++i) {
+        sink = lb_args1((int) i);
+    }
+}
+
+// Mostly plain calls, with a callback, a proc address conversion and a thunk database lookup
+// in every 8: the shared state each thread's crossings meet in an application.
+static void bench_mt_mixed(long iters) {
+    for (long i = 0; i < iters; ++i) {
+        switch (i % 8) {
+            case 5:
+                sink = lb_callback(identity, (int) i);
+                break;
+            case 6:
+                sink = lb_get_proc_address("lb_args1") != NULL;
+                break;
+            case 7:
+                sink = lb_thunk_info("libLoreBenchThunk.so");
+                break;
+            default:
+                sink = lb_args1((int) i);
+                break;
+        }
+    }
+}
+
+// Each of `threads` threads runs `fn` over `iters` operations at once. Records the wall time over
+// the total number of operations as `<prefix>_<threads>t`, so perfect scaling divides the
+// single-thread figure by the thread count. Returns that median.
+static double run_mt(const char *prefix, bench_fn fn, int threads, long iters) {
+    char name[48];
+    double samples[MAX_REPEATS];
+    pthread_t tids[MAX_THREADS];
+    struct mt_context ctx;
+
+    iters *= scale;
+    ctx.fn = fn;
+    ctx.iters = iters;
+    ctx.rounds = repeats + 1;
+    pthread_barrier_init(&ctx.start, NULL, threads + 1);
+    pthread_barrier_init(&ctx.done, NULL, threads + 1);
+    for (int t = 0; t < threads; ++t) {
+        pthread_create(&tids[t], NULL, mt_thread, &ctx);
+    }
+    // One warm-up round, then the timed ones, each bracketed by the two barriers.
+    for (int i = -1; i < repeats; ++i) {
+        double start;
+        pthread_barrier_wait(&ctx.start);
+        start = now_ns();
+        pthread_barrier_wait(&ctx.done);
+        if (i >= 0) {
+            samples[i] = (now_ns() - start) / (double) (iters * threads);
+        }
+    }
+    for (int t = 0; t < threads; ++t) {
+        pthread_join(tids[t], NULL);
+    }
+    pthread_barrier_destroy(&ctx.start);
+    pthread_barrier_destroy(&ctx.done);
+
+    snprintf(name, sizeof(name), "%s_%dt", prefix, threads);
+    add_result(name, samples, repeats, iters * threads, threads);
+    return results[num_results - 1].median;
+}
+
+// Run one workload on 1, 2, 4, ... up to `max_threads` threads, and print how its throughput
+// scales: the speedup over one thread, and that speedup over the thread count.
+static void run_scaling(const char *prefix, bench_fn fn, long iters) {
+    int counts[MAX_THREADS];
+    double ns[MAX_THREADS];
+    int n = 0;
+    for (int threads = 1;; threads *= 2) {
+        if (threads > max_threads) {
+            threads = max_threads;
+        }
+        counts[n] = threads;
+        ns[n++] = run_mt(prefix, fn, threads, iters);
+        if (threads == max_threads) {
+            break;
+        }
+    }
+    fprintf(stderr, "  %s scaling:   threads    Mops/s   speedup  efficiency\n", prefix);
+    for (int i = 0; i < n; ++i) {
+        const double speedup = ns[0] / ns[i];
+        fprintf(stderr, "  %*s %9d %9.2f %8.2fx %10.0f%%\n", (int) strlen(prefix) + 9, "",
+                counts[i], 1e3 / ns[i], speedup, 100.0 * speedup / counts[i]);
+    }
+}
+
+// --- Output -------------------------------------------------------------------------------------
+
+static void write_json(FILE *out) {
+    fprintf(out, "{\n  \"benchmark\": \"LoreBench\",\n  \"version\": 1,\n");
+    fprintf(out, "  \"scale\": %ld,\n  \"repeats\": %d,\n  \"results\": {\n", scale, repeats);
+    for (int i = 0; i < num_results; ++i) {
+        const struct result *r = &results[i];
+        fprintf(out,
+                "    \"%s\": {\"ns_per_op\": %.2f, \"min_ns_per_op\": %.2f, \"ops\": %ld, "
+                "\"threads\": %d}%s\n",
+                r->name, r->median, r->min, r->ops, r->threads, i + 1 < num_results ? "," : "");
+    }
+    fprintf(out, "  }\n}\n");
+}
+
+int main(int argc, char **argv) {
+    const char *output = NULL;
+    int opt;
+    while ((opt = getopt(argc, argv, "o:s:r:t:")) != -1) {
+        switch (opt) {
+            case 'o':
+                output = optarg;
+                break;
+            case 's':
+                scale = atol(optarg);
+                break;
+            case 'r':
+                repeats = atoi(optarg);
+                break;
+            case 't':
+                max_threads = atoi(optarg);
+                break;
+            default:
+                fprintf(stderr,
+                        "Usage: %s [-o output.json] [-s scale] [-r repeats] [-t max_threads]\n",
+                        argv[0]);
+                return 2;
+        }
+    }
+    if (scale < 1) {
+        scale = 1;
+    }
+    if (repeats < 1 || repeats > MAX_REPEATS) {
+        repeats = 5;
+    }
+    if (max_threads < 1 || max_threads > MAX_THREADS) {
+        max_threads = 8;
+    }
+
+    // Sanity checks: each path must return the host's answer before it is worth timing.
+    {
+        char buf[64];
+        int a = 0, b = 0;
+        double start, first;
+        void *proc;
+        CHECK(lb_args8(1, 2, 3, 4, 5, 6, 7, 8) == 36);
+        CHECK(lb_args8d(1, 2, 3, 4, 5, 6, 7, 8) == 36.0);
+        CHECK(lb_snprintf(buf, sizeof(buf), "%d-%s", 42, "x") == 4 && strcmp(buf, "42-x") == 0);
+        CHECK(lb_sscanf("7 9", "%d %d", &a, &b) == 2 && a == 7 && b == 9);
+        CHECK(lb_callback(identity, 5) == 5);
+        CHECK(lb_nest(4, nest) == 4);
+        CHECK(lb_thunk_info("libLoreBenchThunk.so") == 1);
+
+        // The first conversion resolves the address through the host; later ones hit the cache.
+        start = now_ns();
+        proc = lb_get_proc_address("lb_args2");
+        first = now_ns() - start;
+        CHECK(proc != NULL && ((int (*)(int, int)) proc)(3, 4) == 7);
+        add_result("proc_address_first", &first, 1, 1, 1);
+    }
+    if (failures) {
+        fprintf(stderr, "LoreBench: %d check(s) failed\n", failures);
+        return 1;
+    }
+
+    fprintf(stderr, "LoreBench (scale %ld, %d repeats):\n", scale, repeats);
+
+    run("null_call", bench_null, 100000);
+    run("args_1", bench_args1, 100000);
+    run("args_2", bench_args2, 100000);
+    run("args_4", bench_args4, 100000);
+    run("args_8", bench_args8, 100000);
+    run("args_8_double", bench_args8d, 100000);
+
+    run("snprintf_int", bench_snprintf_int, 20000);
+    run("snprintf_mixed", bench_snprintf_mixed, 20000);
+    run("sscanf", bench_sscanf, 20000);
+
+    run("callback", bench_callback, 50000);
+    {
+        static const int depths[] = {1, 2, 4, 8, 16};
+        char name[48];
+        for (size_t i = 0; i < sizeof(depths) / sizeof(depths[0]); ++i) {
+            nest_depth = depths[i];
+            snprintf(name, sizeof(name), "nest_depth_%d", depths[i]);
+            run(name, bench_nest, 20000 / depths[i]);
+        }
+    }
+
+    run("proc_address", bench_proc_address, 50000);
+
+    pthread_attr_init(&detached_attr);
+    pthread_attr_setdetachstate(&detached_attr, PTHREAD_CREATE_DETACHED);
+    run("thread_create", bench_spawn, 200);
+    pthread_attr_destroy(&detached_attr);
+
+    run_scaling("mt_call", bench_mt_call, 50000);
+    run_scaling("mt_mixed", bench_mt_mixed, 20000);
+
+    if (output) {
+        FILE *out = fopen(output, "w");
+        if (!out) {
+            perror(output);
+            return 1;
+        }
+        write_json(out);
+        fclose(out);
+        fprintf(stderr, "LoreBench: results written to %s\n", output);
+    } else {
+        write_json(stdout);
+    }
+    return 0;
+}
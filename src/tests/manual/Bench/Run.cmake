@@ -0,0 +1,175 @@
+# Runs LoreBench under the patched QEMU and compares its results with a baseline. Run via
+# `cmake -P` by the run_lore_bench target so the settings can come from the environment at build
+# time. Passed in as -D defines: PROGRAM (the benchmark program), WORK (its build directory,
+# holding the GTL, HTL and ThunkDB.json), RT_DIR (where the Lore runtimes live), and the cache
+# values of QEMU_BUILD_DIR and LORE_BENCH_BASELINE, used when the environment does not set them.
+#
+# Read from the environment only:
+#   LORE_BENCH_OUTPUT     where to write the results (default: LoreBench.json in WORK)
+#   LORE_BENCH_ARGS       extra program arguments, e.g. "-s 10" for ten times the iterations
+#   LORE_BENCH_TOLERANCE  with a baseline, fail if any result is this many percent slower
+#   LORE_BENCH_LOOPBACK   if set, run the program natively in loopback mode (LORELEI_LOOPBACK)
+#                         instead of under QEMU; QEMU_BUILD_DIR is then not needed
+#
+# With BASELINE_ONLY and OUTPUT set (and no PROGRAM), it skips the run and only compares OUTPUT
+# against the baseline.
+
+if(DEFINED ENV{LORE_BENCH_BASELINE})
+    set(_baseline "$ENV{LORE_BENCH_BASELINE}")
+else()
+    set(_baseline "${LORE_BENCH_BASELINE}")
+endif()
+
+if(DEFINED ENV{LORE_BENCH_OUTPUT})
+    set(_output "$ENV{LORE_BENCH_OUTPUT}")
+elseif(OUTPUT)
+    set(_output "${OUTPUT}")
+else()
+    set(_output "${WORK}/LoreBench.json")
+endif()
+
+if(NOT BASELINE_ONLY AND NOT "$ENV{LORE_BENCH_LOOPBACK}" STREQUAL "")
+    separate_arguments(_args UNIX_COMMAND "$ENV{LORE_BENCH_ARGS}")
+
+    # The bridge without the emulator: the guest runtime loads the host runtime into this process
+    # and serves the requests itself, so the results are the runtime's own cost.
+    execute_process(
+        COMMAND ${CMAKE_COMMAND} -E env
+            LORELEI_LOOPBACK=1
+            LD_LIBRARY_PATH=${RT_DIR}:${WORK}
+            LORELEI_THUNK_DATABASE=${WORK}/ThunkDB.json
+            "LORELEI_THUNKS_CONFIG_VARIABLES=GTL_DIR=${WORK};HTL_DIR=${WORK}"
+            ${PROGRAM} -o ${_output} ${_args}
+        RESULT_VARIABLE _rc
+    )
+
+    if(NOT _rc EQUAL 0)
+        message(FATAL_ERROR "LoreBench failed (exit ${_rc})")
+    endif()
+elseif(NOT BASELINE_ONLY)
+    if(DEFINED ENV{QEMU_BUILD_DIR})
+        set(_qemu "$ENV{QEMU_BUILD_DIR}")
+    elseif(QEMU_BUILD_DIR)
+        set(_qemu "${QEMU_BUILD_DIR}")
+    else()
+        message(FATAL_ERROR
+            "QEMU_BUILD_DIR is not set.\n"
+            "Give it through the environment or -D, pointing at your QEMU build/release directory:\n"
+            "  QEMU_BUILD_DIR=/path/to/qemu/build/release cmake --build <build> --target run_lore_bench")
+    endif()
+
+    set(_qemu_bin "${_qemu}/qemu-x86_64")
+    set(_plugin "${_qemu}/contrib/plugins/libdlcall.so")
+
+    if(NOT EXISTS "${_qemu_bin}" OR NOT EXISTS "${_plugin}")
+        message(FATAL_ERROR
+            "QEMU not found under '${_qemu}'.\n"
+            "  expected: ${_qemu_bin}\n"
+            "            ${_plugin}\n"
+            "Set QEMU_BUILD_DIR (environment or -D) to your QEMU build/release directory.")
+    endif()
+
+    separate_arguments(_args UNIX_COMMAND "$ENV{LORE_BENCH_ARGS}")
+
+    # The same launch as the manual TLC test: the host side loads the runtimes and the HTL from
+    # LD_LIBRARY_PATH, the guest side from the path passed through with -E.
+    execute_process(
+        COMMAND ${CMAKE_COMMAND} -E env
+            LD_LIBRARY_PATH=${RT_DIR}:${WORK}
+            LORELEI_THUNK_DATABASE=${WORK}/ThunkDB.json
+            "LORELEI_THUNKS_CONFIG_VARIABLES=GTL_DIR=${WORK};HTL_DIR=${WORK}"
+            ${_qemu_bin}
+                -plugin ${_plugin}
+                -E LD_LIBRARY_PATH=${WORK}:${RT_DIR}
+                ${PROGRAM} -o ${_output} ${_args}
+        RESULT_VARIABLE _rc
+    )
+
+    if(NOT _rc EQUAL 0)
+        message(FATAL_ERROR "LoreBench failed (exit ${_rc})")
+    endif()
+endif()
+
+if(NOT _baseline)
+    return()
+endif()
+
+if(NOT EXISTS "${_baseline}")
+    message(FATAL_ERROR "LoreBench baseline '${_baseline}' not found")
+endif()
+
+file(READ "${_output}" _current_json)
+file(READ "${_baseline}" _baseline_json)
+
+# A JSON number as an integer count of hundredths, since CMake's math() is integer only.
+function(_lb_centi _value _out)
+    string(REGEX MATCH "^([0-9]+)(\\.([0-9]*))?" _ "${_value}")
+    set(_whole "${CMAKE_MATCH_1}")
+    set(_frac "${CMAKE_MATCH_3}00")
+    string(SUBSTRING "${_frac}" 0 2 _frac)
+    string(REGEX REPLACE "^0" "" _frac "${_frac}")
+    if(_frac STREQUAL "")
+        set(_frac 0)
+    endif()
+    math(EXPR _centi "${_whole} * 100 + ${_frac}")
+    set(${_out} ${_centi} PARENT_SCOPE)
+endfunction()
+
+# Format a count of hundredths as a decimal number.
+function(_lb_decimal _centi _out)
+    set(_sign "")
+    if(_centi LESS 0)
+        set(_sign "-")
+        math(EXPR _centi "-${_centi}")
+    endif()
+    math(EXPR _whole "${_centi} / 100")
+    math(EXPR _frac "${_centi} % 100")
+    if(_frac LESS 10)
+        set(_frac "0${_frac}")
+    endif()
+    set(${_out} "${_sign}${_whole}.${_frac}" PARENT_SCOPE)
+endfunction()
+
+# Walk the current results, printing each one's median against the baseline's. Results the
+# baseline does not have (a benchmark added since) are listed without a change.
+set(_tolerance "$ENV{LORE_BENCH_TOLERANCE}")
+set(_regressions "")
+string(JSON _count LENGTH "${_current_json}" results)
+math(EXPR _last "${_count} - 1")
+message("LoreBench against ${_baseline}:")
+foreach(_i RANGE ${_last})
+    string(JSON _name MEMBER "${_current_json}" results ${_i})
+    string(JSON _now GET "${_current_json}" results ${_name} ns_per_op)
+    _lb_centi("${_now}" _now)
+    _lb_decimal(${_now} _now_text)
+    string(JSON _then ERROR_VARIABLE _missing GET "${_baseline_json}" results ${_name} ns_per_op)
+    if(_missing)
+        message("  ${_name}: ${_now_text} ns (new)")
+        continue()
+    endif()
+    _lb_centi("${_then}" _then)
+    _lb_decimal(${_then} _then_text)
+
+    # The change in hundredths of a percent.
+    if(_then GREATER 0)
+        math(EXPR _change "(${_now} - ${_then}) * 10000 / ${_then}")
+    else()
+        set(_change 0)
+    endif()
+    _lb_decimal(${_change} _change_text)
+    if(_change GREATER_EQUAL 0)
+        set(_change_text "+${_change_text}")
+    endif()
+    message("  ${_name}: ${_then_text} -> ${_now_text} ns (${_change_text}%)")
+
+    if(NOT _tolerance STREQUAL "")
+        math(EXPR _limit "${_tolerance} * 100")
+        if(_change GREATER _limit)
+            list(APPEND _regressions ${_name})
+        endif()
+    endif()
+endforeach()
+
+if(_regressions)
+    message(FATAL_ERROR "LoreBench: slower than the baseline by over ${_tolerance}%: ${_regressions}")
+endif()
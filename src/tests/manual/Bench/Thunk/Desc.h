@@ -0,0 +1,53 @@
+#pragma once
+
+#include "LoreBenchThunk.h"
+
+#include <lorelei/ThunkInterface/Proc.h>
+#include <lorelei/ThunkInterface/PassTags.h>
+
+namespace lore::thunk {
+
+    // lb_snprintf / lb_sscanf are recognised by their names. The rest of the descriptors tag the
+    // functions whose signature does not say enough.
+
+    // lb_null / lb_argsN call nothing back, so they take the leaf path, as a real library's small
+    // functions would once tagged. lb_spawn, untagged, reenters the guest to create its threads.
+    template <>
+    struct ProcFnDesc<::lb_null> {
+        _DESC pass::PassTagList<pass::Leaf> passes = {};
+    };
+
+    template <>
+    struct ProcFnDesc<::lb_args1> {
+        _DESC pass::PassTagList<pass::Leaf> passes = {};
+    };
+
+    template <>
+    struct ProcFnDesc<::lb_args2> {
+        _DESC pass::PassTagList<pass::Leaf> passes = {};
+    };
+
+    template <>
+    struct ProcFnDesc<::lb_args4> {
+        _DESC pass::PassTagList<pass::Leaf> passes = {};
+    };
+
+    template <>
+    struct ProcFnDesc<::lb_args8> {
+        _DESC pass::PassTagList<pass::Leaf> passes = {};
+    };
+
+    template <>
+    struct ProcFnDesc<::lb_args8d> {
+        _DESC pass::PassTagList<pass::Leaf> passes = {};
+    };
+
+    // lb_get_proc_address returns a host function address, which the guest converts into the
+    // guest thunk's function of the same name. No prefetch: the benchmark measures the conversion
+    // itself.
+    template <>
+    struct ProcFnDesc<::lb_get_proc_address> {
+        _DESC pass::PassTagList<pass::GetProcAddress<1>> passes = {};
+    };
+
+}
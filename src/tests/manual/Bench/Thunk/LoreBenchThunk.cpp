@@ -0,0 +1,119 @@
+#include "LoreBenchThunk.h"
+
+#include <atomic>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+
+#include <sched.h>
+
+#include <lorelei/Modules/HostRT/HostServer.h>
+
+// Host-side implementation of the benchmark library. Built into the host thunk by the LoreBench
+// targets (src/tests/manual/Bench).
+
+namespace {
+
+    std::atomic<int> lb_started{0};
+
+    // The host routine of each lb_spawn thread: the first crossing of the new guest thread.
+    void *lb_thread_main(void *arg) {
+        (void) arg;
+        lb_started.fetch_add(1, std::memory_order_release);
+        return nullptr;
+    }
+
+}
+
+extern "C" {
+
+    void lb_null(void) {
+    }
+
+    int lb_args1(int a) {
+        return a;
+    }
+
+    int lb_args2(int a, int b) {
+        return a + b;
+    }
+
+    int lb_args4(int a, int b, int c, int d) {
+        return a + b + c + d;
+    }
+
+    int lb_args8(int a, int b, int c, int d, int e, int f, int g, int h) {
+        return a + b + c + d + e + f + g + h;
+    }
+
+    double lb_args8d(double a, double b, double c, double d, double e, double f, double g,
+                     double h) {
+        return a + b + c + d + e + f + g + h;
+    }
+
+    int lb_snprintf(char *buf, size_t size, const char *fmt, ...) {
+        va_list ap;
+        va_start(ap, fmt);
+        int ret = std::vsnprintf(buf, size, fmt, ap);
+        va_end(ap);
+        return ret;
+    }
+
+    int lb_sscanf(const char *str, const char *fmt, ...) {
+        va_list ap;
+        va_start(ap, fmt);
+        int ret = std::vsscanf(str, fmt, ap);
+        va_end(ap);
+        return ret;
+    }
+
+    int lb_callback(lb_int_fn fn, int x) {
+        return fn(x);
+    }
+
+    int lb_nest(int depth, lb_nest_fn fn) {
+        return depth > 0 ? fn(depth) : 0;
+    }
+
+    void *lb_get_proc_address(const char *name) {
+        static const struct {
+            const char *name;
+            void *addr;
+        } procs[] = {
+            {"lb_null", reinterpret_cast<void *>(&lb_null)},
+            {"lb_args1", reinterpret_cast<void *>(&lb_args1)},
+            {"lb_args2", reinterpret_cast<void *>(&lb_args2)},
+        };
+        for (const auto &proc : procs) {
+            if (std::strcmp(proc.name, name) == 0) {
+                return proc.addr;
+            }
+        }
+        return nullptr;
+    }
+
+    int lb_spawn(int count, void *attr) {
+        // Each thread is a guest thread, created by the guest runtime, whose first act is to call
+        // lb_thread_main here. Wait until all of them have, so the time covers the whole trip.
+        lb_started.store(0, std::memory_order_relaxed);
+        int created = 0;
+        for (int i = 0; i < count; ++i) {
+            unsigned long thread;
+            if (lore::mod::HostServer::reenterThreadCreate(
+                    &thread, attr, reinterpret_cast<void *>(&lb_thread_main), nullptr) == 0) {
+                ++created;
+            }
+        }
+        while (lb_started.load(std::memory_order_acquire) < created) {
+            sched_yield();
+        }
+        return created;
+    }
+
+    int lb_thunk_info(const char *path) {
+        lore::CThunkInfo info;
+        lore::mod::HostServer::instance()->getThunkInfo(path, false, &info);
+        return info.forward != nullptr;
+    }
+
+}
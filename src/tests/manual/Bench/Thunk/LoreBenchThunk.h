@@ -0,0 +1,71 @@
+#ifndef LORE_BENCH_LOREBENCHTHUNK_H
+#define LORE_BENCH_LOREBENCHTHUNK_H
+
+// Usable from both C++ (TLC parses Desc.h, the manifests compile it) and C (the guest benchmark
+// program includes it directly).
+#include <stddef.h>
+
+// LoreBenchThunk is the thunk library of the crossing-cost benchmark (see src/tests/manual/Bench).
+// Every function does as little as possible on the host, so what the guest measures is the bridge
+// itself: the guest thunk, the syscall, the host entry and the return.
+//
+//   lb_null / lb_argsN         a call per argument count, from none to eight
+//   lb_snprintf / lb_sscanf    printf and scanf marshalling, run through CC_Format
+//   lb_callback / lb_nest      a reentry into the guest, and a chain of nested ones
+//   lb_get_proc_address        a host function address the guest converts (convertHostProcAddress)
+//   lb_spawn                   guest threads created from the host (SC_ThreadCreate)
+//   lb_thunk_info              a thunk database lookup on the host (HostServer::getThunkInfo)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    /// A guest callback the host calls with one integer.
+    typedef int (*lb_int_fn)(int x);
+
+    /// A guest callback that calls lb_nest again, one level shallower.
+    typedef int (*lb_nest_fn)(int depth);
+
+    /// Does nothing.
+    void lb_null(void);
+
+    /// Sums its arguments, one function per argument count.
+    int lb_args1(int a);
+    int lb_args2(int a, int b);
+    int lb_args4(int a, int b, int c, int d);
+    int lb_args8(int a, int b, int c, int d, int e, int f, int g, int h);
+
+    /// Sums eight doubles, which travel in the floating-point registers.
+    double lb_args8d(double a, double b, double c, double d, double e, double f, double g,
+                     double h);
+
+    /// snprintf on the host.
+    int lb_snprintf(char *buf, size_t size, const char *fmt, ...);
+
+    /// sscanf on the host.
+    int lb_sscanf(const char *str, const char *fmt, ...);
+
+    /// Returns fn(x), a reentry into the guest.
+    int lb_callback(lb_int_fn fn, int x);
+
+    /// Returns fn(depth) while depth is positive, else 0. A guest fn that calls lb_nest(depth - 1)
+    /// nests \a depth reentries.
+    int lb_nest(int depth, lb_nest_fn fn);
+
+    /// Returns the host address of the lb_* function \a name, or NULL.
+    void *lb_get_proc_address(const char *name);
+
+    /// Creates \a count guest threads with the guest pthread_attr_t \a attr (NULL for the
+    /// default), each running a host function, and returns once all of them have started.
+    /// Returns the number of threads created.
+    int lb_spawn(int count, void *attr);
+
+    /// Looks up the forward thunk of the guest thunk at \a path in the host runtime's thunk
+    /// database, as loading a thunk does. Returns 1 if it has one, else 0.
+    int lb_thunk_info(const char *path);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LORE_BENCH_LOREBENCHTHUNK_H
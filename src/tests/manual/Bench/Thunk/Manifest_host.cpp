@@ -0,0 +1,10 @@
+// lb_callback / lb_nest take a callback the host calls back into the guest, so callback
+// substitution must be on. AUTO_LINK folds the real lb_* addresses (from the benchmark host
+// implementation) into the HTL instead of resolving them at run time.
+#define LORE_THUNK_CALLBACK_REPLACE
+#define LORE_THUNK_AUTO_LINK
+
+#include "Desc.h"
+#include <lorelei/ThunkInterface/ManifestHost.cpp.inc>
+
+namespace lore::thunk {}
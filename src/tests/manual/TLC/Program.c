@@ -5,6 +5,8 @@
 
 #include "ThunkExample.h"
 
+#include <pthread.h>
+#include <sched.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -49,6 +51,37 @@ static void my_handler(int x) {
     handler_total += x;
 }
 
+// A reentry of an async call must not hold up another thread's async calls, which may share its host
+// worker. filler_main attaches its own ring with a first le_fill, then posts a second one once
+// wait_for_filler, the handler of a le_post_handler from the main thread, is running; the handler
+// returns only after that le_fill has completed.
+static int filler_ready;
+static int handler_entered;
+static int filler_done;
+static unsigned char filler_buf[256];
+
+static void *filler_main(void *arg) {
+    (void) arg;
+    le_fill(filler_buf, sizeof(filler_buf), 1);
+    (void) le_checksum(filler_buf, sizeof(filler_buf));
+    __atomic_store_n(&filler_ready, 1, __ATOMIC_RELEASE);
+    while (!__atomic_load_n(&handler_entered, __ATOMIC_ACQUIRE)) {
+        sched_yield();
+    }
+    le_fill(filler_buf, sizeof(filler_buf), 2);
+    __atomic_store_n(&filler_done, le_checksum(filler_buf, sizeof(filler_buf)) != 0,
+                     __ATOMIC_RELEASE);
+    return NULL;
+}
+
+static void wait_for_filler(int x) {
+    __atomic_store_n(&handler_entered, 1, __ATOMIC_RELEASE);
+    while (!__atomic_load_n(&filler_done, __ATOMIC_ACQUIRE)) {
+        sched_yield();
+    }
+    handler_total += x;
+}
+
 // Wrappers that build a va_list for the va_list-form functions.
 static int call_vprintf(const char *fmt, ...) {
     va_list ap;
@@ -120,10 +153,15 @@ int main(void) {
     int *found = (int *) le_bsearch(&key, arr, count, sizeof(int), compare_int);
     EXPECT("le_bsearch:", found != NULL && *found == 7);
 
-    // long double: round-trips through the type filter.
+    // long double: round-trips through the type filter. le_mix is tagged pass::Leaf, so this also
+    // runs the CC_Leaf path, on the host's calling stack.
     long double mixed = le_mix(1.0L, 3.0L);
     EXPECT("le_mix:", mixed == 2.0L);
 
+    // Six scalars of mixed sizes: they cross by value in a packed frame, so each must land in its
+    // own field.
+    EXPECT("le_sum6:", le_sum6(1, 20, 300, 4000L, 0.5f, 0.25) == 4321.75);
+
     // Nested callbacks: a three-level tree with a callback in every node, each level reached both as
     // a direct struct field and through a pointer. Tags 1..7 identify the positions:
     //   1 root              2 root.child            3 root.child.child     4 root.child.child_ptr
@@ -155,7 +193,7 @@ int main(void) {
     // return the original guest function (the thunk undoes its own trampoline).
     handler_total = 0;
     le_set_handler(my_handler);
-    le_call_handler(3); // host calls the stored handler -> reenters the guest
+    le_call_handler(3); // host calls the stored handler -> reenters the guest (a CC_Register call)
     EXPECT("le_call_handler:", handler_total == 3);
 
     le_handler_fn handler = NULL;
@@ -166,6 +204,43 @@ int main(void) {
     }
     EXPECT("le_get_handler call:", handler_total == 8);
 
+    // Deferred calls: the le_tally calls are only recorded, and le_tally_total (an ordinary call)
+    // sends them to the host first, so it sees all ten.
+    for (int i = 1; i <= 10; ++i) {
+        le_tally(i);
+    }
+    EXPECT("le_tally:", le_tally_total() == 55);
+
+    // Async calls: le_fill runs on a host worker, and le_checksum (an ordinary call) waits for it.
+    // le_post_handler calls my_handler from the worker, which this thread runs when it next waits.
+    static unsigned char fill_buf[4096];
+    le_fill(fill_buf, sizeof(fill_buf), 3);
+    EXPECT("le_fill:", le_checksum(fill_buf, sizeof(fill_buf)) == 3 * sizeof(fill_buf));
+    handler_total = 0;
+    le_post_handler(4);
+    le_tally(0);
+    EXPECT("le_post_handler:", le_tally_total() == 55 && handler_total == 4);
+
+    // An async reentry that waits for another thread's async call (see filler_main).
+    pthread_t filler;
+    pthread_create(&filler, NULL, filler_main, NULL);
+    while (!__atomic_load_n(&filler_ready, __ATOMIC_ACQUIRE)) {
+        sched_yield();
+    }
+    handler_total = 0;
+    le_set_handler(wait_for_filler);
+    le_post_handler(6);
+    (void) le_tally_total();
+    pthread_join(filler, NULL);
+    le_set_handler(my_handler);
+    EXPECT("le_post_handler 2:", handler_total == 6 && filler_buf[0] == 2);
+
+    // A deferred call with no arguments, recorded between two that have one.
+    le_tally(5);
+    le_tally_reset();
+    le_tally(2);
+    EXPECT("le_tally_reset:", le_tally_total() == 2);
+
     if (failures == 0) {
         printf("ThunkExample guest test: OK\n");
         return 0;
@@ -0,0 +1,177 @@
+// SPDX-License-Identifier: MIT
+
+// VariadicAdaptor backend benchmark. A native host program: it re-issues the same calls the host
+// runtime makes for printf-style thunks through each backend LoreDLCall was built with, and prints
+// the nanoseconds per call of each. Unlike LoreBench it needs no QEMU, so it runs as it is on each
+// host ISA (x86_64, aarch64, riscv64). See the README in this directory.
+//
+// Usage: LoreVariadicBench [-n calls] [-r repeats]
+//
+// Prints one line per backend and case: the median and minimum nanoseconds per call over the
+// repeats. Lower is better.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include <lorelei/DLCall/Tools/VariadicAdaptor.h>
+
+using namespace lore;
+
+static long calls = 200000;
+static int repeats = 7;
+static int failures = 0;
+
+static double sum8(double a, double b, double c, double d, double e, double f, double g,
+                   double h) {
+    return a + b + c + d + e + f + g + h;
+}
+
+struct Case {
+    const char *name;
+    // Make one call; returns false if its result is wrong.
+    bool (*run)();
+};
+
+static char buffer[128];
+
+static CVargEntry entry(int i) {
+    CVargEntry e;
+    e.type = CVargType_Int;
+    e.i = i;
+    return e;
+}
+
+static CVargEntry entry(unsigned long ul) {
+    CVargEntry e;
+    e.type = CVargType_ULong;
+    e.ul = ul;
+    return e;
+}
+
+static CVargEntry entry(double d) {
+    CVargEntry e;
+    e.type = CVargType_Double;
+    e.d = d;
+    return e;
+}
+
+static CVargEntry entry(const void *p) {
+    CVargEntry e;
+    e.type = CVargType_Pointer;
+    e.p = const_cast<void *>(p);
+    return e;
+}
+
+static CVargEntry returning(CVargType type) {
+    CVargEntry e{};
+    e.type = type;
+    return e;
+}
+
+// snprintf or vsnprintf into buffer, the way a host thunk re-issues it: the fixed arguments, then
+// the ones extracted from the format.
+template <bool VaList>
+static bool formatInt() {
+    CVargEntry fixed[] = {entry(buffer), entry((unsigned long) sizeof(buffer)), entry("%d")};
+    CVargEntry args[] = {entry(12345), returning(CVargType_Void)};
+    CVargEntry ret = returning(CVargType_Int);
+    if (VaList) {
+        VariadicAdaptor::vcall((void *) vsnprintf, 3, fixed, 1, args, &ret);
+    } else {
+        VariadicAdaptor::call((void *) snprintf, 3, fixed, 1, args, &ret);
+    }
+    return ret.i == 5 && std::strcmp(buffer, "12345") == 0;
+}
+
+template <bool VaList>
+static bool formatMixed() {
+    CVargEntry fixed[] = {entry(buffer), entry((unsigned long) sizeof(buffer)),
+                          entry("%d %s %.2f %lu")};
+    CVargEntry args[] = {entry(-7), entry("str"), entry(2.5), entry(99ul),
+                         returning(CVargType_Void)};
+    CVargEntry ret = returning(CVargType_Int);
+    if (VaList) {
+        VariadicAdaptor::vcall((void *) vsnprintf, 3, fixed, 4, args, &ret);
+    } else {
+        VariadicAdaptor::call((void *) snprintf, 3, fixed, 4, args, &ret);
+    }
+    return std::strcmp(buffer, "-7 str 2.50 99") == 0;
+}
+
+static bool callDoubles() {
+    CVargEntry args[8];
+    for (int i = 0; i < 8; ++i) {
+        args[i] = entry(double(i));
+    }
+    CVargEntry ret = returning(CVargType_Double);
+    VariadicAdaptor::call((void *) sum8, 8, args, 0, nullptr, &ret);
+    return ret.d == 28.0;
+}
+
+static const Case cases[] = {
+    {"vsnprintf_int",   formatInt<true>     },
+    {"vsnprintf_mixed", formatMixed<true>   },
+    {"snprintf_int",    formatInt<false>    },
+    {"snprintf_mixed",  formatMixed<false>  },
+    {"call_8_double",   callDoubles         },
+};
+
+static const struct {
+    VariadicAdaptor::Backend backend;
+    const char *name;
+} backends[] = {
+    {VariadicAdaptor::NativeVaList, "native"},
+    {VariadicAdaptor::FFCall,       "ffcall"},
+    {VariadicAdaptor::LibFFI,       "libffi"},
+};
+
+static double nsPerCall(const Case &c) {
+    const auto start = std::chrono::steady_clock::now();
+    for (long i = 0; i < calls; ++i) {
+        c.run();
+    }
+    const auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / double(calls);
+}
+
+int main(int argc, char *argv[]) {
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (std::strcmp(argv[i], "-n") == 0) {
+            calls = std::max(1L, std::atol(argv[i + 1]));
+        } else if (std::strcmp(argv[i], "-r") == 0) {
+            repeats = std::max(1, std::atoi(argv[i + 1]));
+        } else {
+            std::fprintf(stderr, "Usage: %s [-n calls] [-r repeats]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    std::printf("%-8s %-16s %10s %10s\n", "backend", "case", "median_ns", "min_ns");
+    for (const auto &b : backends) {
+        if (!VariadicAdaptor::setBackend(b.backend)) {
+            std::printf("%-8s (not built in)\n", b.name);
+            continue;
+        }
+        for (const auto &c : cases) {
+            // Check the path first, so a broken backend does not pass for a fast one.
+            if (!c.run()) {
+                std::fprintf(stderr, "LoreVariadicBench: %s %s: wrong result\n", b.name, c.name);
+                failures++;
+                continue;
+            }
+            std::vector<double> samples;
+            for (int r = 0; r < repeats; ++r) {
+                samples.push_back(nsPerCall(c));
+            }
+            std::sort(samples.begin(), samples.end());
+            std::printf("%-8s %-16s %10.1f %10.1f\n", b.name, c.name, samples[samples.size() / 2],
+                        samples.front());
+        }
+    }
+    VariadicAdaptor::setBackend(VariadicAdaptor::NativeVaList);
+    return failures ? 1 : 0;
+}
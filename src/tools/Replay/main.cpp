@@ -0,0 +1,117 @@
+// SPDX-License-Identifier: MIT
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <time.h>
+
+#include <lorelei/DLCall/Tools/CallLog.h>
+
+// LoreReplay - Re-issues a call log written under LORELEI_RECORD_FILE against the host libraries,
+// natively and at full speed, so `perf record LoreReplay ...` profiles the libraries alone.
+
+using namespace lore;
+
+static void printUsage(const char *argv0) {
+    std::printf("Lorelei call log replayer (Lorelei %s)\n"
+                "\n"
+                "Usage: %s [options] <call log>\n"
+                "\n"
+                "Options:\n"
+                "    -n <count>          Replay the log <count> times (default 1)\n"
+                "    -L <lib>=<path>     Load <path> for the library recorded as <lib>, a path or\n"
+                "                        a file name\n"
+                "    -x <name>           Skip the calls of function <name>\n"
+                "    -s                  Print per-function call counts\n"
+                "    -h                  Show this help\n",
+                TOOL_VERSION, argv0);
+}
+
+static double monotonicSeconds() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return double(ts.tv_sec) + double(ts.tv_nsec) * 1e-9;
+}
+
+int main(int argc, char *argv[]) {
+    int repeat = 1;
+    bool stats = false;
+    const char *logPath = nullptr;
+    std::map<std::string, std::string> overrides;
+    std::vector<std::string> skipped;
+
+    for (int i = 1; i < argc; ++i) {
+        const char *arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (std::strcmp(arg, "-h") == 0 || std::strcmp(arg, "--help") == 0) {
+            printUsage(argv[0]);
+            return 0;
+        } else if (std::strcmp(arg, "-n") == 0 && hasValue) {
+            repeat = std::atoi(argv[++i]);
+        } else if (std::strcmp(arg, "-L") == 0 && hasValue) {
+            const std::string value = argv[++i];
+            const auto eq = value.find('=');
+            if (eq == std::string::npos) {
+                std::fprintf(stderr, "%s: -L expects <lib>=<path>\n", argv[0]);
+                return 1;
+            }
+            overrides[value.substr(0, eq)] = value.substr(eq + 1);
+        } else if (std::strcmp(arg, "-x") == 0 && hasValue) {
+            skipped.emplace_back(argv[++i]);
+        } else if (std::strcmp(arg, "-s") == 0) {
+            stats = true;
+        } else if (arg[0] == '-' || logPath) {
+            std::fprintf(stderr, "%s: unexpected argument %s\n", argv[0], arg);
+            return 1;
+        } else {
+            logPath = arg;
+        }
+    }
+    if (!logPath) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    CallReplayer replayer;
+    if (!replayer.load(logPath)) {
+        std::fprintf(stderr, "%s: %s\n", argv[0], replayer.error().c_str());
+        return 1;
+    }
+    for (const auto &name : skipped) {
+        replayer.skipProc(name);
+    }
+    const size_t resolved = replayer.resolve(overrides);
+    for (const auto &proc : replayer.procs()) {
+        if (proc.skipped && !proc.name.empty()) {
+            std::fprintf(stderr, "skipping %s (%s, %s)\n", proc.name.c_str(),
+                         proc.library.c_str(), proc.signature.c_str());
+        }
+    }
+    std::fprintf(stderr, "%zu of %zu functions resolved, %zu calls\n", resolved,
+                 replayer.procs().size(), replayer.callCount());
+
+    uint64_t calls = 0;
+    const double start = monotonicSeconds();
+    for (int i = 0; i < repeat; ++i) {
+        calls += replayer.replay();
+    }
+    const double elapsed = monotonicSeconds() - start;
+
+    std::fprintf(stderr, "%llu calls in %.3f s (%.1f ns per call), %llu callback returns\n",
+                 (unsigned long long) calls, elapsed, calls ? elapsed * 1e9 / double(calls) : 0.0,
+                 (unsigned long long) replayer.callbacksServed());
+    if (stats) {
+        for (const auto &proc : replayer.procs()) {
+            if (proc.calls) {
+                std::fprintf(stderr, "%12llu  %s (%llu returns differ)\n",
+                             (unsigned long long) proc.calls, proc.name.c_str(),
+                             (unsigned long long) proc.mismatches);
+            }
+        }
+    }
+    return 0;
+}
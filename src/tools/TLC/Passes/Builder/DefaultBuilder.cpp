@@ -4,9 +4,11 @@
 #include <lorelei/TLCApi/Pass.h>
 #include <lorelei/TLCApi/ProcSnippet.h>
 #include <lorelei/TLCApi/DocumentContext.h>
+#include <lorelei/TLCApi/Diagnostics.h>
 #include <lorelei/ThunkInterface/PassTags.h>
 
 #include "Utils/PassCodeTemplates.h"
+#include "Utils/PassUtils.h"
 
 using namespace clang;
 
@@ -135,13 +137,104 @@ namespace lore::tool::TLC {
         const auto &getProcCbCallerInvoke = [&]() {
             return formatN("ProcCb<%1, %2, Caller>::invoke", proc.name(), procKindStr);
         };
+        // A leaf (a guest-to-host function tagged pass::Leaf, which never calls back into the
+        // guest) crosses with invokeLeaf, which lets the host run it without a coroutine stack
+        // switch. The tag is the author's word, so only a signature that contradicts it is refused.
+        const bool isLeaf = PASS_isLeafProc(proc);
+        if (!isLeaf && PASS_hasPassTag(proc, lore::thunk::pass::ID_Leaf)) {
+            reportError(ast.getDiagnostics(), proc.functionDecl()->getLocation(),
+                        "pass::Leaf requires a non-variadic guest-to-host function without "
+                        "callback arguments, in a library that imports no guest functions: " +
+                            proc.name());
+        }
+        // A proc of scalar arguments that is not a register proc passes them by value in a packed
+        // frame instead, and the single frame pointer takes the place of args.
+        const bool isFrame = PASS_isFrameProc(proc);
+        const char *argsExpr = isFrame ? "(void **) &frame" : "args";
         const auto &getProcFnExecInvokeWithCallList = [&]() {
-            return formatN("ProcFn<%1, %2, Exec>::invoke(args, %3, nullptr);", proc.name(),
-                           procKindStr, isVoid ? "nullptr" : "&ret");
+            return formatN("ProcFn<%1, %2, Exec>::%3(%4, %5, nullptr);", proc.name(),
+                           procKindStr, isLeaf ? "invokeLeaf" : "invoke", argsExpr,
+                           isVoid ? "nullptr" : "&ret");
+        };
+        // A function of at most four scalar arguments and a scalar return crosses with CC_Register:
+        // the words travel by value, with no args[] array, and the host Entry takes them as such.
+        const bool isRegister = PASS_isRegisterProc(proc);
+        const auto &getProcFnExecInvokeRegister = [&]() {
+            auto call = formatN("ProcFn<%1, %2, Exec>::%3(%4)", proc.name(), procKindStr,
+                                isLeaf ? "invokeRegisterLeaf" : "invokeRegister",
+                                SRC_registerWordList(FI));
+            if (isVoid) {
+                return "(void) " + call + ";";
+            }
+            return "ret = lore::thunk::fromRegister<" + getTypeString(FI.returnType()) + ">(" +
+                   call + ");";
+        };
+        // A pass::Deferred function is only recorded by the guest and sent later in a batch, and a
+        // pass::Async one is posted to a host worker. Either returns before the host runs it, so it
+        // must return nothing and must not hand out a callback, whose guest-side wrapping lasts only
+        // for the call.
+        const char *postedTag = nullptr;
+        const char *postedInvoke = nullptr;
+        if (proc.isFunction() && isG2H) {
+            if (PASS_hasPassTag(proc, lore::thunk::pass::ID_Deferred)) {
+                postedTag = "pass::Deferred";
+                postedInvoke = "invokeDeferred";
+            } else if (PASS_hasPassTag(proc, lore::thunk::pass::ID_Async)) {
+                postedTag = "pass::Async";
+                postedInvoke = "invokeAsync";
+            }
+        }
+        if (postedInvoke) {
+            bool hasCallback = false;
+            for (const auto &type : real.argTypes()) {
+                hasCallback |= PASS_containsFunctionPointer(type);
+            }
+            if (!isVoid || real.isVariadic() || hasCallback) {
+                reportError(ast.getDiagnostics(), proc.functionDecl()->getLocation(),
+                            std::string(postedTag) +
+                                " requires a non-variadic void function without callback "
+                                "arguments: " +
+                                proc.name());
+                postedInvoke = nullptr;
+            }
+        }
+        // The host replays a batch of deferred calls without a coroutine, as it runs a leaf, so a
+        // deferred function is refused where a leaf would be.
+        if (postedInvoke && PASS_hasPassTag(proc, lore::thunk::pass::ID_Deferred) &&
+            PASS_importsGuestFunctions(proc)) {
+            reportError(ast.getDiagnostics(), proc.functionDecl()->getLocation(),
+                        "pass::Deferred is not allowed in a library that imports guest "
+                        "functions: " +
+                            proc.name());
+            postedInvoke = nullptr;
+        }
+        // A pass::Adaptive function may run on the guest's own copy of the library instead of
+        // crossing: its guest Entry hands the Adapt layer to Exec's invokeAdaptive, which picks the
+        // route per call. It must take its arguments as they are, so it cannot be variadic, and a
+        // posted call has no result to time.
+        bool isAdaptive = proc.isFunction() && isG2H &&
+                          PASS_hasPassTag(proc, lore::thunk::pass::ID_Adaptive);
+        if (isAdaptive && (real.isVariadic() || postedInvoke)) {
+            reportError(ast.getDiagnostics(), proc.functionDecl()->getLocation(),
+                        "pass::Adaptive requires a non-variadic function that is neither deferred "
+                        "nor async: " +
+                            proc.name());
+            isAdaptive = false;
+        }
+        const auto &getProcFnAdaptiveEntryCall = [&]() {
+            FunctionInfo AFI = FI;
+            AFI.argumentsRef().insert(AFI.argumentsRef().begin(),
+                                      {pVoidType, getProcFnAdaptInvoke()});
+            return SRC_callListAssign(
+                AFI, formatN("ProcFn<%1, %2, Exec>::invokeAdaptive", proc.name(), procKindStr));
+        };
+        const auto &getProcFnExecInvokePosted = [&]() {
+            return formatN("ProcFn<%1, %2, Exec>::%3(args, argSizes, %4);", proc.name(),
+                           procKindStr, postedInvoke, std::to_string(FI.arguments().size()));
         };
         const auto &getProcCbExecInvokeWithCallList = [&]() {
-            return formatN("ProcCb<%1, %2, Exec>::invoke(callback, args, %3, nullptr);",
-                           proc.name(), procKindStr, isVoid ? "nullptr" : "&ret");
+            return formatN("ProcCb<%1, %2, Exec>::invoke(callback, %3, %4, nullptr);",
+                           proc.name(), procKindStr, argsExpr, isVoid ? "nullptr" : "&ret");
         };
 
         // Adapt is a typed pass-through between Entry and Caller. Non-Builder passes (callback
@@ -151,7 +244,8 @@ namespace lore::tool::TLC {
         if (proc.isFunction()) {
             XENT.functionInfo = XADP.functionInfo = XCAL.functionInfo = YADP.functionInfo =
                 YCAL.functionInfo = FI;
-            YENT.functionInfo = FI_packedFunctionInfo(ast);
+            YENT.functionInfo =
+                isRegister ? FI_registerFunctionInfo(ast) : FI_packedFunctionInfo(ast);
 
             /// \example: A guest-to-host function \a foo
             /// \code
@@ -166,8 +260,17 @@ namespace lore::tool::TLC {
             ///         return ret;
             ///     }
             /// \endcode
+            /// An adaptive function's guest Entry lets Exec choose the route:
+            /// \code
+            ///         ret = ProcFn<foo, GuestToHost, Exec>::invokeAdaptive(
+            ///             ProcFn<foo, GuestToHost, Adapt>::invoke, a, b);
+            /// \endcode
             XENT.body.prolog.push_back(key, SRC_emptyReturnDecl(FI, ast));
-            XENT.body.center.push_back(key, SRC_callListAssign(FI, getProcFnAdaptInvoke()));
+            if (isAdaptive && !isHost) {
+                XENT.body.center.push_back(key, getProcFnAdaptiveEntryCall());
+            } else {
+                XENT.body.center.push_back(key, SRC_callListAssign(FI, getProcFnAdaptInvoke()));
+            }
             XENT.body.epilog.push_back(key, SRC_returnRet(FI));
 
             /// \example: Adapt (sender)
@@ -191,9 +294,46 @@ namespace lore::tool::TLC {
             ///         return ret;
             ///     }
             /// \endcode
+            /// A leaf calls \c invokeLeaf instead of \c invoke. A deferred or async function calls
+            /// \c invokeDeferred or \c invokeAsync and also passes the argument sizes, since the
+            /// guest copies the arguments before returning:
+            /// \code
+            ///     unsigned argSizes[] = { sizeof(a), sizeof(b), };
+            ///     ProcFn<foo, GuestToHost, Exec>::invokeDeferred(args, argSizes, 2);
+            /// \endcode
+            ///
+            /// A register function passes its argument words by value instead:
+            /// \code
+            ///     ret = lore::thunk::fromRegister<int>(ProcFn<foo, GuestToHost, Exec>::invokeRegister(
+            ///         lore::thunk::toRegister(a), lore::thunk::toRegister(b), 0, 0));
+            /// \endcode
+            ///
+            /// A frame function (scalar arguments, but not a register one) packs them by value:
+            /// \code
+            ///     struct Frame {
+            ///         int a;
+            ///         double b;
+            ///     };
+            ///     static_assert(offsetof(Frame, a) == 0, "...");
+            ///     static_assert(offsetof(Frame, b) == 8, "...");
+            ///     static_assert(sizeof(Frame) == 16, "...");
+            ///     Frame frame = {a, b};
+            ///     ret = ProcFn<foo, GuestToHost, Exec>::invoke((void **) &frame, &ret, nullptr);
+            /// \endcode
             XCAL.body.prolog.push_back(key, SRC_emptyReturnDecl(FI, ast));
-            XCAL.body.prolog.push_back(key, SRC_argPtrListDecl(FI));
-            XCAL.body.center.push_back(key, SRC_asIs(getProcFnExecInvokeWithCallList()));
+            if (isRegister) {
+                XCAL.body.center.push_back(key, SRC_asIs(getProcFnExecInvokeRegister()));
+            } else if (postedInvoke) {
+                XCAL.body.prolog.push_back(key, SRC_argPtrListDecl(FI));
+                XCAL.body.prolog.push_back(key, SRC_argSizeListDecl(FI));
+                XCAL.body.center.push_back(key, SRC_asIs(getProcFnExecInvokePosted()));
+            } else if (isFrame) {
+                XCAL.body.prolog.push_back(key, SRC_argFrameDecl(FI));
+                XCAL.body.center.push_back(key, SRC_asIs(getProcFnExecInvokeWithCallList()));
+            } else {
+                XCAL.body.prolog.push_back(key, SRC_argPtrListDecl(FI));
+                XCAL.body.center.push_back(key, SRC_asIs(getProcFnExecInvokeWithCallList()));
+            }
             XCAL.body.epilog.push_back(key, SRC_returnRet(FI));
 
             /// \example: Entry (receiver)
@@ -205,10 +345,38 @@ namespace lore::tool::TLC {
             ///         ret_ref = ProcFn<foo, GuestToHost, Adapt>::invoke(arg1, arg2);
             ///     }
             /// \endcode
-            YENT.body.prolog.push_back(key, SRC_argPtrListExtractDecl(FI, ast));
-            YENT.body.prolog.push_back(key, SRC_retExtractDecl(FI, ast));
-            YENT.body.center.push_back(key,
-                                       SRC_callListAssign(FI, getProcFnAdaptInvoke(), "ret_ref"));
+            ///
+            /// A register function's Entry takes and returns the words by value:
+            /// \code
+            ///     uint64_t invoke(uint64_t reg1, uint64_t reg2, uint64_t reg3, uint64_t reg4) {
+            ///         int a = lore::thunk::fromRegister<int>(reg1);
+            ///         double b = lore::thunk::fromRegister<double>(reg2);
+            ///         int ret;
+            ///         ret = ProcFn<foo, GuestToHost, Adapt>::invoke(a, b);
+            ///         return lore::thunk::toRegister(ret);
+            ///     }
+            /// \endcode
+            ///
+            /// A frame function's Entry reads the fields of the sender's frame:
+            /// \code
+            ///         struct Frame { ... };
+            ///         auto &frame = *(Frame *) args;
+            ///         auto &arg1 = frame.arg1;
+            ///         auto &arg2 = frame.arg2;
+            /// \endcode
+            if (isRegister) {
+                YENT.body.prolog.push_back(key, SRC_registerArgExtractDecl(FI));
+                YENT.body.prolog.push_back(key, SRC_emptyReturnDecl(FI, ast));
+                YENT.body.center.push_back(key, SRC_callListAssign(FI, getProcFnAdaptInvoke()));
+                YENT.body.epilog.push_back(
+                    key, SRC_asIs(isVoid ? "return 0;" : "return lore::thunk::toRegister(ret);"));
+            } else {
+                YENT.body.prolog.push_back(key, isFrame ? SRC_argFrameExtractDecl(FI)
+                                                        : SRC_argPtrListExtractDecl(FI, ast));
+                YENT.body.prolog.push_back(key, SRC_retExtractDecl(FI, ast));
+                YENT.body.center.push_back(
+                    key, SRC_callListAssign(FI, getProcFnAdaptInvoke(), "ret_ref"));
+            }
 
             /// \example: Adapt (receiver)
             /// \code
@@ -282,8 +450,11 @@ namespace lore::tool::TLC {
             ///         return ret;
             ///     }
             /// \endcode
+            /// A frame callback packs its arguments into a \c Frame and passes \c &frame instead,
+            /// as a frame function does.
             XCAL.body.prolog.push_back(key, SRC_emptyReturnDecl(FI, ast));
-            XCAL.body.prolog.push_back(key, SRC_argPtrListDecl(FI));
+            XCAL.body.prolog.push_back(key, isFrame ? SRC_argFrameDecl(FI)
+                                                    : SRC_argPtrListDecl(FI));
             XCAL.body.center.push_back(key, SRC_asIs(getProcCbExecInvokeWithCallList()));
             XCAL.body.epilog.push_back(key, SRC_returnRet(FI));
 
@@ -298,7 +469,9 @@ namespace lore::tool::TLC {
             ///         );
             ///     }
             /// \endcode
-            YENT.body.prolog.push_back(key, SRC_argPtrListExtractDecl(FI, ast));
+            /// A frame callback's Entry reads the fields of the sender's frame instead.
+            YENT.body.prolog.push_back(key, isFrame ? SRC_argFrameExtractDecl(FI)
+                                                    : SRC_argPtrListExtractDecl(FI, ast));
             YENT.body.prolog.push_back(key, SRC_retExtractDecl(FI, ast));
             YENT.body.center.push_back(key,
                                        SRC_callListAssign(CFI, getProcCbAdaptInvoke(), "ret_ref"));
@@ -15,6 +15,7 @@
 #include <lorelei/ClangExtras/TypeUtils.h>
 
 #include "Utils/PassCodeTemplates.h"
+#include "Utils/PassUtils.h"
 
 using namespace clang;
 
@@ -26,6 +27,10 @@ namespace lore::tool::TLC {
             return std::string(level * 4, ' ');
         }
 
+        // The allocCallbackTrampoline context of the stubs the substitutions allocate: owned by the
+        // thunk's context, so that they are released when the thunk is unloaded.
+        constexpr const char kTrampolineContext[] = "lore::thunk::detail::ThunkTrampolineContext";
+
         // CallbackTree - The callbacks reachable from one proc argument, as a tree.
         //
         // Each node is an aggregate: \c callbacks are its direct function-pointer members and
@@ -56,36 +61,6 @@ namespace lore::tool::TLC {
                 return CallbackTree(Status::NoCallbacks);
             }
 
-            // True when \a T, fully walked through pointers, arrays and nested records, contains any
-            // function pointer at all.
-            static bool containsFunctionPointer(QualType T) {
-                SmallVector<QualType> stack{T};
-                std::set<std::string> visited;
-                while (!stack.empty()) {
-                    auto type = stack.pop_back_val().getCanonicalType();
-                    while (type->isPointerType() || type->isArrayType()) {
-                        type = type->isPointerType()
-                                   ? type->getPointeeType()
-                                   : type->getAsArrayTypeUnsafe()->getElementType();
-                    }
-                    type = type.getCanonicalType();
-
-                    // Stop at recursive record types so the walk terminates.
-                    if (!visited.insert(getTypeString(type)).second) {
-                        continue;
-                    }
-                    if (type->isFunctionProtoType() || type->isFunctionNoProtoType()) {
-                        return true;
-                    }
-                    if (type->isRecordType()) {
-                        for (const auto *field : type->getAs<RecordType>()->getDecl()->fields()) {
-                            stack.push_back(field->getType());
-                        }
-                    }
-                }
-                return false;
-            }
-
             // Build the tree for the type \a T. A record contributes its function-pointer fields as
             // callbacks and recurses into the rest. A callback reached through more than one level of
             // indirection (a double pointer, an array or union of function pointers) is unsupported.
@@ -94,7 +69,7 @@ namespace lore::tool::TLC {
                 if (T->isPointerType()) {
                     // A pointer to a pointer that leads to a callback cannot be marshalled here.
                     if (auto pointee = T->getPointeeType(); pointee->isPointerType() &&
-                                                            containsFunctionPointer(
+                                                            PASS_containsFunctionPointer(
                                                                 pointee->getPointeeType())) {
                         return unsupported();
                     }
@@ -102,10 +77,10 @@ namespace lore::tool::TLC {
                     T = T->getPointeeType();
                 }
                 if (T->isArrayType() &&
-                    containsFunctionPointer(T->getAsArrayTypeUnsafe()->getElementType())) {
+                    PASS_containsFunctionPointer(T->getAsArrayTypeUnsafe()->getElementType())) {
                     return unsupported();
                 }
-                if (T->isUnionType() && containsFunctionPointer(T)) {
+                if (T->isUnionType() && PASS_containsFunctionPointer(T)) {
                     return unsupported();
                 }
                 if (!T->isRecordType()) {
@@ -126,7 +101,7 @@ namespace lore::tool::TLC {
                     const auto typeStr = getTypeString(type);
                     if (!visited.insert(typeStr).second) {
                         // Already on the path: a cycle that carries a callback is unsupported.
-                        if (containsFunctionPointer(type)) {
+                        if (PASS_containsFunctionPointer(type)) {
                             return unsupported();
                         }
                         continue;
@@ -178,7 +153,7 @@ namespace lore::tool::TLC {
                 const auto allocator = idPath + "____" + name + "_xx_ThunkAlloc";
                 out << pad << ctxExpr << name << ".init<" << (guestCallback ? "true" : "false")
                     << ">((void *&) " << valExpr << name << ", allocCallbackTrampoline<" << allocator
-                    << "::invoke>);\n";
+                    << "::invoke, " << kTrampolineContext << ">);\n";
                 allocators.emplace(allocator, calleeType);
             }
             return out.str();
@@ -411,7 +386,7 @@ namespace lore::tool::TLC {
                 ss << "        struct CallbackContext _xx_out_" << name << ";\n";
                 ss << "        _xx_out_" << name << ".init<" << (outGuestCallback ? "true" : "false")
                    << ">((void *&) *" << name << ", allocCallbackTrampoline<" << allocator
-                   << "::invoke>);\n";
+                   << "::invoke, " << kTrampolineContext << ">);\n";
             }
             ss << "    }\n#endif\n";
             callerADP.body.backward.push_back(key, ss.str());
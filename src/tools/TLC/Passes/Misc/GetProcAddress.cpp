@@ -15,10 +15,12 @@ namespace lore::tool::TLC {
 
     class GetProcAddressMessage : public PassMessage {
     public:
-        GetProcAddressMessage(int nameIndex) : nameIndex(nameIndex) {
+        GetProcAddressMessage(int nameIndex, bool prefetch = false)
+            : nameIndex(nameIndex), prefetch(prefetch) {
         }
 
         int nameIndex;
+        bool prefetch;
     };
 
     class GetProcAddressPass : public Pass {
@@ -41,13 +43,15 @@ namespace lore::tool::TLC {
 
     bool GetProcAddressPass::testProc(ProcSnippet &proc, std::unique_ptr<PassMessage> &msg) {
         bool passWithDefaultArgs = false;
+        bool prefetch = false;
 
         // Check pass descriptor
-        if (int passArgs[1]; PASS_getIntegralArgumentsInPass(passArgs, proc, false, id())) {
+        if (int passArgs[2]; PASS_getIntegralArgumentsInPass(passArgs, proc, false, id())) {
+            prefetch = passArgs[1] != 0;
             if (passArgs[0] < 0) {
                 passWithDefaultArgs = true;
             } else {
-                msg = std::make_unique<GetProcAddressMessage>(passArgs[0]);
+                msg = std::make_unique<GetProcAddressMessage>(passArgs[0], prefetch);
                 return true;
             }
         }
@@ -61,7 +65,7 @@ namespace lore::tool::TLC {
                 // *GetProcAddress). Recognise it by its char-pointer type.
                 auto maybeNameType = argTypes.back();
                 if (isCharPointerType(maybeNameType)) {
-                    msg = std::make_unique<GetProcAddressMessage>(argTypes.size());
+                    msg = std::make_unique<GetProcAddressMessage>(argTypes.size(), prefetch);
                     return true;
                 }
             }
@@ -84,12 +88,17 @@ namespace lore::tool::TLC {
 
         std::string key = name();
 
-        // Rewrite the returned host proc address in the guest Adapt layer's backward section.
+        // Rewrite the returned host proc address in the guest Adapt layer's backward section. In
+        // prefetch mode the first address also warms the conversion cache for the whole library.
         auto &GADP = proc.source(ProcSnippet::Adapt);
-        GADP.body.backward.push_back(
-            key,
-            SRC_asIs("ret = (decltype(ret)) mod::GuestClient::convertHostProcAddress((const char *) " +
-                     GADP.functionInfo.argumentName(nameIndex - 1) + ", (void *) ret);"));
+        std::string code;
+        if (message.prefetch) {
+            code += SRC_asIs("prefetchProcAddresses((void *) ret);");
+        }
+        code += SRC_asIs(
+            "ret = (decltype(ret)) mod::GuestClient::convertHostProcAddress((const char *) " +
+            GADP.functionInfo.argumentName(nameIndex - 1) + ", (void *) ret);");
+        GADP.body.backward.push_back(key, code);
     }
 
     void GetProcAddressPass::endHandleProc(ProcSnippet &proc,
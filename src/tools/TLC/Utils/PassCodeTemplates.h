@@ -3,12 +3,17 @@
 #ifndef LORE_TOOLS_TLC_PASSCODETEMPLATES_H
 #define LORE_TOOLS_TLC_PASSCODETEMPLATES_H
 
+#include <algorithm>
+
 #include <llvm/ADT/StringExtras.h>
+#include <llvm/Support/MathExtras.h>
 #include <clang/AST/ASTContext.h>
 
 #include <lorelei/ClangExtras/FunctionInfo.h>
 #include <lorelei/ClangExtras/TypeUtils.h>
 
+#include "PassUtils.h"
+
 namespace lore::tool::TLC {
 
     static inline FunctionInfo FI_packedFunctionInfo(clang::ASTContext &ast) {
@@ -25,6 +30,20 @@ namespace lore::tool::TLC {
         };
     }
 
+    // The host Entry of a CC_Register function: uint64_t (uint64_t reg1, ..., uint64_t reg4).
+    static inline FunctionInfo FI_registerFunctionInfo(clang::ASTContext &ast) {
+        clang::QualType wordType = ast.getIntTypeForBitwidth(64, /*Signed=*/false);
+        return {
+            wordType,
+            {
+              {wordType, "reg1"},
+              {wordType, "reg2"},
+              {wordType, "reg3"},
+              {wordType, "reg4"},
+              },
+        };
+    }
+
     static inline FunctionInfo FI_packedCallbackInfo(clang::ASTContext &ast) {
         clang::QualType voidType = ast.VoidTy;
         clang::QualType pVoidType = ast.getPointerType(voidType);
@@ -86,7 +105,12 @@ namespace lore::tool::TLC {
     }
 
     // [indent] void *args[] = {&arg1, &arg2, ...};
+    //
+    // A function without arguments gets a null args instead, since an empty array is ill-formed.
     static inline std::string SRC_argPtrListDecl(const FunctionInfo &info, int indent = 4) {
+        if (info.arguments().empty()) {
+            return std::string(indent, ' ') + "void **args = nullptr;\n";
+        }
         std::string res = std::string(indent, ' ') + "void *args[] = {\n";
         for (int i = 0; i < info.arguments().size(); ++i) {
             res += std::string(indent + 4, ' ') + "(void *) &" + info.arguments()[i].second + ",\n";
@@ -95,6 +119,98 @@ namespace lore::tool::TLC {
         return res;
     }
 
+    // [indent] struct Frame { T1 arg1; T2 arg2; ... };
+    // [indent] static_assert(offsetof(Frame, arg1) == <offset>, ...); ...
+    // [indent] static_assert(sizeof(Frame) == <size>, ...);
+    //
+    // The packed argument frame of a PASS_isFrameProc proc: its arguments by value, in order, each
+    // at its natural alignment. The offsets and the size asserted come from PASS_frameFieldWidth,
+    // which does not depend on the target, so the guest and the host assert the same layout and
+    // a compiler that lays the frame out otherwise fails the build on its side.
+    static inline std::string SRC_argFrameTypeDecl(const FunctionInfo &info, int indent = 4) {
+        std::string res = std::string(indent, ' ') + "struct Frame {\n";
+        std::string asserts;
+        uint64_t size = 0;
+        uint64_t align = 1;
+        for (const auto &arg : info.arguments()) {
+            res += std::string(indent + 4, ' ') + getTypeStringWithName(arg.first, arg.second) +
+                   ";\n";
+            const uint64_t width = PASS_frameFieldWidth(arg.first);
+            size = llvm::alignTo(size, width);
+            asserts += std::string(indent, ' ') + "static_assert(offsetof(Frame, " + arg.second +
+                       ") == " + std::to_string(size) +
+                       ", \"argument frame layout differs from the other side\");\n";
+            size += width;
+            align = std::max(align, width);
+        }
+        res += std::string(indent, ' ') + "};\n";
+        res += asserts;
+        res += std::string(indent, ' ') + "static_assert(sizeof(Frame) == " +
+               std::to_string(llvm::alignTo(size, align)) +
+               ", \"argument frame layout differs from the other side\");\n";
+        return res;
+    }
+
+    // [indent] struct Frame { ... };
+    // [indent] Frame frame = {arg1, arg2, ...};
+    static inline std::string SRC_argFrameDecl(const FunctionInfo &info, int indent = 4) {
+        return SRC_argFrameTypeDecl(info, indent) + std::string(indent, ' ') + "Frame frame = {" +
+               SRC_callList(info) + "};\n";
+    }
+
+    // [indent] struct Frame { ... };
+    // [indent] auto &frame = *(Frame *) args;
+    // [indent] auto &arg1 = frame.arg1; ... auto &argN = frame.argN;
+    static inline std::string SRC_argFrameExtractDecl(const FunctionInfo &info, int indent = 4) {
+        std::string res = SRC_argFrameTypeDecl(info, indent);
+        res += std::string(indent, ' ') + "auto &frame = *(Frame *) args;\n";
+        for (const auto &arg : info.arguments()) {
+            res += std::string(indent, ' ') + "auto &" + arg.second + " = frame." + arg.second +
+                   ";\n";
+        }
+        return res;
+    }
+
+    // [indent] unsigned argSizes[] = {sizeof(arg1), sizeof(arg2), ...};
+    //
+    // Null for a function without arguments, like SRC_argPtrListDecl.
+    static inline std::string SRC_argSizeListDecl(const FunctionInfo &info, int indent = 4) {
+        if (info.arguments().empty()) {
+            return std::string(indent, ' ') + "const unsigned *argSizes = nullptr;\n";
+        }
+        std::string res = std::string(indent, ' ') + "unsigned argSizes[] = {\n";
+        for (int i = 0; i < info.arguments().size(); ++i) {
+            res += std::string(indent + 4, ' ') + "sizeof(" + info.arguments()[i].second + "),\n";
+        }
+        res += std::string(indent, ' ') + "};\n";
+        return res;
+    }
+
+    // lore::thunk::toRegister(arg1), ..., 0 (four words, unused ones 0)
+    static inline std::string SRC_registerWordList(const FunctionInfo &info) {
+        std::string res;
+        for (size_t i = 0; i < 4; ++i) {
+            if (i > 0)
+                res += ", ";
+            res += i < info.arguments().size()
+                       ? "lore::thunk::toRegister(" + info.arguments()[i].second + ")"
+                       : std::string("0");
+        }
+        return res;
+    }
+
+    // [indent] T1 arg1 = lore::thunk::fromRegister<T1>(reg1); ...
+    static inline std::string SRC_registerArgExtractDecl(const FunctionInfo &info, int indent = 4) {
+        std::string res;
+        const auto &args = info.arguments();
+        for (size_t i = 0; i < args.size(); ++i) {
+            res += std::string(indent, ' ') + getTypeStringWithName(args[i].first, args[i].second) +
+                   " = lore::thunk::fromRegister<" + getTypeString(args[i].first) + ">(reg" +
+                   std::to_string(i + 1) + ");\n";
+        }
+        return res;
+    }
+
     // [indent] return ret;
     static inline std::string SRC_returnRet(const FunctionInfo &info, int indent = 4) {
         if (info.returnType()->isVoidType())
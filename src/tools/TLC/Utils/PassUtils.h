@@ -3,10 +3,16 @@
 #ifndef LORE_TOOLS_TLC_PASSUTILS_H
 #define LORE_TOOLS_TLC_PASSUTILS_H
 
+#include <algorithm>
+#include <set>
+
 #include <llvm/ADT/StringExtras.h>
 #include <clang/AST/ASTContext.h>
 
+#include <lorelei/ClangExtras/TypeUtils.h>
 #include <lorelei/TLCApi/ProcSnippet.h>
+#include <lorelei/TLCApi/DocumentContext.h>
+#include <lorelei/ThunkInterface/PassTags.h>
 
 namespace lore::tool::TLC {
 
@@ -66,6 +72,191 @@ namespace lore::tool::TLC {
         return true;
     }
 
+    // True when \a proc's descriptor lists the pass tag \a id in its \c passes.
+    static inline bool PASS_hasPassTag(const ProcSnippet &proc, int id) {
+        if (!proc.desc()) {
+            return false;
+        }
+        const auto &passes = proc.desc()->passes;
+        return std::any_of(passes.begin(), passes.end(),
+                           [id](const ProcSnippet::PassInfo &pass) { return pass.id == id; });
+    }
+
+    // True when \a T, fully walked through pointers, arrays and nested records, contains any function
+    // pointer at all.
+    static inline bool PASS_containsFunctionPointer(clang::QualType T) {
+        llvm::SmallVector<clang::QualType> stack{T};
+        std::set<std::string> visited;
+        while (!stack.empty()) {
+            auto type = stack.pop_back_val().getCanonicalType();
+            while (type->isPointerType() || type->isArrayType()) {
+                type = type->isPointerType() ? type->getPointeeType()
+                                             : type->getAsArrayTypeUnsafe()->getElementType();
+            }
+            type = type.getCanonicalType();
+
+            // Stop at recursive record types so the walk terminates.
+            if (!visited.insert(getTypeString(type)).second) {
+                continue;
+            }
+            if (type->isFunctionProtoType() || type->isFunctionNoProtoType()) {
+                return true;
+            }
+            if (type->isRecordType()) {
+                for (const auto *field : type->getAs<clang::RecordType>()->getDecl()->fields()) {
+                    stack.push_back(field->getType());
+                }
+            }
+        }
+        return false;
+    }
+
+    // True when \a T can travel as a CC_Register word: an integer, enumeration, data pointer or
+    // floating-point type of at most 64 bits.
+    static inline bool PASS_isRegisterScalar(clang::QualType T, clang::ASTContext &ast) {
+        T = T.getCanonicalType();
+        if (!(T->isIntegralOrEnumerationType() || T->isPointerType() || T->isRealFloatingType())) {
+            return false;
+        }
+        return ast.getTypeSize(T) <= 64 && !PASS_containsFunctionPointer(T);
+    }
+
+    // True when the guest-to-host function \a proc crosses with CC_Register: at most four arguments
+    // and a return that are all register scalars (or a void return), and no pass::Deferred or
+    // pass::Async tag (whose host Entry is replayed with args[]). Depends only on the signature and
+    // the descriptor, so the guest Caller and the host Entry always agree.
+    static inline bool PASS_isRegisterProc(ProcSnippet &proc) {
+        if (!proc.isFunction() || proc.direction() != ProcSnippet::GuestToHost) {
+            return false;
+        }
+        auto &ast = proc.document().ast();
+        const auto &view = proc.realFunctionTypeView();
+        if (view.isVariadic() || view.argTypes().size() > 4) {
+            return false;
+        }
+        if (!view.returnType()->isVoidType() && !PASS_isRegisterScalar(view.returnType(), ast)) {
+            return false;
+        }
+        for (const auto &type : view.argTypes()) {
+            if (!PASS_isRegisterScalar(type, ast)) {
+                return false;
+            }
+        }
+        return !PASS_hasPassTag(proc, lore::thunk::pass::ID_Deferred) &&
+               !PASS_hasPassTag(proc, lore::thunk::pass::ID_Async);
+    }
+
+    // The width in bytes a packed frame (see SRC_argFrameDecl) gives a field of type \a T, or 0 if
+    // it takes no such field. The width follows from the kind of type alone, as on the LP64 guest
+    // and hosts Lorelei supports, not from the target being generated for, so both sides of a
+    // thunk compute the same frame layout and can check their compiler's against it.
+    static inline unsigned PASS_frameFieldWidth(clang::QualType T) {
+        T = T.getCanonicalType();
+        if (T->isPointerType()) {
+            return PASS_containsFunctionPointer(T) ? 0 : 8;
+        }
+        if (const auto *ET = T->getAs<clang::EnumType>()) {
+            const auto underlying = ET->getDecl()->getIntegerType();
+            return underlying.isNull() ? 0 : PASS_frameFieldWidth(underlying);
+        }
+        const auto *BT = T->getAs<clang::BuiltinType>();
+        if (!BT) {
+            return 0;
+        }
+        switch (BT->getKind()) {
+            case clang::BuiltinType::Bool:
+            case clang::BuiltinType::Char_S:
+            case clang::BuiltinType::Char_U:
+            case clang::BuiltinType::SChar:
+            case clang::BuiltinType::UChar:
+            case clang::BuiltinType::Char8:
+                return 1;
+            case clang::BuiltinType::Short:
+            case clang::BuiltinType::UShort:
+            case clang::BuiltinType::Char16:
+                return 2;
+            case clang::BuiltinType::Int:
+            case clang::BuiltinType::UInt:
+            case clang::BuiltinType::Char32:
+            case clang::BuiltinType::WChar_S:
+            case clang::BuiltinType::WChar_U:
+            case clang::BuiltinType::Float:
+                return 4;
+            case clang::BuiltinType::Long:
+            case clang::BuiltinType::ULong:
+            case clang::BuiltinType::LongLong:
+            case clang::BuiltinType::ULongLong:
+            case clang::BuiltinType::Double:
+                return 8;
+            default:
+                return 0;
+        }
+    }
+
+    // True when \a proc's arguments cross in a packed frame (see SRC_argFrameDecl) instead of an
+    // args[] array: it is not variadic and does not cross with CC_Register, it takes at least one
+    // argument and every argument is a register scalar with a fixed frame width (see
+    // PASS_frameFieldWidth), and it has no pass::Deferred or pass::Async tag (whose host Entry is
+    // replayed with args[]). Like PASS_isRegisterProc, depends only on the signature and the
+    // descriptor, so the sender and the receiver always agree.
+    static inline bool PASS_isFrameProc(ProcSnippet &proc) {
+        if (PASS_isRegisterProc(proc)) {
+            return false;
+        }
+        auto &ast = proc.document().ast();
+        const auto &view = proc.realFunctionTypeView();
+        if (view.isVariadic() || view.argTypes().empty()) {
+            return false;
+        }
+        for (const auto &type : view.argTypes()) {
+            if (!PASS_isRegisterScalar(type, ast) || PASS_frameFieldWidth(type) == 0) {
+                return false;
+            }
+        }
+        return !PASS_hasPassTag(proc, lore::thunk::pass::ID_Deferred) &&
+               !PASS_hasPassTag(proc, lore::thunk::pass::ID_Async);
+    }
+
+    // True when the document of \a proc imports guest functions (host-to-guest procs), which any
+    // host function of the library may call back into.
+    static inline bool PASS_importsGuestFunctions(ProcSnippet &proc) {
+        return !proc.document().procs(ProcSnippet::Function, ProcSnippet::HostToGuest).empty();
+    }
+
+    // True when the guest-to-host function \a proc may be tagged pass::Leaf: nothing in its
+    // signature or its document contradicts the tag. It must reach no function pointer through its
+    // arguments (nothing for CallbackSubstituter to wrap), must not be variadic and must not be
+    // tagged pass::CallbackSubstituter, and the document must import no guest functions
+    // (host-to-guest procs), since any host function may call them.
+    static inline bool PASS_canBeLeafProc(ProcSnippet &proc) {
+        if (!proc.isFunction() || proc.direction() != ProcSnippet::GuestToHost) {
+            return false;
+        }
+        if (PASS_importsGuestFunctions(proc)) {
+            return false;
+        }
+
+        const auto &view = proc.realFunctionTypeView();
+        if (view.isVariadic()) {
+            return false;
+        }
+        for (const auto &type : view.argTypes()) {
+            if (PASS_containsFunctionPointer(type)) {
+                return false;
+            }
+        }
+
+        return !PASS_hasPassTag(proc, lore::thunk::pass::ID_CallbackSubstituter);
+    }
+
+    // True when the guest-to-host function \a proc can never reenter the guest, so the host may run
+    // it directly instead of on a coroutine stack (see CC_Leaf). Only a function tagged pass::Leaf
+    // qualifies, and only if PASS_canBeLeafProc: a callback stored by an earlier call, or a thread
+    // the function starts, cannot be seen in a signature, so a leaf is never inferred.
+    static inline bool PASS_isLeafProc(ProcSnippet &proc) {
+        return PASS_hasPassTag(proc, lore::thunk::pass::ID_Leaf) && PASS_canBeLeafProc(proc);
+    }
+
 }
 
 #endif // LORE_TOOLS_TLC_PASSUTILS_H
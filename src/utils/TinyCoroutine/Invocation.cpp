@@ -4,11 +4,19 @@
 
 #include <pthread.h>
 #include <dlfcn.h>
+#include <sys/mman.h>
+#include <unistd.h>
 
-#include <memory>
+#include <algorithm>
+#include <atomic>
 #include <cstddef>
 #include <cassert>
+#include <cstdlib>
 #include <cstring>
+#include <mutex>
+#include <vector>
+
+#include <lorelei/Support/Probes.h>
 
 // #define LORE_USE_EMU_TASK_ENTRY
 
@@ -35,8 +43,130 @@ namespace lore::utils {
     using InvocationArguments = Invocation::InvocationArguments;
     using ReentryArguments = Invocation::ReentryArguments;
 
+    namespace {
+
+        // The top of a stack handed back to the pool stays resident for the next thread. The
+        // rest is returned to the kernel.
+        constexpr size_t HotStackSize = 64 * 1024;
+
+        size_t pageSize() {
+            static const size_t size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+            return size;
+        }
+
+        size_t defaultStackSize() {
+            pthread_attr_t attr;
+            size_t stack_size;
+
+            pthread_attr_init(&attr);
+            pthread_attr_getstacksize(&attr, &stack_size);
+            pthread_attr_destroy(&attr);
+
+            return stack_size;
+        }
+
+        // The coroutine stacks of the process. Each mapping is one guard page followed by the
+        // usable stack. Never destroyed: a thread may exit, and hand its stack back, after static
+        // destructors have run.
+        class StackPool {
+        public:
+            static StackPool &instance() {
+                static auto pool = new StackPool();
+                return *pool;
+            }
+
+            void setStackSize(size_t size) {
+                m_requestedSize.store(size, std::memory_order_relaxed);
+            }
+
+            // Returns the mapping, whose usable part starts one page in and spans *size bytes.
+            char *acquire(size_t *size) {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                const size_t stackSize = currentStackSize();
+                for (auto it = m_free.begin(); it != m_free.end(); ++it) {
+                    if (it->size == stackSize) {
+                        auto mapping = it->mapping;
+                        m_free.erase(it);
+                        *size = stackSize;
+                        return mapping;
+                    }
+                }
+
+                auto mapping = static_cast<char *>(
+                    mmap(nullptr, pageSize() + stackSize, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK, -1, 0));
+                if (mapping == MAP_FAILED) {
+                    std::abort();
+                }
+                // Overflowing the stack faults here instead of running into other memory.
+                mprotect(mapping, pageSize(), PROT_NONE);
+                m_stacks.push_back({mapping, stackSize});
+                *size = stackSize;
+                return mapping;
+            }
+
+            void release(char *mapping, size_t size) {
+                if (size > HotStackSize) {
+                    madvise(mapping + pageSize(), size - HotStackSize, MADV_DONTNEED);
+                }
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_free.push_back({mapping, size});
+            }
+
+            void recordDepth(size_t depth) {
+                size_t seen = m_maxDepth.load(std::memory_order_relaxed);
+                while (depth > seen &&
+                       !m_maxDepth.compare_exchange_weak(seen, depth, std::memory_order_relaxed)) {
+                }
+            }
+
+            Invocation::Stats stats() {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                Invocation::Stats stats = {};
+                stats.stackSize = currentStackSize();
+                stats.stackCount = m_stacks.size();
+                stats.pooledStacks = m_free.size();
+                stats.maxDepth = m_maxDepth.load(std::memory_order_relaxed);
+
+                std::vector<unsigned char> pages;
+                for (const auto &stack : m_stacks) {
+                    pages.resize(stack.size / pageSize());
+                    if (mincore(stack.mapping + pageSize(), stack.size, pages.data()) != 0) {
+                        continue;
+                    }
+                    stats.residentBytes +=
+                        pageSize() * std::count_if(pages.begin(), pages.end(),
+                                                   [](unsigned char page) { return page & 1; });
+                }
+                return stats;
+            }
+
+        protected:
+            struct Stack {
+                char *mapping;
+                size_t size;
+            };
+
+            size_t currentStackSize() const {
+                size_t size = m_requestedSize.load(std::memory_order_relaxed);
+                if (size == 0) {
+                    static const size_t default_stack_size = defaultStackSize();
+                    size = default_stack_size;
+                }
+                return (size + pageSize() - 1) & ~(pageSize() - 1);
+            }
+
+            std::mutex m_mutex;
+            std::vector<Stack> m_stacks;
+            std::vector<Stack> m_free;
+            std::atomic<size_t> m_requestedSize = 0;
+            std::atomic<size_t> m_maxDepth = 0;
+        };
+
+    }
+
     struct HostExecContext {
-        std::unique_ptr<char[]> stack;
+        char *stackMapping;
         size_t stackSize;
         char *stackTop;
 
@@ -44,8 +174,9 @@ namespace lore::utils {
             ReentryArguments **ra_ptr;
             RegState *hostState;
         };
-        InvocationInfo *invocations;
-        size_t invocationCount;
+        // Kept apart from the stack, so an overflow hits the guard page rather than these.
+        std::vector<InvocationInfo> invocations;
+        size_t maxDepth = 0;
 
         RegState mainHostState;
 
@@ -53,23 +184,26 @@ namespace lore::utils {
         ~HostExecContext();
 
         inline InvocationInfo &lastInvocation() {
-            assert(invocationCount > 0);
-            return invocations[invocationCount - 1];
+            assert(!invocations.empty());
+            return invocations.back();
         }
 
         inline void pushInvocation(ReentryArguments **ra_ptr, RegState *hostState) {
             assert(ra_ptr);
             assert(hostState);
-            assert(invocationCount < (stackSize / sizeof(InvocationInfo)));
-            invocations[invocationCount++] = {
+            invocations.push_back({
                 ra_ptr,
                 hostState,
-            };
+            });
+            if (invocations.size() > maxDepth) {
+                maxDepth = invocations.size();
+                StackPool::instance().recordDepth(maxDepth);
+            }
         }
 
         inline void popInvocation() {
-            assert(invocationCount > 0);
-            invocationCount--;
+            assert(!invocations.empty());
+            invocations.pop_back();
         }
 
         static int64_t invocationEntry(void *arg1, void *arg2);
@@ -77,34 +211,26 @@ namespace lore::utils {
 
     static thread_local HostExecContext thread_ctx;
 
-    static inline size_t get_default_stack_size() {
-        pthread_attr_t attr;
-        size_t stack_size;
-
-        pthread_attr_init(&attr);
-        pthread_attr_getstacksize(&attr, &stack_size);
-        pthread_attr_destroy(&attr);
-
-        return stack_size;
-    }
-
     HostExecContext::HostExecContext() {
-        static size_t default_stack_size = get_default_stack_size();
-
-        stackSize = default_stack_size;
-        stack = std::make_unique<char[]>(stackSize);
+        stackMapping = StackPool::instance().acquire(&stackSize);
         // Coroutine stacks grow downward, so the highest address is the top. Align it down to a
         // 16-byte boundary as required by the SysV/AAPCS call ABIs.
         stackTop = reinterpret_cast<char *>(
-            reinterpret_cast<uintptr_t>(stack.get() + stackSize) & ~uintptr_t(0xF));
+            reinterpret_cast<uintptr_t>(stackMapping + pageSize() + stackSize) & ~uintptr_t(0xF));
+        invocations.reserve(16);
+    }
 
-        // The invocation stack grows up from the buffer bottom while the coroutine call stack grows
-        // down from stackTop, so the two share one buffer from opposite ends.
-        invocations = reinterpret_cast<InvocationInfo *>(stack.get());
-        invocationCount = 0;
+    HostExecContext::~HostExecContext() {
+        StackPool::instance().release(stackMapping, stackSize);
     }
 
-    HostExecContext::~HostExecContext() = default;
+    void Invocation::setStackSize(size_t size) {
+        StackPool::instance().setStackSize(size);
+    }
+
+    Invocation::Stats Invocation::stats() {
+        return StackPool::instance().stats();
+    }
 
     int64_t Invocation::invoke(const InvocationArguments *ia, ReentryArguments **ra_ptr) {
 #ifdef LORE_USE_EMU_TASK_ENTRY
@@ -112,7 +238,7 @@ namespace lore::utils {
 #else
         // A nested invocation must not clobber the suspended one below it: start fresh at stackTop
         // only when nothing is live, otherwise carve out below the suspended invocation's saved SP.
-        auto stack = thread_ctx.invocationCount == 0
+        auto stack = thread_ctx.invocations.empty()
                          ? reinterpret_cast<uintptr_t>(thread_ctx.stackTop)
                          : (RegStateGetSP(thread_ctx.lastInvocation().hostState) & ~uintptr_t(0xF));
         return coroutine_start(const_cast<InvocationArguments *>(ia), ra_ptr,
@@ -122,7 +248,8 @@ namespace lore::utils {
     }
 
     int64_t Invocation::resume() {
-        assert(thread_ctx.invocationCount > 0);
+        assert(!thread_ctx.invocations.empty());
+        LORE_PROBE(invocation_resume, thread_ctx.invocations.size());
         // Switch into the suspended invocation. The value returned here is whatever the invocation
         // hands back when it next yields: 1 if it suspended at another reentry, 0 if it finished.
         return coroutine_switch(&thread_ctx.mainHostState, thread_ctx.lastInvocation().hostState,
@@ -131,9 +258,10 @@ namespace lore::utils {
 
     void Invocation::reenter(ReentryArguments *ra) {
         assert(ra);
-        assert(thread_ctx.invocationCount > 0);
+        assert(!thread_ctx.invocations.empty());
         auto &last = thread_ctx.lastInvocation();
         *last.ra_ptr = ra;
+        LORE_PROBE(invocation_reenter, ra, thread_ctx.invocations.size());
 
 #ifdef LORE_USE_EMU_TASK_ENTRY
         static auto entry = []() {
@@ -157,9 +285,11 @@ namespace lore::utils {
         // invocation is merely suspended. It is only torn down once invokeByConv returns below.
         RegState state;
         thread_ctx.pushInvocation(reinterpret_cast<ReentryArguments **>(arg2), &state);
+        LORE_PROBE(invocation_start, arg1, thread_ctx.invocations.size());
 
         Invocation::invokeByConv(reinterpret_cast<const InvocationArguments *>(arg1));
 
+        LORE_PROBE(invocation_finish, arg1, thread_ctx.invocations.size());
         thread_ctx.popInvocation();
         return 0;
     }
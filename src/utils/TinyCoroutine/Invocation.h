@@ -3,6 +3,7 @@
 #ifndef LORE_UTILS_TINYCOROUTINE_INVOCATION_H
 #define LORE_UTILS_TINYCOROUTINE_INVOCATION_H
 
+#include <cstddef>
 #include <cstdint>
 
 namespace lore::utils {
@@ -23,6 +24,11 @@ namespace lore::utils {
     ///   }
     /// \endcode
     ///
+    /// Each thread runs its invocations on one coroutine stack, mapped on the thread's first
+    /// invocation. Stacks are reserved without being committed (\c MAP_NORESERVE), so a page costs
+    /// memory only once a call touches it, and the lowest page is a guard. When a thread exits, its
+    /// stack goes back to a process-wide free list for the next thread.
+    ///
     /// All members are static. The class is never instantiated.
     ///
     /// \note invokeByConv() is NOT defined here. The main target must provide it (it performs the
@@ -51,6 +57,24 @@ namespace lore::utils {
         /// the native call. \a ra is surfaced to the driver as the next reentry's arguments.
         static void reenter(ReentryArguments *ra);
 
+        /// Stack and depth figures of the coroutine machinery, see \c stats.
+        struct Stats {
+            size_t stackSize;     ///< Usable bytes of each coroutine stack.
+            size_t stackCount;    ///< Stacks mapped, in use or pooled.
+            size_t pooledStacks;  ///< Stacks in the free list, left by exited threads.
+            size_t residentBytes; ///< Bytes of all stacks currently resident.
+            size_t maxDepth;      ///< Deepest nesting of invocations seen on any thread.
+        };
+
+        /// Sets the size of the coroutine stacks, rounded up to whole pages. 0 (the default) uses
+        /// the default pthread stack size. Only stacks mapped afterwards get the new size, so call it
+        /// before the first invocation.
+        static void setStackSize(size_t size);
+
+        /// Collects the current \c Stats. Walks every stack's pages, so it is meant for reporting,
+        /// not for hot paths.
+        static Stats stats();
+
         /// Performs the actual ABI-specific native call. Must be defined by the main target (see the
         /// class note). Not provided here.
         static int invokeByConv(const InvocationArguments *ia);